@@ -0,0 +1,34 @@
+#pragma once
+
+// native replacement of the emscripten precompiled header, used by the tests and tools
+
+#define M_TOSTRING_HELPER(v) #v
+#define M_TOSTRING(v) M_TOSTRING_HELPER(v)
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <list>
+#include <algorithm>
+
+using namespace std;
+
+#include <emscripten/emscripten.h>
+
+#if defined(FOREVER_NATIVE_GLM)
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_LEFT_HANDED
+#define GLM_ENABLE_EXPERIMENTAL
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/quaternion.hpp"
+#include "glm/gtc/type_precision.hpp"
+#include "glm/gtx/euler_angles.hpp"
+
+using namespace glm;
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+
+// the few emscripten functions the shared sources use, on top of the C library
+
+#include <cstdarg>
+#include <cstdio>
+#include <chrono>
+
+#define EMSCRIPTEN_KEEPALIVE
+
+enum
+{
+	EM_LOG_CONSOLE = 1,
+	EM_LOG_WARN = 2,
+	EM_LOG_ERROR = 4
+};
+
+inline void emscripten_log(int flags, const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+	fputc('\n', stderr);
+}
+
+inline double emscripten_get_now()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,89 @@
+#include "StdAfx.hpp"
+#include "Arena.hpp"
+#include "Test.hpp"
+
+namespace
+{
+	struct Counted
+	{
+		Counted()
+			: value(7)
+		{
+		}
+
+		int value;
+	};
+
+	void testReserved()
+	{
+		const double bytes = Stats::total(Stats::ArenaBytes);
+
+		Arena arena;
+		arena.reserve(1000);
+
+		uint8_t* const a = arena.alloc<uint8_t>(900);
+		CHECK(a != nullptr && arena.chunkCount() == 1);
+		CHECK(Stats::total(Stats::ArenaBytes) == bytes + 1000.0);
+
+		// spills into a fixed size chunk, not another reservation
+		uint8_t* const b = arena.alloc<uint8_t>(200);
+		CHECK(b != nullptr && arena.chunkCount() == 2);
+		CHECK(Stats::total(Stats::ArenaBytes) == bytes + 1000.0 + ARENA_SPILL_CHUNK_SIZE);
+
+		// the next ones keep filling it
+		arena.alloc<uint8_t>(1000);
+		CHECK(arena.chunkCount() == 2);
+
+		// larger than a spill chunk, a chunk of its own size
+		arena.alloc<uint8_t>(ARENA_SPILL_CHUNK_SIZE * 2);
+		CHECK(arena.chunkCount() == 3);
+		CHECK(Stats::total(Stats::ArenaBytes) == bytes + 1000.0 + ARENA_SPILL_CHUNK_SIZE * 3);
+
+		CHECK(arena.used() == 900 + 200 + 1000 + ARENA_SPILL_CHUNK_SIZE * 2);
+
+		arena.clear();
+		CHECK(arena.chunkCount() == 0 && arena.used() == 0);
+	}
+
+	void testAlignment()
+	{
+		Arena arena;
+		arena.reserve(256);
+
+		arena.alloc<uint8_t>(3);
+		double* const d = arena.alloc<double>(2);
+		CHECK(((uintptr_t)d % alignof(double)) == 0);
+
+		arena.alloc<uint8_t>(1);
+		Counted* const c = arena.alloc<Counted>(4);
+		CHECK(((uintptr_t)c % alignof(Counted)) == 0);
+		for (int i = 0; i < 4; i++)
+			CHECK(c[i].value == 7);
+
+		CHECK(arena.alloc<int>(0) == nullptr);
+		CHECK(arena.chunkCount() == 1);
+	}
+
+	void testUnreserved()
+	{
+		Arena arena;
+
+		arena.alloc<uint8_t>(16);
+		CHECK(arena.chunkCount() == 1);
+
+		arena.alloc<uint8_t>(16);
+		CHECK(arena.chunkCount() == 2);
+
+		arena.alloc<uint8_t>(ARENA_SPILL_CHUNK_SIZE - 16);
+		CHECK(arena.chunkCount() == 2);
+	}
+}
+
+int main()
+{
+	testReserved();
+	testAlignment();
+	testUnreserved();
+
+	return Test::result("ArenaTest");
+}
@@ -0,0 +1,142 @@
+#include "StdAfx.hpp"
+#include "Codec.hpp"
+#include "Test.hpp"
+
+namespace
+{
+	const Codec::Id codecs[] = { Codec::Zlib, Codec::LZ4, Codec::Stored };
+
+	vector<uint8_t> makeData(int size, int pattern)
+	{
+		vector<uint8_t> data(size);
+		uint32_t seed = 12345u + (uint32_t)pattern;
+
+		for (int i = 0; i < size; i++)
+		{
+			seed = seed * 1103515245u + 12345u;
+
+			switch (pattern)
+			{
+			// noise, nothing to match
+			case 0:
+				data[i] = (uint8_t)(seed >> 16);
+				break;
+			// long runs, the largest LZ4 lengths
+			case 1:
+				data[i] = (uint8_t)(i / 4096);
+				break;
+			// short repeats with some noise
+			default:
+				data[i] = (seed >> 28) == 0 ? (uint8_t)(seed >> 16) : (uint8_t)("texture_dxt/"[i % 12]);
+				break;
+			}
+		}
+
+		return data;
+	}
+
+	void testRoundTrip()
+	{
+		const int sizes[] = { 1, 5, 13, 300, 70000 };
+
+		for (int c = 0; c < 3; c++)
+		{
+			for (int s = 0; s < 5; s++)
+			{
+				for (int pattern = 0; pattern < 3; pattern++)
+				{
+					const vector<uint8_t> data = makeData(sizes[s], pattern);
+
+					vector<uint8_t> encoded;
+					Codec::encode(codecs[c], data.data(), (int)data.size(), encoded);
+
+					vector<uint8_t> decoded(data.size());
+					CHECK(Codec::decode(codecs[c], encoded.data(), (int)encoded.size(), decoded.data(), (int)decoded.size()));
+					CHECK(decoded == data);
+
+					// the exact size is asked for
+					if (data.size() > 1)
+						CHECK(!Codec::decode(codecs[c], encoded.data(), (int)encoded.size(), decoded.data(), (int)decoded.size() - 1));
+				}
+			}
+		}
+	}
+
+	void testPayload()
+	{
+		const vector<uint8_t> data = makeData(5000, 2);
+
+		for (int c = 0; c < 3; c++)
+		{
+			vector<uint8_t> payload;
+			Codec::encodePayload(codecs[c], data.data(), (int)data.size(), payload);
+
+			CHECK(Codec::payloadSize(payload.data(), (int)payload.size()) == (int)data.size());
+
+			vector<uint8_t> decoded;
+			CHECK(Codec::decodePayload(payload.data(), (int)payload.size(), decoded));
+			CHECK(decoded == data);
+
+			// truncated
+			payload.pop_back();
+			CHECK(!Codec::decodePayload(payload.data(), (int)payload.size(), decoded));
+		}
+	}
+
+	void testSizeField()
+	{
+		uint8_t payload[8] = {};
+		uint32_t field;
+
+		CHECK(Codec::payloadSize(payload, 3) == -1);
+
+		// more than the codec can expand 4 bytes to
+		field = Codec::sizeField(Codec::Zlib, 4 * 1032 + 1);
+		memcpy(payload, &field, 4);
+		CHECK(Codec::payloadSize(payload, 8) == -1);
+
+		field = Codec::sizeField(Codec::LZ4, 4 * 255);
+		memcpy(payload, &field, 4);
+		CHECK(Codec::payloadSize(payload, 8) == 4 * 255);
+
+		field = Codec::sizeField(Codec::LZ4, 4 * 255 + 1);
+		memcpy(payload, &field, 4);
+		CHECK(Codec::payloadSize(payload, 8) == -1);
+
+		// stored data is exactly its size
+		field = Codec::sizeField(Codec::Stored, 5);
+		memcpy(payload, &field, 4);
+		CHECK(Codec::payloadSize(payload, 8) == -1);
+		CHECK(Codec::payloadSize(payload, 9) == 5);
+
+		field = Codec::sizeField((Codec::Id)Codec::MAX_CODEC, 4);
+		CHECK(Codec::decodedSize(field, 4) == -1);
+		CHECK(Codec::decodedSize(Codec::sizeField(Codec::Zlib, 10), -1) == -1);
+		CHECK(Codec::decodedSize(0x00000010, 1) == 16);
+	}
+
+	void testCorrupted()
+	{
+		const vector<uint8_t> data = makeData(3000, 2);
+
+		for (int c = 0; c < 2; c++)
+		{
+			vector<uint8_t> encoded;
+			Codec::encode(codecs[c], data.data(), (int)data.size(), encoded);
+
+			vector<uint8_t> decoded(data.size());
+			for (std::size_t cut = 1; cut < encoded.size(); cut += encoded.size() / 7 + 1)
+				CHECK(!Codec::decode(codecs[c], encoded.data(), (int)cut, decoded.data(), (int)decoded.size()));
+		}
+	}
+}
+
+int main()
+{
+	testRoundTrip();
+	testPayload();
+	testSizeField();
+	testCorrupted();
+
+	return Test::result("CodecTest");
+}
@@ -0,0 +1,120 @@
+#include "StdAfx.hpp"
+#include "CollisionBVH.hpp"
+#include "Test.hpp"
+
+namespace
+{
+	const int GRID_SIZE = 16;
+
+	// flat floor at y = 0 spanning [0, GRID_SIZE] on x and z, two triangles per cell
+	void buildFloor(vector<vec3>& vertices, vector<uint16_t>& indices)
+	{
+		int x, z;
+		for (z = 0; z <= GRID_SIZE; z++)
+			for (x = 0; x <= GRID_SIZE; x++)
+				vertices.push_back(vec3((float)x, 0.0f, (float)z));
+
+		for (z = 0; z < GRID_SIZE; z++)
+		{
+			for (x = 0; x < GRID_SIZE; x++)
+			{
+				const uint16_t i = (uint16_t)(x + z * (GRID_SIZE + 1));
+				const uint16_t quad[6] = { i, (uint16_t)(i + GRID_SIZE + 1), (uint16_t)(i + 1),
+					(uint16_t)(i + 1), (uint16_t)(i + GRID_SIZE + 1), (uint16_t)(i + GRID_SIZE + 2) };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+	}
+
+	void testRay(const CollisionBVH& bvh)
+	{
+		const mat4 identity(1.0f);
+		CollisionHit hit;
+
+		for (int i = 0; i < 64; i++)
+		{
+			const vec3 origin(0.25f + (float)(i % 8) * 1.9f, 3.0f + (float)i * 0.1f, 0.5f + (float)(i / 8) * 1.8f);
+
+			hit.dist = 100.0f;
+			CHECK(bvh.intersectRay(identity, identity, origin, vec3(0.0f, -1.0f, 0.0f), hit));
+			CHECK_NEAR(hit.dist, origin.y, 1e-4);
+			CHECK_NEAR(hit.point.y, 0.0, 1e-4);
+			CHECK_NEAR(hit.normal.y, 1.0, 1e-4);
+		}
+
+		// pointing away and too short
+		hit.dist = 100.0f;
+		CHECK(!bvh.intersectRay(identity, identity, vec3(4.0f, 1.0f, 4.0f), vec3(0.0f, 1.0f, 0.0f), hit));
+		hit.dist = 0.5f;
+		CHECK(!bvh.intersectRay(identity, identity, vec3(4.0f, 1.0f, 4.0f), vec3(0.0f, -1.0f, 0.0f), hit));
+		CHECK(hit.dist == 0.5f);
+
+		// outside of the floor
+		hit.dist = 100.0f;
+		CHECK(!bvh.intersectRay(identity, identity, vec3(-1.0f, 1.0f, 4.0f), vec3(0.0f, -1.0f, 0.0f), hit));
+	}
+
+	void testSphereAndCapsule(const CollisionBVH& bvh)
+	{
+		const mat4 identity(1.0f);
+		CollisionHit hit;
+
+		hit.dist = 0.0f;
+		CHECK(bvh.intersectSphere(identity, identity, vec3(5.5f, 0.5f, 7.25f), 1.0f, hit));
+		CHECK_NEAR(hit.dist, 0.5, 1e-4);
+		CHECK_NEAR(hit.normal.y, 1.0, 1e-4);
+
+		hit.dist = 0.0f;
+		CHECK(!bvh.intersectSphere(identity, identity, vec3(5.5f, 1.5f, 7.25f), 1.0f, hit));
+
+		hit.dist = 0.0f;
+		CHECK(bvh.intersectCapsule(identity, identity, vec3(3.0f, 2.0f, 3.0f), vec3(3.0f, 0.25f, 3.0f), 0.5f, hit));
+		CHECK_NEAR(hit.dist, 0.25, 1e-4);
+
+		hit.dist = 0.0f;
+		CHECK(!bvh.intersectCapsule(identity, identity, vec3(3.0f, 2.0f, 3.0f), vec3(9.0f, 0.75f, 3.0f), 0.5f, hit));
+	}
+
+	void testTransform(const CollisionBVH& bvh)
+	{
+		const mat4 world = translate(mat4(1.0f), vec3(100.0f, 10.0f, -50.0f));
+		const mat4 invWorld = inverse(world);
+		CollisionHit hit;
+
+		hit.dist = 100.0f;
+		CHECK(bvh.intersectRay(world, invWorld, vec3(104.0f, 15.0f, -46.0f), vec3(0.0f, -1.0f, 0.0f), hit));
+		CHECK_NEAR(hit.dist, 5.0, 1e-4);
+		CHECK_NEAR(hit.point.y, 10.0, 1e-4);
+
+		hit.dist = 100.0f;
+		CHECK(!bvh.intersectRay(world, invWorld, vec3(4.0f, 15.0f, 4.0f), vec3(0.0f, -1.0f, 0.0f), hit));
+
+		hit.dist = 0.0f;
+		CHECK(bvh.intersectSphere(world, invWorld, vec3(108.0f, 10.75f, -42.0f), 1.0f, hit));
+		CHECK_NEAR(hit.dist, 0.25, 1e-4);
+	}
+}
+
+int main()
+{
+	vector<vec3> vertices;
+	vector<uint16_t> indices;
+	buildFloor(vertices, indices);
+
+	CollisionBVH bvh;
+	bvh.build(&vertices[0], (int)vertices.size(), &indices[0], (int)indices.size());
+	CHECK(!bvh.empty());
+	CHECK(bvh.nodeCount() > 1);
+
+	testRay(bvh);
+	testSphereAndCapsule(bvh);
+	testTransform(bvh);
+
+	// out of range indices leave the BVH empty
+	const uint16_t badIndices[3] = { 0, 1, (uint16_t)vertices.size() };
+	CollisionBVH bad;
+	bad.build(&vertices[0], (int)vertices.size(), badIndices, 3);
+	CHECK(bad.empty());
+
+	return Test::result("CollisionBVHTest");
+}
@@ -0,0 +1,121 @@
+#include "StdAfx.hpp"
+#include "Motion.hpp"
+#include "Test.hpp"
+
+namespace
+{
+	const int FRAME_COUNT = 120;
+
+	template<typename T>
+	void append(vector<uint8_t>& out, const T& value)
+	{
+		const uint8_t* const bytes = (const uint8_t*)&value;
+		out.insert(out.end(), bytes, bytes + sizeof(T));
+	}
+
+	// raw motion as read by Motion::load: a curved bone, a linear bone and a bone without frames
+	vector<uint8_t> rawMotion()
+	{
+		vector<uint8_t> data;
+		append(data, FRAME_COUNT);
+		append(data, 3);
+		append(data, FRAME_COUNT * 2);
+
+		int i;
+		append(data, true);
+		for (i = 0; i < FRAME_COUNT; i++)
+		{
+			TMAnimation ani;
+			ani.rot = angleAxis(sin((float)i * 0.1f) * 1.5f, normalize(vec3(0.2f, 1.0f, 0.1f)));
+			ani.pos = vec3(cos((float)i * 0.05f), (float)i * 0.02f, 0.5f);
+			append(data, ani);
+		}
+
+		append(data, true);
+		for (i = 0; i < FRAME_COUNT; i++)
+		{
+			TMAnimation ani;
+			ani.rot = angleAxis(0.3f, vec3(1.0f, 0.0f, 0.0f));
+			ani.pos = vec3((float)i * 0.1f, 2.0f, -(float)i * 0.05f);
+			append(data, ani);
+		}
+
+		append(data, false);
+		append(data, translate(mat4(1.0f), vec3(1.0f, 2.0f, 3.0f)));
+
+		for (i = 0; i < FRAME_COUNT; i++)
+		{
+			append(data, (uint32_t)(i == 10 ? MotionAttribute::Hit : 0));
+			append(data, i == 10 ? 42 : 0);
+		}
+
+		return data;
+	}
+
+	void testTolerance(float rotTolerance, float posTolerance)
+	{
+		const vector<uint8_t> raw = rawMotion();
+		BinaryReader reader(raw.data(), (int)raw.size());
+		Arena arena;
+
+		Motion motion("test");
+		motion.load(reader, 0, arena);
+		CHECK(reader.tell() == reader.size());
+
+		MotionCompressionStats stats;
+		motion.compress(arena, nullptr, rotTolerance, posTolerance, &stats);
+
+		CHECK(motion.compressed());
+		CHECK(stats.frameCount == FRAME_COUNT * 2);
+		CHECK(stats.keyCount < stats.frameCount);
+		CHECK(stats.compressedSize < stats.rawSize);
+		CHECK(stats.maxRotError <= rotTolerance);
+		CHECK(stats.maxPosError <= posTolerance);
+
+		// the compressed form survives a write and reload unchanged
+		vector<uint8_t> written;
+		motion.writeCompressed(written);
+
+		BinaryReader compressedReader(written.data(), (int)written.size());
+		Motion reloaded("test");
+		reloaded.loadCompressed(compressedReader, 0, arena);
+		CHECK(compressedReader.tell() == compressedReader.size());
+		CHECK(reloaded.frameCount() == FRAME_COUNT);
+
+		vector<uint8_t> rewritten;
+		reloaded.writeCompressed(rewritten);
+		CHECK(rewritten == written);
+	}
+
+	void testLinearTrack()
+	{
+		const vector<uint8_t> raw = rawMotion();
+		BinaryReader reader(raw.data(), (int)raw.size());
+		Arena arena;
+
+		Motion motion("test");
+		motion.load(reader, 0, arena);
+
+		MotionCompressionStats stats;
+		motion.compress(arena, nullptr, radians(0.5f), 0.01f, &stats);
+
+		vector<uint8_t> written;
+		motion.writeCompressed(written);
+
+		// frame count, bone count, total key count then the first track, the linear one is the second
+		BinaryReader tracks(written.data(), (int)written.size());
+		tracks.skip(sizeof(int) * 3);
+		const int firstKeyCount = tracks.read<int>();
+		tracks.skip(sizeof(vec3) * 2 + sizeof(uint16_t) * 7 * firstKeyCount);
+		CHECK(tracks.read<int>() == 2);
+	}
+}
+
+int main()
+{
+	testTolerance(radians(1.0f), 0.01f);
+	testTolerance(radians(0.1f), 0.001f);
+	testLinearTrack();
+
+	return Test::result("MotionCodecTest");
+}
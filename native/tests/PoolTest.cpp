@@ -0,0 +1,94 @@
+#include "StdAfx.hpp"
+#include "Pool.hpp"
+#include "Test.hpp"
+
+#include <set>
+
+namespace
+{
+	int s_live = 0;
+
+	struct Item
+	{
+		explicit Item(int value)
+			: value(value)
+		{
+			s_live++;
+		}
+
+		~Item()
+		{
+			s_live--;
+		}
+
+		double pad;
+		int value;
+	};
+
+	void testReuse()
+	{
+		Pool<Item, 4> pool;
+
+		void* const a = pool.allocate();
+		void* const b = pool.allocate();
+		CHECK(a != b);
+		CHECK(pool.size() == 2 && pool.slabCount() == 1);
+
+		// the last freed slot is handed out first
+		pool.free(a);
+		CHECK(pool.allocate() == a);
+
+		pool.free(b);
+		pool.free(a);
+		CHECK(pool.size() == 0 && pool.slabCount() == 1);
+	}
+
+	void testGrowth()
+	{
+		const double slabAllocs = Stats::total(Stats::PoolSlabAllocs);
+
+		Pool<Item, 4> pool;
+		vector<Item*> items;
+		set<Item*> unique;
+
+		for (int i = 0; i < 10; i++)
+		{
+			items.push_back(pool.create(i));
+			unique.insert(items.back());
+			CHECK(((uintptr_t)items.back() % alignof(Item)) == 0);
+		}
+
+		CHECK(unique.size() == 10);
+		CHECK(pool.size() == 10 && pool.slabCount() == 3);
+		CHECK(Stats::total(Stats::PoolSlabAllocs) == slabAllocs + 3.0);
+		CHECK(s_live == 10);
+
+		for (int i = 0; i < 10; i++)
+			CHECK(items[i]->value == i);
+
+		// freed slots are used again before any new slab
+		for (int i = 0; i < 10; i += 2)
+			pool.destroy(items[i]);
+		CHECK(s_live == 5 && pool.size() == 5);
+
+		for (int i = 0; i < 5; i++)
+			CHECK(unique.count(pool.create(100 + i)) == 1);
+		CHECK(pool.slabCount() == 3);
+
+		// clear gives the slabs back without destroying what is left
+		pool.clear();
+		CHECK(pool.size() == 0 && pool.slabCount() == 0);
+		s_live = 0;
+
+		CHECK(pool.create(1)->value == 1);
+		CHECK(pool.slabCount() == 1);
+	}
+}
+
+int main()
+{
+	testReuse();
+	testGrowth();
+
+	return Test::result("PoolTest");
+}
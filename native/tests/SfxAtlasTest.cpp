@@ -0,0 +1,184 @@
+#include "StdAfx.hpp"
+#include "SfxAtlas.hpp"
+#include "BinaryReader.hpp"
+#include "Test.hpp"
+
+namespace
+{
+	// Texture::Format
+	const uint8_t FORMAT_RGBA = 1;
+	const uint8_t FORMAT_DXT1 = 3;
+
+	template<typename T>
+	void append(vector<uint8_t>& out, const T& value)
+	{
+		const uint8_t* const bytes = (const uint8_t*)&value;
+		out.insert(out.end(), bytes, bytes + sizeof(T));
+	}
+
+	// every byte of a block or texel holds the frame, level and unit it was made for
+	uint8_t unitValue(int frame, int level, int unit)
+	{
+		return (uint8_t)(1 + frame * 64 + level * 16 + unit);
+	}
+
+	vector<uint8_t> makeFrame(int frame, uint8_t format, int size, int levelCount)
+	{
+		const int unit = format >= FORMAT_DXT1 ? 4 : 1;
+		const int unitSize = format >= FORMAT_DXT1 ? 8 : 4;
+
+		vector<uint8_t> data;
+		append(data, (uint8_t)1);
+		append(data, format);
+		append(data, (uint8_t)levelCount);
+
+		for (int level = 0; level < levelCount; level++)
+		{
+			const int levelSize = glm::max(size >> level, 1);
+			const int units = (levelSize + unit - 1) / unit;
+
+			append(data, levelSize);
+			append(data, levelSize);
+			append(data, units * units * unitSize);
+			for (int i = 0; i < units * units; i++)
+				data.insert(data.end(), unitSize, unitValue(frame, level, i));
+		}
+
+		return data;
+	}
+
+	struct Level
+	{
+		ivec2 size;
+		vector<uint8_t> data;
+	};
+
+	vector<Level> readLevels(const vector<uint8_t>& texture)
+	{
+		BinaryReader reader(texture.data(), (int)texture.size());
+		reader.skip(sizeof(uint8_t) * 2);
+
+		vector<Level> levels(reader.read<uint8_t>());
+		for (std::size_t i = 0; i < levels.size(); i++)
+		{
+			int dataSize;
+			reader >> levels[i].size.x
+				>> levels[i].size.y
+				>> dataSize;
+
+			levels[i].data.resize(dataSize);
+			reader.read(levels[i].data.data(), dataSize);
+		}
+
+		CHECK(reader.tell() == reader.size());
+		return levels;
+	}
+
+	void testGrid()
+	{
+		CHECK(SfxAtlas::grid(2) == ivec2(2, 1));
+		CHECK(SfxAtlas::grid(3) == ivec2(2, 2));
+		CHECK(SfxAtlas::grid(4) == ivec2(2, 2));
+		CHECK(SfxAtlas::grid(5) == ivec2(4, 2));
+		CHECK(SfxAtlas::grid(16) == ivec2(4, 4));
+		CHECK(SfxAtlas::grid(17) == ivec2(8, 4));
+	}
+
+	void testFrameNames()
+	{
+		vector<string> names;
+
+		SfxAtlas::frameNames("sfx_fire01", 3, names);
+		CHECK(names.size() == 3);
+		CHECK(names[0] == "sfx_fire01" && names[1] == "sfx_fire02" && names[2] == "sfx_fire03");
+
+		SfxAtlas::frameNames("sfx_smoke1", 2, names);
+		CHECK(names.size() == 2);
+		CHECK(names[0] == "sfx_smoke1" && names[1] == "sfx_smoke2");
+
+		CHECK(SfxAtlas::atlasName("sfx_fire01", 3) == "sfx_fire01_atlas3");
+	}
+
+	// 3 frames of 8x8 on a 2x2 grid, the 2x2 and 1x1 mips of a frame are under a block
+	void testBlocks()
+	{
+		vector<vector<uint8_t>> frames;
+		for (int i = 0; i < 3; i++)
+			frames.push_back(makeFrame(i, FORMAT_DXT1, 8, 4));
+
+		vector<uint8_t> atlas;
+		CHECK(SfxAtlas::build(frames, atlas));
+
+		const vector<Level> levels = readLevels(atlas);
+		CHECK(levels.size() == 5);
+		if (levels.size() != 5)
+			return;
+
+		CHECK(levels[0].size == ivec2(16, 16) && levels[0].data.size() == 16 * 8);
+		CHECK(levels[1].size == ivec2(8, 8) && levels[1].data.size() == 4 * 8);
+		CHECK(levels[4].size == ivec2(1, 1) && levels[4].data.size() == 8);
+
+		for (int y = 0; y < 4; y++)
+		{
+			for (int x = 0; x < 4; x++)
+			{
+				const int frame = (y / 2) * 2 + x / 2;
+				const uint8_t expected = frame < 3 ? unitValue(frame, 0, (y % 2) * 2 + x % 2) : 0;
+				CHECK(levels[0].data[(y * 4 + x) * 8] == expected);
+			}
+		}
+
+		for (int i = 0; i < 3; i++)
+			CHECK(levels[1].data[i * 8] == unitValue(i, 1, 0));
+
+		// sampled from the last level the frames filled whole blocks of
+		for (int level = 2; level < 5; level++)
+			CHECK(levels[level].data[0] == unitValue(0, 1, 0));
+	}
+
+	void testTexels()
+	{
+		vector<vector<uint8_t>> frames;
+		frames.push_back(makeFrame(0, FORMAT_RGBA, 2, 2));
+		frames.push_back(makeFrame(1, FORMAT_RGBA, 2, 2));
+
+		vector<uint8_t> atlas;
+		CHECK(SfxAtlas::build(frames, atlas));
+
+		const vector<Level> levels = readLevels(atlas);
+		CHECK(levels.size() == 3);
+		if (levels.size() != 3)
+			return;
+
+		CHECK(levels[0].size == ivec2(4, 2));
+		CHECK(levels[0].data[(1 * 4 + 3) * 4] == unitValue(1, 0, 3));
+		CHECK(levels[1].size == ivec2(2, 1));
+		CHECK(levels[1].data[4] == unitValue(1, 1, 0));
+		CHECK(levels[2].size == ivec2(1, 1));
+	}
+
+	void testMismatch()
+	{
+		vector<vector<uint8_t>> frames;
+		frames.push_back(makeFrame(0, FORMAT_DXT1, 8, 4));
+		frames.push_back(makeFrame(1, FORMAT_DXT1, 16, 5));
+
+		vector<uint8_t> atlas;
+		CHECK(!SfxAtlas::build(frames, atlas));
+
+		frames[1] = makeFrame(1, FORMAT_DXT1, 8, 4);
+		frames[1].resize(frames[1].size() - 1);
+		CHECK(!SfxAtlas::build(frames, atlas));
+	}
+}
+
+int main()
+{
+	testGrid();
+	testFrameNames();
+	testBlocks();
+	testTexels();
+	testMismatch();
+
+	return Test::result("SfxAtlasTest");
+}
@@ -0,0 +1,76 @@
+#include "StdAfx.hpp"
+#include "SfxKeyFrame.hpp"
+#include "Test.hpp"
+
+namespace
+{
+	int linearFind(const vector<SfxKeyFrame>& keys, int frame)
+	{
+		int ret = -1;
+		for (std::size_t i = 0; i < keys.size(); i++)
+			if (keys[i].frame <= frame)
+				ret = (int)i;
+		return ret;
+	}
+
+	vector<SfxKeyFrame> makeKeys(int count, int firstFrame)
+	{
+		vector<SfxKeyFrame> keys(count);
+		int frame = firstFrame;
+		for (int i = 0; i < count; i++)
+		{
+			keys[i].frame = frame;
+			// uneven spacing with some keys a single frame apart
+			frame += 1 + (i * 7) % 5;
+		}
+		return keys;
+	}
+
+	void testBinarySearch()
+	{
+		const vector<SfxKeyFrame> keys = makeKeys(40, 3);
+
+		for (int frame = -2; frame < keys.back().frame + 5; frame++)
+			CHECK(SfxKeys::find(&keys[0], (int)keys.size(), frame) == linearFind(keys, frame));
+
+		CHECK(SfxKeys::find(&keys[0], 0, 10) == -1);
+	}
+
+	void testCursor()
+	{
+		const vector<SfxKeyFrame> keys = makeKeys(40, 3);
+		const int keyCount = (int)keys.size();
+		const int lastFrame = keys.back().frame;
+		int cursor = -1;
+
+		// playing forward one frame at a time
+		for (int frame = 0; frame <= lastFrame + 2; frame++)
+		{
+			const int expected = linearFind(keys, frame);
+			CHECK(SfxKeys::find(&keys[0], keyCount, frame, cursor) == expected);
+			if (expected >= 0)
+				CHECK(cursor == expected);
+		}
+
+		// big jumps forward, looping back to the start and a stale cursor
+		const int frames[] = { 5, 60, 61, 2, 0, lastFrame, 10, 9 };
+		for (std::size_t i = 0; i < sizeof(frames) / sizeof(int); i++)
+			CHECK(SfxKeys::find(&keys[0], keyCount, frames[i], cursor) == linearFind(keys, frames[i]));
+
+		cursor = keyCount + 3;
+		CHECK(SfxKeys::find(&keys[0], keyCount, 20, cursor) == linearFind(keys, 20));
+
+		// before the first key the cursor is left alone
+		cursor = 4;
+		CHECK(SfxKeys::find(&keys[0], keyCount, 1, cursor) == -1);
+		CHECK(cursor == 4);
+	}
+}
+
+int main()
+{
+	testBinarySearch();
+	testCursor();
+
+	return Test::result("SfxKeyFrameTest");
+}
@@ -0,0 +1,97 @@
+#include "StdAfx.hpp"
+#include "SfxParticlePool.hpp"
+#include "Stats.hpp"
+#include "Test.hpp"
+
+namespace
+{
+	// spawns count particles tagged with their spawn index in PosX
+	void spawnWave(SfxParticlePool& pool, int first, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			const int p = pool.spawn();
+			CHECK(p >= 0);
+			if (p >= 0)
+				pool.set(SfxParticlePool::PosX, p, vec3((float)(first + i), 0.0f, 0.0f));
+		}
+	}
+
+	void testGrow()
+	{
+		SfxParticlePool pool(16, false);
+		CHECK(pool.capacity() == 16);
+
+		spawnWave(pool, 0, 100);
+		CHECK(pool.size() == 100);
+		CHECK(pool.capacity() == 128);
+
+		for (int i = 0; i < pool.size(); i++)
+			CHECK(pool.get(SfxParticlePool::PosX, i).x == (float)i);
+	}
+
+	void testDrops()
+	{
+		const double drops = Stats::total(Stats::SfxParticleDrops);
+
+		SfxParticlePool pool(1 << 14, false);
+		spawnWave(pool, 0, 1 << 14);
+		CHECK(pool.spawn() == -1);
+		CHECK(pool.size() == 1 << 14);
+		CHECK(Stats::total(Stats::SfxParticleDrops) == drops + 1.0);
+	}
+
+	// particles spawned one wave per step die in spawn order, the ordered pool keeps the survivors sorted
+	void testOrder(bool ordered)
+	{
+		SfxParticlePool pool(16, ordered);
+		const int lifetime = 3;
+		int next = 0;
+
+		for (int step = 0; step < 10; step++)
+		{
+			pool.step(lifetime, vec3(0.0f));
+			spawnWave(pool, next, 5);
+			next += 5;
+		}
+
+		CHECK(pool.size() == 15);
+
+		bool sorted = true;
+		for (int i = 1; i < pool.size(); i++)
+			sorted = sorted && pool.get(SfxParticlePool::PosX, i - 1).x < pool.get(SfxParticlePool::PosX, i).x;
+
+		if (ordered)
+			CHECK(sorted);
+		else
+			CHECK(!sorted);
+	}
+
+	void testIntegrate()
+	{
+		SfxParticlePool pool(16, true);
+		const int p = pool.spawn();
+		pool.set(SfxParticlePool::PosX, p, vec3(1.0f, 2.0f, 3.0f));
+		pool.set(SfxParticlePool::SpeedX, p, vec3(0.5f, 0.0f, -1.0f));
+
+		pool.step(100, vec3(0.0f, -0.25f, 0.0f));
+		pool.step(100, vec3(0.0f, -0.25f, 0.0f));
+
+		const vec3 pos = pool.get(SfxParticlePool::PosX, p);
+		CHECK_NEAR(pos.x, 2.0, 1e-6);
+		CHECK_NEAR(pos.y, 1.75, 1e-6);
+		CHECK_NEAR(pos.z, 1.0, 1e-6);
+		CHECK(pool.frame(p) == 2);
+	}
+}
+
+int main()
+{
+	testGrow();
+	testDrops();
+	testOrder(true);
+	testOrder(false);
+	testIntegrate();
+
+	return Test::result("SfxParticlePoolTest");
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) \
+			Test::fail(__FILE__, __LINE__, #cond); \
+	} while (0)
+
+#define CHECK_NEAR(a, b, eps) CHECK(fabs((double)(a) - (double)(b)) <= (eps))
+
+namespace Test
+{
+	inline int& failures()
+	{
+		static int s_failures = 0;
+		return s_failures;
+	}
+
+	inline void fail(const char* file, int line, const char* cond)
+	{
+		fprintf(stderr, "%s:%d: check failed: %s\n", file, line, cond);
+		failures()++;
+	}
+
+	inline int result(const char* name)
+	{
+		if (failures())
+			fprintf(stderr, "%s: %d check(s) failed\n", name, failures());
+		else
+			printf("%s: ok\n", name);
+		return failures() ? 1 : 0;
+	}
+}
@@ -0,0 +1,165 @@
+#include "StdAfx.hpp"
+#include "WeakCache.hpp"
+#include "Test.hpp"
+
+namespace
+{
+	const std::size_t ASSET_BYTES = 1024;
+	// keys of an area, the next area starts AREA_STRIDE keys further so neighbours share most of them
+	const int AREA_ASSETS = 32;
+	const int AREA_STRIDE = 8;
+	const double STEP_TIME = 100.0;
+	const double GRACE = 1000.0;
+	const std::size_t BUDGET = 128 * ASSET_BYTES;
+
+	int s_live = 0;
+
+	class Asset : public RefCounted
+	{
+	public:
+		explicit Asset(int key)
+			: m_key(key)
+		{
+			s_live++;
+		}
+
+		virtual ~Asset()
+		{
+			s_live--;
+		}
+
+		int key() const {
+			return m_key;
+		}
+
+	private:
+		const int m_key;
+	};
+
+	typedef RefCountedPtr<Asset> AssetPtr;
+
+	AssetPtr get(WeakCache<int, Asset>& cache, int key)
+	{
+		AssetPtr asset = cache.find(key);
+		if (asset)
+			return asset;
+
+		asset = AssetPtr::create(key);
+		cache.insert(key, asset);
+		return asset;
+	}
+
+	// TextureManager::collect for a single cache
+	int collect(WeakCache<int, Asset>& cache, double now, std::size_t overBytes)
+	{
+		vector<pair<double, Asset*>> released;
+		cache.released(now, GRACE, released);
+		if (released.empty())
+			return 0;
+
+		sort(released.begin(), released.end(), [](const pair<double, Asset*>& a, const pair<double, Asset*>& b) {
+			return a.first < b.first;
+		});
+
+		double time = released[0].first;
+		std::size_t freed = 0;
+
+		for (std::size_t i = 0; i < released.size() && freed < overBytes; i++)
+		{
+			time = released[i].first;
+			freed += ASSET_BYTES;
+		}
+
+		return cache.evict(time);
+	}
+
+	// walks the camera over many areas and back, with the collection Window runs over the budget
+	void testSoak()
+	{
+		const double resurrections = Stats::total(Stats::CacheResurrections);
+		int evicted = 0;
+
+		{
+			WeakCache<int, Asset> cache;
+			vector<AssetPtr> held;
+			double now = 0.0;
+
+			const int areaCount = 200;
+			for (int step = 0; step < areaCount * 2; step++)
+			{
+				const int area = step < areaCount ? step : areaCount * 2 - 1 - step;
+
+				vector<AssetPtr> next;
+				for (int i = 0; i < AREA_ASSETS; i++)
+					next.push_back(get(cache, area * AREA_STRIDE + i));
+				held.swap(next);
+				next.clear();
+
+				now += STEP_TIME;
+				cache.update(now);
+
+				const std::size_t bytes = cache.size() * ASSET_BYTES;
+				if (bytes > BUDGET)
+					evicted += collect(cache, now, bytes - BUDGET);
+
+				// nothing is kept alive but what the cache holds, and the area in use never goes
+				CHECK(s_live == (int)cache.size());
+				for (std::size_t i = 0; i < held.size(); i++)
+					CHECK(cache.find(held[i]->key()).get() == held[i].get());
+
+				// still over the budget only with entries released within the grace period
+				if (cache.size() * ASSET_BYTES > BUDGET)
+				{
+					vector<pair<double, Asset*>> released;
+					cache.released(now, GRACE, released);
+					CHECK(released.empty());
+				}
+
+				CHECK(cache.size() * ASSET_BYTES <= BUDGET + (std::size_t)(GRACE / STEP_TIME + 1) * AREA_STRIDE * ASSET_BYTES + AREA_ASSETS * ASSET_BYTES);
+			}
+
+			CHECK(evicted > 0);
+		}
+
+		// turning back finds the assets of the last areas before they are evicted
+		CHECK(Stats::total(Stats::CacheResurrections) > resurrections);
+		CHECK(s_live == 0);
+	}
+
+	void testReleased()
+	{
+		WeakCache<int, Asset> cache;
+		AssetPtr asset = get(cache, 1);
+		Asset* const raw = asset.get();
+
+		cache.update(0.0);
+		asset = nullptr;
+		cache.update(100.0);
+
+		vector<pair<double, Asset*>> released;
+		cache.released(100.0 + GRACE - 1.0, GRACE, released);
+		CHECK(released.empty());
+
+		cache.released(100.0 + GRACE, GRACE, released);
+		CHECK(released.size() == 1 && released[0].first == 100.0 && released[0].second == raw);
+
+		// found again, stamped anew by the next update once released
+		asset = cache.find(1);
+		CHECK(asset.get() == raw);
+		CHECK(cache.evict(100.0) == 0);
+
+		asset = nullptr;
+		cache.update(500.0);
+		CHECK(cache.evict(100.0) == 0);
+		CHECK(cache.evict(500.0) == 1);
+		CHECK(cache.size() == 0 && s_live == 0);
+	}
+}
+
+int main()
+{
+	testReleased();
+	testSoak();
+
+	return Test::result("WeakCacheTest");
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+// whole file reads and writes of the offline tools
+namespace Files
+{
+	inline bool read(const string& filename, vector<uint8_t>& data)
+	{
+		FILE* const file = fopen(filename.c_str(), "rb");
+		if (!file)
+			return false;
+
+		fseek(file, 0, SEEK_END);
+		data.resize((std::size_t)ftell(file));
+		fseek(file, 0, SEEK_SET);
+
+		const bool ret = data.empty() || fread(&data[0], 1, data.size(), file) == data.size();
+		fclose(file);
+		return ret;
+	}
+
+	inline bool write(const string& filename, const vector<uint8_t>& data)
+	{
+		FILE* const file = fopen(filename.c_str(), "wb");
+		if (!file)
+			return false;
+
+		const bool ret = data.empty() || fwrite(&data[0], 1, data.size(), file) == data.size();
+		return fclose(file) == 0 && ret;
+	}
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "Vertex.hpp"
+
+// walkers of the model file records for the offline tools, which create no GL objects
+// they follow Object3D::load and SfxBase::load field by field
+namespace ModelRecords
+{
+	// LOD_COUNT of Object3D.hpp
+	const int objectLodCount = 3;
+
+	// SfxPartType of SfxBase.hpp
+	enum SfxPartType
+	{
+		SfxBill = 1,
+		SfxParticle,
+		SfxMesh,
+		SfxCustomMesh
+	};
+
+	struct SfxTexture
+	{
+		uint8_t partType;
+		int frameCount;
+		string name;
+	};
+
+	inline void skipObject3D(BinaryReader& reader)
+	{
+		reader.skip(sizeof(vec3) * 2);
+		const bool LOD = reader.read<bool>();
+		reader.skip(sizeof(bool));
+
+		reader.skip(sizeof(vec3) * reader.read<int>());
+		reader.skip(sizeof(uint16_t) * reader.read<int>());
+
+		const int normalVertexCount = reader.read<int>();
+		const int skinVertexCount = reader.read<int>();
+		reader.skip(sizeof(NormalObjectVertex) * normalVertexCount + sizeof(SkinObjectVertex) * skinVertexCount);
+
+		reader.skip(sizeof(uint16_t) * reader.read<int>());
+
+		const int textureCount = reader.read<int>();
+		for (int i = 0; i < textureCount; i++)
+			reader.skip(reader.read<int>());
+
+		// index count, texture, effect, alpha and first index
+		reader.skip((sizeof(int) * 2 + sizeof(uint32_t) * 2 + sizeof(float)) * reader.read<int>());
+		// type, first index, triangle count, first material block, material block count and bone
+		reader.skip(sizeof(int) * 6 * reader.read<int>());
+
+		reader.skip(sizeof(int) * 2 * (LOD ? objectLodCount : 1));
+	}
+
+	// textures gets the texture of each part when given
+	inline bool readSfx(BinaryReader& reader, vector<SfxTexture>* textures = nullptr)
+	{
+		reader.skip(sizeof(vec3) * 2 + sizeof(int));
+		const int partCount = reader.read<int>();
+
+		for (int i = 0; i < partCount; i++)
+		{
+			const uint8_t type = reader.read<uint8_t>();
+			if (type < SfxBill || type > SfxCustomMesh)
+			{
+				emscripten_log(EM_LOG_ERROR, "Unknown sfx part type %d", type);
+				return false;
+			}
+
+			// bill and alpha types, texture frame and loop, texture name
+			reader.skip(sizeof(uint8_t) * 2);
+			const int frameCount = reader.read<int>();
+			reader.skip(sizeof(int));
+
+			char name[256];
+			const uint8_t nameLen = reader.read<uint8_t>();
+			reader.read(name, nameLen);
+			name[nameLen] = '\0';
+
+			if (textures)
+			{
+				SfxTexture texture;
+				texture.partType = type;
+				texture.frameCount = frameCount;
+				texture.name = name;
+				textures->push_back(texture);
+			}
+
+			// pos, pos rotate, rotate, scale, alpha and frame per key
+			reader.skip((sizeof(vec3) * 4 + sizeof(float) + sizeof(int)) * reader.read<int>());
+
+			if (type == SfxCustomMesh)
+				reader.skip(sizeof(int));
+			else if (type == SfxParticle)
+			{
+				// creation and frame counts, spawn ranges, vectors, repeat flags and scale speed ranges
+				reader.skip(sizeof(int) * 5 + sizeof(float) * 6 + sizeof(vec3) * 5 + sizeof(bool)
+					+ sizeof(float) * 6 + sizeof(vec3) * 2 + sizeof(bool));
+			}
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,175 @@
+#include "StdAfx.hpp"
+#include "ModelFile.hpp"
+#include "ModelRecords.hpp"
+#include "Files.hpp"
+#include "Codec.hpp"
+
+// rewrites the Motion components of model files as CompressedMotion, the other components are copied as they are
+// usage: MotionConverter <input> <output> [rotation tolerance in degrees] [position tolerance]
+
+typedef ModelFile::ComponentType ComponentType;
+
+using namespace ModelRecords;
+
+namespace
+{
+	bool convertMotions(BinaryReader reader, vector<uint8_t>& out, float rotTolerance, float posTolerance)
+	{
+		struct Component
+		{
+			ComponentType type;
+			int start, end;
+			string name;
+			Motion* motion;
+		};
+
+		vector<Component> components;
+		Arena arena;
+		Skeleton* skeleton = nullptr;
+
+		const uint8_t ver = reader.read<uint8_t>();
+
+		uint8_t type, nameLen;
+		char name[32];
+		bool valid = true;
+
+		do
+		{
+			Component component;
+			component.start = reader.tell();
+			component.motion = nullptr;
+
+			reader >> type
+				>> nameLen;
+
+			if (nameLen >= sizeof(name))
+			{
+				emscripten_log(EM_LOG_ERROR, "Component name too long (%d)", nameLen);
+				valid = false;
+				break;
+			}
+
+			if (nameLen)
+				reader.read(name, nameLen);
+			name[nameLen] = '\0';
+
+			component.type = (ComponentType)type;
+			component.name = name;
+
+			switch (component.type)
+			{
+			case ComponentType::None:
+				break;
+			case ComponentType::Object3D:
+				skipObject3D(reader);
+				break;
+			case ComponentType::Skeleton:
+				skeleton = new Skeleton();
+				skeleton->load(reader, ver, arena);
+				break;
+			case ComponentType::Sfx:
+				valid = readSfx(reader);
+				break;
+			case ComponentType::Motion:
+				component.motion = new Motion(name);
+				component.motion->load(reader, ver, arena);
+				break;
+			case ComponentType::CompressedMotion:
+				component.motion = new Motion(name);
+				component.motion->loadCompressed(reader, ver, arena);
+				break;
+			default:
+				emscripten_log(EM_LOG_ERROR, "Unknown model component type %d", type);
+				valid = false;
+				break;
+			}
+
+			component.end = reader.tell();
+			if (component.end > reader.size())
+			{
+				emscripten_log(EM_LOG_ERROR, "Truncated component '%s'", name);
+				valid = false;
+			}
+
+			components.push_back(component);
+
+		} while (valid && type != (uint8_t)ComponentType::None && reader.tell() < reader.size());
+
+		if (valid)
+		{
+			out.clear();
+			out.push_back(ver);
+
+			for (std::size_t i = 0; i < components.size(); i++)
+			{
+				Component& component = components[i];
+
+				if (component.type != ComponentType::Motion)
+				{
+					out.insert(out.end(), reader.data() + component.start, reader.data() + component.end);
+					continue;
+				}
+
+				MotionCompressionStats stats;
+				component.motion->compress(arena, skeleton, rotTolerance, posTolerance, &stats);
+
+				emscripten_log(EM_LOG_CONSOLE, "Motion '%s': %d/%d keys, %d -> %d bytes, max error %.4f deg %.5f units",
+					component.name.c_str(), stats.keyCount, stats.frameCount, stats.rawSize, stats.compressedSize,
+					degrees(stats.maxRotError), stats.maxPosError);
+
+				out.push_back((uint8_t)ComponentType::CompressedMotion);
+				out.push_back((uint8_t)component.name.size());
+				out.insert(out.end(), component.name.begin(), component.name.end());
+				component.motion->writeCompressed(out);
+			}
+		}
+
+		for (std::size_t i = 0; i < components.size(); i++)
+			if (components[i].motion)
+				delete components[i].motion;
+		if (skeleton)
+			delete skeleton;
+
+		return valid;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "usage: %s <input> <output> [rotation tolerance in degrees] [position tolerance]\n", argv[0]);
+		return 2;
+	}
+
+	const float rotTolerance = radians(argc > 3 ? (float)atof(argv[3]) : 0.5f);
+	const float posTolerance = argc > 4 ? (float)atof(argv[4]) : 0.005f;
+
+	vector<uint8_t> payload, decoded, converted, out;
+
+	if (!Files::read(argv[1], payload))
+	{
+		emscripten_log(EM_LOG_ERROR, "Can't read '%s'", argv[1]);
+		return 1;
+	}
+
+	// model files are served as codec payloads
+	if (!Codec::decodePayload(payload.data(), (int)payload.size(), decoded))
+	{
+		emscripten_log(EM_LOG_ERROR, "Invalid model payload '%s'", argv[1]);
+		return 1;
+	}
+
+	if (!convertMotions(BinaryReader(decoded.data(), (int)decoded.size()), converted, rotTolerance, posTolerance))
+		return 1;
+
+	Codec::encodePayload(Codec::Zlib, converted.data(), (int)converted.size(), out);
+
+	if (!Files::write(argv[2], out))
+	{
+		emscripten_log(EM_LOG_ERROR, "Can't write '%s'", argv[2]);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,184 @@
+#include "StdAfx.hpp"
+#include "Pack.hpp"
+#include "Codec.hpp"
+#include "Files.hpp"
+
+// writes the resource pack of a deploy, the flipbook atlases of SfxAtlasTool can be listed like any other file
+// usage: PackTool <resources directory> <zlib|lz4|stored> <files...>, the files relative to the resources directory
+// the %CJS packages are told from the resources by their header and kept as they are
+
+namespace
+{
+	struct Source
+	{
+		string filename;
+		vector<uint8_t> data;
+		// resource payloads are encoded again when packed, packages are kept as they are
+		bool resource;
+	};
+
+	void append(vector<uint8_t>& out, const void* data, std::size_t size)
+	{
+		out.insert(out.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+	}
+
+	// resources are read in place when the codec is Codec::Stored
+	// logs the served and packed sizes of the resources, and their size and decode speed with each codec
+	bool build(const vector<Source>& sources, Codec::Id codec, vector<uint8_t>& out)
+	{
+		vector<Pack::IndexEntry> index(sources.size());
+		vector<uint8_t> data;
+		vector<uint8_t> decoded;
+		vector<uint8_t> encoded;
+		vector<uint8_t> measured;
+		vector<uint8_t> check;
+		std::size_t servedSize = 0, packedSize = 0, decodedSize = 0;
+		std::size_t codecSize[Codec::Stored] = {};
+		double decodeTime[Codec::Stored] = {};
+
+		const std::size_t indexSize = sizeof(Pack::Header) + sizeof(Pack::IndexEntry) * sources.size();
+		std::size_t offset = (indexSize + PACK_ALIGNMENT - 1) & ~(std::size_t)(PACK_ALIGNMENT - 1);
+
+		for (std::size_t i = 0; i < sources.size(); i++)
+		{
+			const Source& source = sources[i];
+			Pack::IndexEntry& entry = index[i];
+
+			entry.key = Pack::keyOf(source.filename);
+			entry.reserved = 0;
+
+			const void* payload = source.data.data();
+			int size = (int)source.data.size();
+
+			if (source.resource)
+			{
+				// checked before anything is allocated from the size field
+				if (!Codec::decodePayload(payload, size, decoded))
+				{
+					emscripten_log(EM_LOG_ERROR, "Invalid resource payload '%s'", source.filename.c_str());
+					return false;
+				}
+
+				servedSize += size;
+				decodedSize += decoded.size();
+
+				// every resource is encoded with each codec to log the sizes and decode speeds side by side
+				check.resize(decoded.size());
+				for (int c = 0; c < Codec::Stored; c++)
+				{
+					measured.clear();
+					Codec::encode((Codec::Id)c, decoded.data(), (int)decoded.size(), measured);
+
+					const double start = emscripten_get_now();
+					const bool decodedBack = Codec::decode((Codec::Id)c, measured.data(), (int)measured.size(), check.data(), (int)check.size());
+					decodeTime[c] += emscripten_get_now() - start;
+					codecSize[c] += measured.size() + sizeof(uint32_t);
+
+					// a codec that doesn't give the resource back would be timed on garbage, and packed as such
+					if (!decodedBack || (!check.empty() && memcmp(check.data(), decoded.data(), check.size()) != 0))
+					{
+						emscripten_log(EM_LOG_ERROR, "Codec %d doesn't round trip '%s'", c, source.filename.c_str());
+						return false;
+					}
+				}
+
+				if (codec == Codec::Stored)
+				{
+					payload = decoded.data();
+					size = (int)decoded.size();
+					entry.storage = Pack::Stored;
+				}
+				else
+				{
+					encoded.clear();
+					Codec::encodePayload(codec, decoded.data(), (int)decoded.size(), encoded);
+
+					payload = encoded.data();
+					size = (int)encoded.size();
+					entry.storage = Pack::Compressed;
+				}
+
+				packedSize += size;
+			}
+			else
+				entry.storage = Pack::Stored;
+
+			entry.offset = (uint32_t)offset;
+			entry.size = (uint32_t)size;
+
+			data.resize(offset - indexSize);
+			append(data, payload, size);
+			offset = (indexSize + data.size() + PACK_ALIGNMENT - 1) & ~(std::size_t)(PACK_ALIGNMENT - 1);
+		}
+
+		emscripten_log(EM_LOG_CONSOLE, "Packed %d files, resources %u -> %u bytes (codec %d)",
+			(int)sources.size(), (unsigned)servedSize, (unsigned)packedSize, codec);
+		emscripten_log(EM_LOG_CONSOLE, "Resources %u bytes decoded: zlib %u bytes %.1f MB/s, LZ4 %u bytes %.1f MB/s",
+			(unsigned)decodedSize,
+			(unsigned)codecSize[Codec::Zlib], decodeTime[Codec::Zlib] > 0.0 ? decodedSize / (decodeTime[Codec::Zlib] * 1000.0) : 0.0,
+			(unsigned)codecSize[Codec::LZ4], decodeTime[Codec::LZ4] > 0.0 ? decodedSize / (decodeTime[Codec::LZ4] * 1000.0) : 0.0);
+
+		const Pack::Header header = { PACK_MAGIC, PACK_VERSION, (uint32_t)sources.size(), 0 };
+
+		out.clear();
+		out.reserve(indexSize + data.size());
+		append(out, &header, sizeof(Pack::Header));
+		if (!index.empty())
+			append(out, index.data(), sizeof(Pack::IndexEntry) * index.size());
+		append(out, data.data(), data.size());
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 4)
+	{
+		fprintf(stderr, "usage: %s <resources directory> <zlib|lz4|stored> <files...>\n", argv[0]);
+		return 2;
+	}
+
+	const string dir = string(argv[1]) + "/";
+	const string codecName = argv[2];
+	Codec::Id codec;
+
+	if (codecName == "zlib")
+		codec = Codec::Zlib;
+	else if (codecName == "lz4")
+		codec = Codec::LZ4;
+	else if (codecName == "stored")
+		codec = Codec::Stored;
+	else
+	{
+		emscripten_log(EM_LOG_ERROR, "Unknown codec '%s'", argv[2]);
+		return 2;
+	}
+
+	vector<Source> sources(argc - 3);
+	for (int i = 3; i < argc; i++)
+	{
+		Source& source = sources[i - 3];
+		source.filename = argv[i];
+
+		if (!Files::read(dir + argv[i], source.data))
+		{
+			emscripten_log(EM_LOG_ERROR, "Can't read '%s'", argv[i]);
+			return 1;
+		}
+
+		// packages have their own header and compression
+		source.resource = source.data.size() < 4 || memcmp(source.data.data(), "%CJS", 4) != 0;
+	}
+
+	vector<uint8_t> pack;
+	if (!build(sources, codec, pack))
+		return 1;
+
+	if (!Files::write(dir + "resources.fpak", pack))
+	{
+		emscripten_log(EM_LOG_ERROR, "Can't write the pack");
+		return 1;
+	}
+
+	return 0;
+}
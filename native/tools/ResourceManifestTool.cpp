@@ -0,0 +1,47 @@
+#include "StdAfx.hpp"
+#include "ResourceManifest.hpp"
+#include "Files.hpp"
+
+// writes the resource manifest of a deploy, run again whenever a served file changes
+// usage: ResourceManifestTool <resources directory> <files...>, the files relative to the resources directory
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "usage: %s <resources directory> <files...>\n", argv[0]);
+		return 2;
+	}
+
+	const string dir = string(argv[1]) + "/";
+	vector<uint8_t> out, payload;
+
+	const uint32_t magic = RESOURCE_MANIFEST_MAGIC;
+	const uint32_t count = (uint32_t)(argc - 2);
+	out.insert(out.end(), (const uint8_t*)&magic, (const uint8_t*)&magic + sizeof(magic));
+	out.insert(out.end(), (const uint8_t*)&count, (const uint8_t*)&count + sizeof(count));
+
+	for (int i = 2; i < argc; i++)
+	{
+		if (!Files::read(dir + argv[i], payload))
+		{
+			emscripten_log(EM_LOG_ERROR, "Can't read '%s'", argv[i]);
+			return 1;
+		}
+
+		ResourceManifest::Entry entry;
+		entry.key = ResourceManifest::keyOf(argv[i]);
+		entry.hash = ResourceManifest::hashOf(payload.data(), payload.size());
+		entry.size = (uint32_t)payload.size();
+		out.insert(out.end(), (const uint8_t*)&entry, (const uint8_t*)&entry + sizeof(entry));
+	}
+
+	if (!Files::write(dir + RESOURCE_MANIFEST, out))
+	{
+		emscripten_log(EM_LOG_ERROR, "Can't write the manifest");
+		return 1;
+	}
+
+	emscripten_log(EM_LOG_CONSOLE, "Manifest of %d resources", (int)count);
+	return 0;
+}
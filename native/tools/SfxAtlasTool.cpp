@@ -0,0 +1,166 @@
+#include "StdAfx.hpp"
+#include "ModelFile.hpp"
+#include "ModelRecords.hpp"
+#include "Files.hpp"
+#include "SfxAtlas.hpp"
+#include "Codec.hpp"
+
+#include <set>
+
+// writes the flipbook atlas of every animated texture the sfx of the model files use, next to the frame textures
+// usage: SfxAtlasTool <resources directory> <model files...>
+
+typedef ModelFile::ComponentType ComponentType;
+
+using namespace ModelRecords;
+
+namespace
+{
+	// the directory Texture::makeFilename gives the compressed sfx textures
+	const char* const textureDir = "model/texture_dxt/";
+
+	bool readTextures(BinaryReader reader, vector<SfxTexture>& textures)
+	{
+		Arena arena;
+		const uint8_t ver = reader.read<uint8_t>();
+
+		uint8_t type, nameLen;
+		char name[32];
+
+		do
+		{
+			reader >> type
+				>> nameLen;
+
+			if (nameLen >= sizeof(name))
+			{
+				emscripten_log(EM_LOG_ERROR, "Component name too long (%d)", nameLen);
+				return false;
+			}
+
+			if (nameLen)
+				reader.read(name, nameLen);
+			name[nameLen] = '\0';
+
+			switch ((ComponentType)type)
+			{
+			case ComponentType::None:
+				break;
+			case ComponentType::Object3D:
+				skipObject3D(reader);
+				break;
+			case ComponentType::Skeleton:
+				Skeleton().load(reader, ver, arena);
+				break;
+			case ComponentType::Sfx:
+				if (!readSfx(reader, &textures))
+					return false;
+				break;
+			case ComponentType::Motion:
+				Motion(name).load(reader, ver, arena);
+				break;
+			case ComponentType::CompressedMotion:
+				Motion(name).loadCompressed(reader, ver, arena);
+				break;
+			default:
+				emscripten_log(EM_LOG_ERROR, "Unknown model component type %d", type);
+				return false;
+			}
+
+			if (reader.tell() > reader.size())
+			{
+				emscripten_log(EM_LOG_ERROR, "Truncated component '%s'", name);
+				return false;
+			}
+
+		} while (type != (uint8_t)ComponentType::None && reader.tell() < reader.size());
+
+		return true;
+	}
+
+	bool readTexture(const string& filename, vector<uint8_t>& texture)
+	{
+		vector<uint8_t> payload;
+		return Files::read(filename, payload) && Codec::decodePayload(payload.data(), (int)payload.size(), texture);
+	}
+
+	bool writeAtlas(const string& dir, const SfxTexture& texture)
+	{
+		vector<string> names;
+		SfxAtlas::frameNames(texture.name.c_str(), texture.frameCount, names);
+
+		vector<vector<uint8_t>> frames(names.size());
+		for (std::size_t i = 0; i < names.size(); i++)
+		{
+			if (!readTexture(dir + textureDir + names[i] + ".bin", frames[i]))
+			{
+				emscripten_log(EM_LOG_ERROR, "Can't read the frame texture '%s'", names[i].c_str());
+				return false;
+			}
+		}
+
+		vector<uint8_t> atlas, out;
+		if (!SfxAtlas::build(frames, atlas))
+			return false;
+
+		Codec::encodePayload(Codec::Zlib, atlas.data(), (int)atlas.size(), out);
+
+		const string atlasName = SfxAtlas::atlasName(texture.name.c_str(), texture.frameCount);
+		if (!Files::write(dir + textureDir + atlasName + ".bin", out))
+		{
+			emscripten_log(EM_LOG_ERROR, "Can't write '%s'", atlasName.c_str());
+			return false;
+		}
+
+		emscripten_log(EM_LOG_CONSOLE, "Atlas '%s': %d frames, %d bytes", atlasName.c_str(), texture.frameCount, (int)out.size());
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "usage: %s <resources directory> <model files...>\n", argv[0]);
+		return 2;
+	}
+
+	const string dir = string(argv[1]) + "/";
+	set<string> done;
+	int failed = 0;
+
+	for (int i = 2; i < argc; i++)
+	{
+		vector<uint8_t> payload, decoded;
+		vector<SfxTexture> textures;
+
+		if (!Files::read(argv[i], payload) || !Codec::decodePayload(payload.data(), (int)payload.size(), decoded))
+		{
+			emscripten_log(EM_LOG_ERROR, "Can't read the model '%s'", argv[i]);
+			failed++;
+			continue;
+		}
+
+		if (!readTextures(BinaryReader(decoded.data(), (int)decoded.size()), textures))
+		{
+			emscripten_log(EM_LOG_ERROR, "Invalid model '%s'", argv[i]);
+			failed++;
+			continue;
+		}
+
+		for (std::size_t j = 0; j < textures.size(); j++)
+		{
+			const SfxTexture& texture = textures[j];
+
+			// the parts SfxPart::setTexture takes an atlas for
+			if (texture.frameCount <= 1 || texture.name.empty() || texture.partType == SfxCustomMesh
+				|| !done.insert(SfxAtlas::atlasName(texture.name.c_str(), texture.frameCount)).second)
+				continue;
+
+			if (!writeAtlas(dir, texture))
+				failed++;
+		}
+	}
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Stats.hpp"
+
+// chunks added once the reserved one is full, or the size of an allocation above it
+#define ARENA_SPILL_CHUNK_SIZE (64 * 1024)
+
+// bump allocator for data released all at once
+// everything fits in the reserved chunk when the reservation is right, fixed size chunks are added otherwise
+class Arena
+{
+public:
+	Arena()
+		: m_reserved(0),
+		m_capacity(0),
+		m_offset(0),
+		m_used(0)
+	{
+	}
+
+	~Arena()
+	{
+		clear();
+	}
+
+	// size of the first chunk, before anything is allocated
+	void reserve(std::size_t size)
+	{
+		m_reserved = size;
+	}
+
+	// default constructed, the destructors of non trivial types are run by the caller before clear
+	template<typename T>
+	T* alloc(int count)
+	{
+		if (count <= 0)
+			return nullptr;
+
+		T* const objs = (T*)allocate(sizeof(T) * count, alignof(T));
+		for (int i = 0; i < count; i++)
+			::new(&objs[i]) T;
+		return objs;
+	}
+
+	void clear()
+	{
+		for (std::size_t i = 0; i < m_chunks.size(); i++)
+			delete[] m_chunks[i];
+		m_chunks.clear();
+		m_capacity = 0;
+		m_offset = 0;
+		m_used = 0;
+	}
+
+	std::size_t used() const {
+		return m_used;
+	}
+	int chunkCount() const {
+		return (int)m_chunks.size();
+	}
+
+private:
+	void* allocate(std::size_t size, std::size_t align)
+	{
+		std::size_t offset = (m_offset + align - 1) & ~(align - 1);
+
+		if (m_chunks.empty() || offset + size > m_capacity)
+		{
+			m_capacity = glm::max(size, m_chunks.empty() ? m_reserved : (std::size_t)ARENA_SPILL_CHUNK_SIZE);
+			m_chunks.push_back(new char[m_capacity]);
+			offset = 0;
+
+			Stats::add(Stats::ArenaChunks);
+			Stats::add(Stats::ArenaBytes, (double)m_capacity);
+		}
+
+		m_offset = offset + size;
+		m_used += size;
+		return m_chunks.back() + offset;
+	}
+
+	std::size_t m_reserved;
+	std::size_t m_capacity;
+	std::size_t m_offset;
+	std::size_t m_used;
+	vector<char*> m_chunks;
+
+private:
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+};
@@ -22,6 +22,16 @@ public:
 		return m_size;
 	}
 
+	const char* data() const
+	{
+		return m_buffer;
+	}
+
+	int tell() const
+	{
+		return (int)(m_cur - m_buffer);
+	}
+
 	template<typename T>
 	void read(T* data, int count) const
 	{
@@ -35,7 +35,8 @@ namespace Canvas2D
 
 			if (s_type != type
 				|| (s_texture ? s_texture->uniqueId() : 0) != (texture && texture->loaded() ? texture->uniqueId() : 0)
-				|| s_enableAlpha != enableAlpha)
+				|| s_enableAlpha != enableAlpha
+				|| s_vertices.size() + (std::size_t)vertexCount > MAX_QUADS * 4)
 			{
 				flush();
 
@@ -119,8 +120,6 @@ namespace Canvas2D
 			return;
 
 		Shaders::render2d.use();
-		ShaderVars::render2dVAO.bind();
-
 		if (s_texture)
 			s_texture->bind();
 		else
@@ -138,13 +137,16 @@ namespace Canvas2D
 		gl::disableDepthTest();
 		gl::disableDepthWrite();
 
-		ShaderVars::render2dVBO.bind();
-		ShaderVars::render2dVBO.data(vertexCount * sizeof(Vertex2D), s_vertices.data(), true);
+		// whole quads, quadsIBO offset to the first one in the segment
+		const GLintptr offset = ShaderVars::render2dVBO.write(s_vertices.data(), vertexCount * sizeof(Vertex2D), 4 * sizeof(Vertex2D));
+		const int firstQuad = gl::StreamBuffer::first(ShaderVars::render2dVBO.segmentOffset(offset), 4 * sizeof(Vertex2D));
+
+		ShaderVars::render2dVAO[ShaderVars::render2dVBO.segment(offset)].bind();
 
 		switch (s_type)
 		{
 		case Quads:
-			gl::drawElements<uint16_t>(GL_TRIANGLES, (vertexCount * 6) / 4, 0);
+			gl::drawElements<uint16_t>(GL_TRIANGLES, (vertexCount * 6) / 4, firstQuad * 6 * sizeof(uint16_t));
 			break;
 		}
 
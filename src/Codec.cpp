@@ -0,0 +1,280 @@
+#include "StdAfx.hpp"
+#include "Codec.hpp"
+#include "Stats.hpp"
+
+#define MINIZ_NO_ARCHIVE_APIS
+#define MINIZ_NO_ARCHIVE_WRITING_APIS
+#define MINIZ_NO_ZLIB_COMPATIBLE_NAMES
+
+#pragma warning(disable: 4334)
+
+#include "miniz.hpp"
+
+// LZ4 block format, the last match starts 12 bytes before the end and the last 5 bytes are literals
+#define LZ4_MIN_MATCH 4
+#define LZ4_MATCH_LIMIT 12
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MAX_OFFSET 65535
+#define LZ4_HASH_BITS 12
+
+// the largest expansions the codecs can encode, a 255 byte length run per output byte for LZ4
+#define ZLIB_MAX_RATIO 1032
+#define LZ4_MAX_RATIO 255
+
+namespace Codec
+{
+	namespace
+	{
+		bool readLength(const uint8_t*& ip, const uint8_t* end, std::size_t& length)
+		{
+			uint8_t b;
+			do
+			{
+				if (ip >= end)
+					return false;
+				b = *ip++;
+				length += b;
+			} while (b == 255);
+			return true;
+		}
+
+		bool decodeLZ4(const uint8_t* src, int srcSize, uint8_t* dst, int dstSize)
+		{
+			const uint8_t* ip = src;
+			const uint8_t* const ipEnd = src + srcSize;
+			uint8_t* op = dst;
+			uint8_t* const opEnd = dst + dstSize;
+
+			while (ip < ipEnd)
+			{
+				const uint8_t token = *ip++;
+
+				std::size_t length = token >> 4;
+				if (length == 15 && !readLength(ip, ipEnd, length))
+					return false;
+				if (length > (std::size_t)(ipEnd - ip) || length > (std::size_t)(opEnd - op))
+					return false;
+
+				memcpy(op, ip, length);
+				op += length;
+				ip += length;
+
+				// the last sequence has no match
+				if (ip == ipEnd)
+					break;
+				if (ipEnd - ip < 2)
+					return false;
+
+				const std::size_t offset = ip[0] | (ip[1] << 8);
+				ip += 2;
+				if (offset == 0 || offset > (std::size_t)(op - dst))
+					return false;
+
+				length = token & 15;
+				if (length == 15 && !readLength(ip, ipEnd, length))
+					return false;
+				length += LZ4_MIN_MATCH;
+				if (length > (std::size_t)(opEnd - op))
+					return false;
+
+				// the match may overlap the bytes it produces
+				const uint8_t* match = op - offset;
+				if (offset >= length)
+					memcpy(op, match, length);
+				else
+				{
+					for (std::size_t i = 0; i < length; i++)
+						op[i] = match[i];
+				}
+				op += length;
+			}
+
+			return op == opEnd;
+		}
+
+		void writeLength(vector<uint8_t>& out, std::size_t length)
+		{
+			while (length >= 255)
+			{
+				out.push_back(255);
+				length -= 255;
+			}
+			out.push_back((uint8_t)length);
+		}
+
+		void writeSequence(vector<uint8_t>& out, const uint8_t* literals, std::size_t literalCount, std::size_t offset, std::size_t matchLength)
+		{
+			const std::size_t matchCode = matchLength ? matchLength - LZ4_MIN_MATCH : 0;
+
+			out.push_back((uint8_t)((glm::min(literalCount, (std::size_t)15) << 4) | glm::min(matchCode, (std::size_t)15)));
+			if (literalCount >= 15)
+				writeLength(out, literalCount - 15);
+			out.insert(out.end(), literals, literals + literalCount);
+
+			if (!matchLength)
+				return;
+
+			out.push_back((uint8_t)(offset & 0xff));
+			out.push_back((uint8_t)(offset >> 8));
+			if (matchCode >= 15)
+				writeLength(out, matchCode - 15);
+		}
+
+		// greedy single probe, decoding speed is what matters
+		void encodeLZ4(const uint8_t* src, int size, vector<uint8_t>& out)
+		{
+			vector<int> table(1 << LZ4_HASH_BITS, -1);
+			int anchor = 0;
+			int i = 0;
+
+			while (i < size - LZ4_MATCH_LIMIT)
+			{
+				uint32_t sequence, candidate;
+				memcpy(&sequence, src + i, 4);
+
+				const uint32_t hash = (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+				const int ref = table[hash];
+				table[hash] = i;
+
+				if (ref < 0 || i - ref > LZ4_MAX_OFFSET)
+				{
+					i++;
+					continue;
+				}
+
+				memcpy(&candidate, src + ref, 4);
+				if (candidate != sequence)
+				{
+					i++;
+					continue;
+				}
+
+				int length = LZ4_MIN_MATCH;
+				while (i + length < size - LZ4_LAST_LITERALS && src[ref + length] == src[i + length])
+					length++;
+
+				writeSequence(out, src + anchor, i - anchor, i - ref, length);
+				i += length;
+				anchor = i;
+			}
+
+			writeSequence(out, src + anchor, size - anchor, 0, 0);
+		}
+	}
+
+	bool decode(Id codec, const void* src, int srcSize, void* dst, int dstSize)
+	{
+		const double start = Stats::now();
+		bool success = false;
+
+		switch (codec)
+		{
+		case Zlib:
+		{
+			mz_ulong len = (mz_ulong)dstSize;
+			success = mz_uncompress((unsigned char*)dst, &len, (const unsigned char*)src, (mz_ulong)srcSize) == MZ_OK
+				&& len == (mz_ulong)dstSize;
+
+			Stats::add(Stats::ZlibDecodeBytes, dstSize);
+			Stats::add(Stats::ZlibDecodeTime, Stats::now() - start);
+			break;
+		}
+		case LZ4:
+			success = decodeLZ4((const uint8_t*)src, srcSize, (uint8_t*)dst, dstSize);
+
+			Stats::add(Stats::LZ4DecodeBytes, dstSize);
+			Stats::add(Stats::LZ4DecodeTime, Stats::now() - start);
+			break;
+		case Stored:
+			success = srcSize == dstSize;
+			if (success)
+				memcpy(dst, src, dstSize);
+			break;
+		default:
+			break;
+		}
+
+		if (!success)
+			emscripten_log(EM_LOG_ERROR, "Failed to decode %d bytes (codec %d)", srcSize, codec);
+		return success;
+	}
+
+	void encode(Id codec, const void* src, int srcSize, vector<uint8_t>& out)
+	{
+		switch (codec)
+		{
+		case Zlib:
+		{
+			mz_ulong len = mz_compressBound((mz_ulong)srcSize);
+			const std::size_t offset = out.size();
+			out.resize(offset + len);
+			mz_compress(out.data() + offset, &len, (const unsigned char*)src, (mz_ulong)srcSize);
+			out.resize(offset + len);
+			break;
+		}
+		case LZ4:
+			encodeLZ4((const uint8_t*)src, srcSize, out);
+			break;
+		default:
+			out.insert(out.end(), (const uint8_t*)src, (const uint8_t*)src + srcSize);
+			break;
+		}
+	}
+
+	int decodedSize(uint32_t field, int encodedSize)
+	{
+		if (encodedSize < 0)
+			return -1;
+
+		const uint64_t size = sizeOf(field);
+
+		switch (idOf(field))
+		{
+		case Zlib:
+			return size <= (uint64_t)encodedSize * ZLIB_MAX_RATIO ? (int)size : -1;
+		case LZ4:
+			return size <= (uint64_t)encodedSize * LZ4_MAX_RATIO ? (int)size : -1;
+		case Stored:
+			return size == (uint64_t)encodedSize ? (int)size : -1;
+		default:
+			return -1;
+		}
+	}
+
+	int payloadSize(const void* payload, int size)
+	{
+		if (size < (int)sizeof(uint32_t))
+			return -1;
+
+		uint32_t field;
+		memcpy(&field, payload, sizeof(uint32_t));
+		return decodedSize(field, size - (int)sizeof(uint32_t));
+	}
+
+	bool decodePayload(const void* payload, int size, void* dst, int dstSize)
+	{
+		if (payloadSize(payload, size) != dstSize)
+			return false;
+
+		uint32_t field;
+		memcpy(&field, payload, sizeof(uint32_t));
+		return decode(idOf(field), (const uint8_t*)payload + sizeof(uint32_t), size - (int)sizeof(uint32_t), dst, dstSize);
+	}
+
+	bool decodePayload(const void* payload, int size, vector<uint8_t>& out)
+	{
+		const int decodedSize = payloadSize(payload, size);
+		if (decodedSize < 0)
+			return false;
+
+		out.resize(decodedSize);
+		return decodePayload(payload, size, out.data(), decodedSize);
+	}
+
+	void encodePayload(Id codec, const void* src, int srcSize, vector<uint8_t>& out)
+	{
+		const uint32_t field = sizeField(codec, (uint32_t)srcSize);
+		out.insert(out.end(), (const uint8_t*)&field, (const uint8_t*)&field + sizeof(uint32_t));
+		encode(codec, src, srcSize, out);
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#define CODEC_SHIFT 28
+#define CODEC_SIZE_MASK ((1u << CODEC_SHIFT) - 1)
+
+// payload codecs, selected per file by an id in the top 4 bits of the uncompressed size field
+// the files written before the id existed have 0 there and are read as zlib
+namespace Codec
+{
+	enum Id
+	{
+		Zlib,
+		LZ4,
+		Stored,
+		MAX_CODEC
+	};
+
+	inline Id idOf(uint32_t sizeField)
+	{
+		return (Id)(sizeField >> CODEC_SHIFT);
+	}
+
+	inline uint32_t sizeOf(uint32_t sizeField)
+	{
+		return sizeField & CODEC_SIZE_MASK;
+	}
+
+	inline uint32_t sizeField(Id codec, uint32_t size)
+	{
+		return ((uint32_t)codec << CODEC_SHIFT) | size;
+	}
+
+	// false when the data is corrupted or doesn't decode to exactly dstSize bytes
+	bool decode(Id codec, const void* src, int srcSize, void* dst, int dstSize);
+	// appends the encoded data to out
+	void encode(Id codec, const void* src, int srcSize, vector<uint8_t>& out);
+
+	// -1 when the size field is not one the codec can produce from encodedSize bytes
+	int decodedSize(uint32_t sizeField, int encodedSize);
+
+	// payloads as served: the size field followed by the encoded data
+	// -1 when the size field is not one the codec can produce from this much data
+	int payloadSize(const void* payload, int size);
+	bool decodePayload(const void* payload, int size, void* dst, int dstSize);
+	bool decodePayload(const void* payload, int size, vector<uint8_t>& out);
+	void encodePayload(Id codec, const void* src, int srcSize, vector<uint8_t>& out);
+}
@@ -0,0 +1,638 @@
+#include "StdAfx.hpp"
+#include "CollisionBVH.hpp"
+#include "Stats.hpp"
+
+#define LEAF_FLAG 0x80000000u
+#define LEAF_COUNT_SHIFT 24
+#define LEAF_FIRST_MASK 0x00ffffffu
+#define MAX_LEAF_TRIANGLES 4
+#define SAH_BIN_COUNT 16
+#define MAX_SAH_DEPTH 40
+#define STACK_SIZE 64
+
+namespace
+{
+	const float quantMax = 65535.0f;
+
+	inline uint32_t makeLeaf(int first, int count)
+	{
+		return LEAF_FLAG | ((uint32_t)count << LEAF_COUNT_SHIFT) | (uint32_t)first;
+	}
+
+	inline float halfArea(const vec3& bbMin, const vec3& bbMax)
+	{
+		const vec3 size = bbMax - bbMin;
+		return size.x * size.y + size.y * size.z + size.z * size.x;
+	}
+
+	inline bool rayBox(const vec3& bbMin, const vec3& bbMax, const vec3& origin, const vec3& invDir, float maxDist, float& tNear)
+	{
+		const vec3 t0 = (bbMin - origin) * invDir;
+		const vec3 t1 = (bbMax - origin) * invDir;
+		const vec3 tMin = glm::min(t0, t1);
+		const vec3 tMax = glm::max(t0, t1);
+
+		tNear = glm::max(glm::max(tMin.x, tMin.y), glm::max(tMin.z, 0.0f));
+		const float tFar = glm::min(glm::min(tMax.x, tMax.y), glm::min(tMax.z, maxDist));
+		return tNear <= tFar;
+	}
+
+	inline bool boxOverlap(const u16vec3& min1, const u16vec3& max1, const u16vec3& min2, const u16vec3& max2)
+	{
+		return min1.x <= max2.x && max1.x >= min2.x
+			&& min1.y <= max2.y && max1.y >= min2.y
+			&& min1.z <= max2.z && max1.z >= min2.z;
+	}
+
+	bool rayTriangle(const vec3& origin, const vec3& dir, const vec3* v, float& t)
+	{
+		const vec3 e1 = v[1] - v[0];
+		const vec3 e2 = v[2] - v[0];
+		const vec3 p = cross(dir, e2);
+		const float det = dot(e1, p);
+		if (glm::abs(det) < 1e-10f)
+			return false;
+
+		const float invDet = 1.0f / det;
+		const vec3 s = origin - v[0];
+		const float u = dot(s, p) * invDet;
+		if (u < 0.0f || u > 1.0f)
+			return false;
+
+		const vec3 q = cross(s, e1);
+		const float w = dot(dir, q) * invDet;
+		if (w < 0.0f || u + w > 1.0f)
+			return false;
+
+		t = dot(e2, q) * invDet;
+		return t >= 0.0f;
+	}
+
+	vec3 closestPointOnTriangle(const vec3& p, const vec3* v)
+	{
+		const vec3 ab = v[1] - v[0];
+		const vec3 ac = v[2] - v[0];
+		const vec3 ap = p - v[0];
+		const float d1 = dot(ab, ap);
+		const float d2 = dot(ac, ap);
+		if (d1 <= 0.0f && d2 <= 0.0f)
+			return v[0];
+
+		const vec3 bp = p - v[1];
+		const float d3 = dot(ab, bp);
+		const float d4 = dot(ac, bp);
+		if (d3 >= 0.0f && d4 <= d3)
+			return v[1];
+
+		const float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+			return v[0] + ab * (d1 / (d1 - d3));
+
+		const vec3 cp = p - v[2];
+		const float d5 = dot(ab, cp);
+		const float d6 = dot(ac, cp);
+		if (d6 >= 0.0f && d5 <= d6)
+			return v[2];
+
+		const float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+			return v[0] + ac * (d2 / (d2 - d6));
+
+		const float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+			return v[1] + (v[2] - v[1]) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+		const float denom = 1.0f / (va + vb + vc);
+		return v[0] + ab * (vb * denom) + ac * (vc * denom);
+	}
+
+	float closestSegmentSegment(const vec3& p1, const vec3& q1, const vec3& p2, const vec3& q2, vec3& c1, vec3& c2)
+	{
+		const vec3 d1 = q1 - p1;
+		const vec3 d2 = q2 - p2;
+		const vec3 r = p1 - p2;
+		const float a = dot(d1, d1);
+		const float e = dot(d2, d2);
+		const float f = dot(d2, r);
+		float s, t;
+
+		if (a <= 1e-8f && e <= 1e-8f)
+		{
+			s = 0.0f;
+			t = 0.0f;
+		}
+		else if (a <= 1e-8f)
+		{
+			s = 0.0f;
+			t = clamp(f / e, 0.0f, 1.0f);
+		}
+		else
+		{
+			const float c = dot(d1, r);
+			if (e <= 1e-8f)
+			{
+				t = 0.0f;
+				s = clamp(-c / a, 0.0f, 1.0f);
+			}
+			else
+			{
+				const float b = dot(d1, d2);
+				const float denom = a * e - b * b;
+
+				s = denom != 0.0f ? clamp((b * f - c * e) / denom, 0.0f, 1.0f) : 0.0f;
+				t = (b * s + f) / e;
+
+				if (t < 0.0f)
+				{
+					t = 0.0f;
+					s = clamp(-c / a, 0.0f, 1.0f);
+				}
+				else if (t > 1.0f)
+				{
+					t = 1.0f;
+					s = clamp((b - c) / a, 0.0f, 1.0f);
+				}
+			}
+		}
+
+		c1 = p1 + d1 * s;
+		c2 = p2 + d2 * t;
+		return dot(c1 - c2, c1 - c2);
+	}
+
+	float closestSegmentTriangle(const vec3& p0, const vec3& p1, const vec3* v, vec3& onSegment, vec3& onTriangle)
+	{
+		float t;
+		if (rayTriangle(p0, p1 - p0, v, t) && t <= 1.0f)
+		{
+			onSegment = onTriangle = p0 + (p1 - p0) * t;
+			return 0.0f;
+		}
+
+		onSegment = p0;
+		onTriangle = closestPointOnTriangle(p0, v);
+		float best = dot(onSegment - onTriangle, onSegment - onTriangle);
+
+		vec3 c1, c2;
+		c2 = closestPointOnTriangle(p1, v);
+		float dist = dot(p1 - c2, p1 - c2);
+		if (dist < best)
+		{
+			best = dist;
+			onSegment = p1;
+			onTriangle = c2;
+		}
+
+		for (int i = 0; i < 3; i++)
+		{
+			dist = closestSegmentSegment(p0, p1, v[i], v[(i + 1) % 3], c1, c2);
+			if (dist < best)
+			{
+				best = dist;
+				onSegment = c1;
+				onTriangle = c2;
+			}
+		}
+
+		return best;
+	}
+}
+
+CollisionBVH::CollisionBVH()
+	: m_vertices(nullptr),
+	m_triangleCount(0),
+	m_root(0)
+{
+}
+
+CollisionBVH::~CollisionBVH()
+{
+}
+
+void CollisionBVH::build(const vec3* vertices, int vertexCount, const uint16_t* indices, int indexCount)
+{
+	Stats::Timer timer(Stats::CollisionBuildTime);
+
+	m_vertices = vertices;
+	m_triangleCount = 0;
+	m_indices.clear();
+	m_nodes.clear();
+
+	const int triangleCount = indexCount / 3;
+	if (!triangleCount || triangleCount > (int)LEAF_FIRST_MASK)
+		return;
+
+	vector<BuildRef> refs(triangleCount);
+
+	int i, j;
+	for (i = 0; i < triangleCount; i++)
+	{
+		BuildRef& ref = refs[i];
+		const uint16_t* const tri = &indices[i * 3];
+
+		for (j = 0; j < 3; j++)
+		{
+			if (tri[j] >= vertexCount)
+			{
+				emscripten_log(EM_LOG_ERROR, "Collision mesh index out of range (%d >= %d)", tri[j], vertexCount);
+				return;
+			}
+		}
+
+		ref.bbMin = glm::min(glm::min(vertices[tri[0]], vertices[tri[1]]), vertices[tri[2]]);
+		ref.bbMax = glm::max(glm::max(vertices[tri[0]], vertices[tri[1]]), vertices[tri[2]]);
+		ref.center = (ref.bbMin + ref.bbMax) * 0.5f;
+		ref.triangle = i;
+
+		if (i == 0)
+		{
+			m_bbMin = ref.bbMin;
+			m_bbMax = ref.bbMax;
+		}
+		else
+		{
+			m_bbMin = glm::min(m_bbMin, ref.bbMin);
+			m_bbMax = glm::max(m_bbMax, ref.bbMax);
+		}
+	}
+
+	m_quantScale = vec3(quantMax) / glm::max(m_bbMax - m_bbMin, vec3(0.0001f));
+	m_triangleCount = triangleCount;
+
+	m_nodes.reserve(triangleCount / 2 + 1);
+	m_root = buildNode(refs, 0, triangleCount, 0);
+
+	m_indices.resize(triangleCount * 3);
+	for (i = 0; i < triangleCount; i++)
+		memcpy(&m_indices[i * 3], &indices[refs[i].triangle * 3], sizeof(uint16_t) * 3);
+
+	Stats::add(Stats::CollisionBuildCount);
+	Stats::add(Stats::CollisionNodeCount, (double)m_nodes.size());
+}
+
+uint32_t CollisionBVH::buildNode(vector<BuildRef>& refs, int first, int count, int depth)
+{
+	if (count <= MAX_LEAF_TRIANGLES)
+		return makeLeaf(first, count);
+
+	const int last = first + count;
+	int i;
+
+	vec3 centerMin = refs[first].center, centerMax = refs[first].center;
+	for (i = first + 1; i < last; i++)
+	{
+		centerMin = glm::min(centerMin, refs[i].center);
+		centerMax = glm::max(centerMax, refs[i].center);
+	}
+
+	const vec3 centerSize = centerMax - centerMin;
+	int axis = 0;
+	if (centerSize.y > centerSize[axis]) axis = 1;
+	if (centerSize.z > centerSize[axis]) axis = 2;
+
+	int mid = -1;
+
+	if (depth < MAX_SAH_DEPTH && centerSize[axis] > 1e-6f)
+	{
+		struct Bin
+		{
+			vec3 bbMin, bbMax;
+			int count;
+		} bins[SAH_BIN_COUNT];
+
+		for (i = 0; i < SAH_BIN_COUNT; i++)
+			bins[i].count = 0;
+
+		const float binFactor = SAH_BIN_COUNT * (1.0f - 1e-5f) / centerSize[axis];
+
+		for (i = first; i < last; i++)
+		{
+			const BuildRef& ref = refs[i];
+			Bin& bin = bins[glm::min(SAH_BIN_COUNT - 1, (int)((ref.center[axis] - centerMin[axis]) * binFactor))];
+
+			if (bin.count)
+			{
+				bin.bbMin = glm::min(bin.bbMin, ref.bbMin);
+				bin.bbMax = glm::max(bin.bbMax, ref.bbMax);
+			}
+			else
+			{
+				bin.bbMin = ref.bbMin;
+				bin.bbMax = ref.bbMax;
+			}
+			bin.count++;
+		}
+
+		float rightCost[SAH_BIN_COUNT];
+		vec3 bbMin, bbMax;
+		int sideCount = 0;
+
+		for (i = SAH_BIN_COUNT - 1; i > 0; i--)
+		{
+			if (bins[i].count)
+			{
+				bbMin = sideCount ? glm::min(bbMin, bins[i].bbMin) : bins[i].bbMin;
+				bbMax = sideCount ? glm::max(bbMax, bins[i].bbMax) : bins[i].bbMax;
+				sideCount += bins[i].count;
+			}
+			rightCost[i] = sideCount ? halfArea(bbMin, bbMax) * sideCount : 0.0f;
+		}
+
+		float bestCost = 0.0f;
+		int bestBin = -1;
+		sideCount = 0;
+
+		for (i = 0; i < SAH_BIN_COUNT - 1; i++)
+		{
+			if (bins[i].count)
+			{
+				bbMin = sideCount ? glm::min(bbMin, bins[i].bbMin) : bins[i].bbMin;
+				bbMax = sideCount ? glm::max(bbMax, bins[i].bbMax) : bins[i].bbMax;
+				sideCount += bins[i].count;
+			}
+
+			if (!sideCount || sideCount == count)
+				continue;
+
+			const float cost = halfArea(bbMin, bbMax) * sideCount + rightCost[i + 1];
+			if (bestBin < 0 || cost < bestCost)
+			{
+				bestCost = cost;
+				bestBin = i;
+			}
+		}
+
+		if (bestBin >= 0)
+		{
+			const float splitMin = centerMin[axis];
+			mid = (int)(std::partition(refs.begin() + first, refs.begin() + last, [=](const BuildRef& ref) {
+				return glm::min(SAH_BIN_COUNT - 1, (int)((ref.center[axis] - splitMin) * binFactor)) <= bestBin;
+			}) - refs.begin());
+		}
+	}
+
+	if (mid <= first || mid >= last)
+	{
+		mid = first + count / 2;
+		std::nth_element(refs.begin() + first, refs.begin() + mid, refs.begin() + last, [=](const BuildRef& a, const BuildRef& b) {
+			return a.center[axis] < b.center[axis];
+		});
+	}
+
+	const uint32_t index = (uint32_t)m_nodes.size();
+	m_nodes.push_back(Node());
+
+	const int ranges[2][2] = { { first, mid }, { mid, last } };
+	u16vec3 qMin[2], qMax[2];
+
+	for (int c = 0; c < 2; c++)
+	{
+		vec3 bbMin = refs[ranges[c][0]].bbMin, bbMax = refs[ranges[c][0]].bbMax;
+		for (i = ranges[c][0] + 1; i < ranges[c][1]; i++)
+		{
+			bbMin = glm::min(bbMin, refs[i].bbMin);
+			bbMax = glm::max(bbMax, refs[i].bbMax);
+		}
+		quantize(bbMin, bbMax, qMin[c], qMax[c]);
+	}
+
+	const uint32_t left = buildNode(refs, first, mid - first, depth + 1);
+	const uint32_t right = buildNode(refs, mid, last - mid, depth + 1);
+
+	Node& node = m_nodes[index];
+	node.bbMin[0] = qMin[0];
+	node.bbMax[0] = qMax[0];
+	node.bbMin[1] = qMin[1];
+	node.bbMax[1] = qMax[1];
+	node.child[0] = left;
+	node.child[1] = right;
+	return index;
+}
+
+void CollisionBVH::quantize(const vec3& bbMin, const vec3& bbMax, u16vec3& qMin, u16vec3& qMax) const
+{
+	const vec3 fMin = clamp(floor((bbMin - m_bbMin) * m_quantScale), 0.0f, quantMax);
+	const vec3 fMax = clamp(ceil((bbMax - m_bbMin) * m_quantScale), 0.0f, quantMax);
+	qMin = u16vec3(fMin);
+	qMax = u16vec3(fMax);
+}
+
+bool CollisionBVH::intersectRay(const mat4& world, const mat4& invWorld, const vec3& origin, const vec3& dir, CollisionHit& hit) const
+{
+	if (empty())
+		return false;
+
+	Stats::Timer timer(Stats::CollisionQueryTime);
+	Stats::add(Stats::CollisionQueryCount);
+
+	// affine transform, so the ray parameter is the same in both spaces
+	const vec3 localOrigin = vec3(invWorld * vec4(origin, 1.0f));
+	const vec3 localDir = vec3(invWorld * vec4(dir, 0.0f));
+
+	const vec3 qOrigin = (localOrigin - m_bbMin) * m_quantScale;
+	vec3 qDir = localDir * m_quantScale;
+	for (int i = 0; i < 3; i++)
+		if (glm::abs(qDir[i]) < 1e-8f)
+			qDir[i] = qDir[i] < 0.0f ? -1e-8f : 1e-8f;
+	const vec3 invDir = vec3(1.0f) / qDir;
+
+	float maxDist = hit.dist;
+	float tNear;
+	if (!rayBox(vec3(0.0f), vec3(quantMax), qOrigin, invDir, maxDist, tNear))
+		return false;
+
+	struct StackEntry
+	{
+		uint32_t ref;
+		float tNear;
+	} stack[STACK_SIZE];
+
+	int stackSize = 0;
+	stack[stackSize].ref = m_root;
+	stack[stackSize].tNear = tNear;
+	stackSize++;
+
+	int best = -1, triangleTests = 0;
+	vec3 v[3];
+
+	while (stackSize)
+	{
+		const StackEntry entry = stack[--stackSize];
+		if (entry.tNear > maxDist)
+			continue;
+
+		if (entry.ref & LEAF_FLAG)
+		{
+			const int first = (int)(entry.ref & LEAF_FIRST_MASK);
+			const int last = first + (int)((entry.ref & ~LEAF_FLAG) >> LEAF_COUNT_SHIFT);
+			float t;
+
+			for (int i = first; i < last; i++)
+			{
+				triangle(i, v);
+				triangleTests++;
+
+				if (rayTriangle(localOrigin, localDir, v, t) && t < maxDist)
+				{
+					maxDist = t;
+					best = i;
+				}
+			}
+		}
+		else
+		{
+			const Node& node = m_nodes[entry.ref];
+			float t0, t1;
+			const bool hit0 = rayBox(vec3(node.bbMin[0]), vec3(node.bbMax[0]), qOrigin, invDir, maxDist, t0);
+			const bool hit1 = rayBox(vec3(node.bbMin[1]), vec3(node.bbMax[1]), qOrigin, invDir, maxDist, t1);
+
+			if (hit0 && hit1)
+			{
+				const int nearChild = t1 < t0 ? 1 : 0;
+				stack[stackSize].ref = node.child[1 - nearChild];
+				stack[stackSize].tNear = nearChild ? t0 : t1;
+				stackSize++;
+				stack[stackSize].ref = node.child[nearChild];
+				stack[stackSize].tNear = nearChild ? t1 : t0;
+				stackSize++;
+			}
+			else if (hit0 || hit1)
+			{
+				stack[stackSize].ref = node.child[hit0 ? 0 : 1];
+				stack[stackSize].tNear = hit0 ? t0 : t1;
+				stackSize++;
+			}
+		}
+	}
+
+	Stats::add(Stats::CollisionTriangleTests, triangleTests);
+
+	if (best < 0)
+		return false;
+
+	triangle(best, v);
+	for (int i = 0; i < 3; i++)
+		v[i] = vec3(world * vec4(v[i], 1.0f));
+
+	hit.dist = maxDist;
+	hit.point = origin + dir * maxDist;
+	hit.normal = normalize(cross(v[1] - v[0], v[2] - v[0]));
+	if (dot(hit.normal, dir) > 0.0f)
+		hit.normal = -hit.normal;
+	return true;
+}
+
+bool CollisionBVH::intersectSphere(const mat4& world, const mat4& invWorld, const vec3& center, float radius, CollisionHit& hit) const
+{
+	return collide(world, invWorld, center, center, radius, hit);
+}
+
+bool CollisionBVH::intersectCapsule(const mat4& world, const mat4& invWorld, const vec3& p0, const vec3& p1, float radius, CollisionHit& hit) const
+{
+	return collide(world, invWorld, p0, p1, radius, hit);
+}
+
+bool CollisionBVH::collide(const mat4& world, const mat4& invWorld, const vec3& p0, const vec3& p1, float radius, CollisionHit& hit) const
+{
+	if (empty())
+		return false;
+
+	Stats::Timer timer(Stats::CollisionQueryTime);
+	Stats::add(Stats::CollisionQueryCount);
+
+	const vec3 bbMin = glm::min(p0, p1) - vec3(radius);
+	const vec3 bbMax = glm::max(p0, p1) + vec3(radius);
+
+	vec3 localMin, localMax;
+	int i;
+
+	for (i = 0; i < 8; i++)
+	{
+		const vec3 corner((i & 1) ? bbMax.x : bbMin.x, (i & 2) ? bbMax.y : bbMin.y, (i & 4) ? bbMax.z : bbMin.z);
+		const vec3 local = vec3(invWorld * vec4(corner, 1.0f));
+
+		localMin = i ? glm::min(localMin, local) : local;
+		localMax = i ? glm::max(localMax, local) : local;
+	}
+
+	if (localMin.x > m_bbMax.x || localMin.y > m_bbMax.y || localMin.z > m_bbMax.z
+		|| localMax.x < m_bbMin.x || localMax.y < m_bbMin.y || localMax.z < m_bbMin.z)
+		return false;
+
+	u16vec3 qMin, qMax;
+	quantize(localMin, localMax, qMin, qMax);
+
+	uint32_t stack[STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = m_root;
+
+	const bool sphere = p0 == p1;
+	const float radiusSq = radius * radius;
+	int triangleTests = 0;
+	bool found = false;
+	vec3 v[3], onSegment, onTriangle;
+
+	while (stackSize)
+	{
+		const uint32_t ref = stack[--stackSize];
+
+		if (ref & LEAF_FLAG)
+		{
+			const int first = (int)(ref & LEAF_FIRST_MASK);
+			const int last = first + (int)((ref & ~LEAF_FLAG) >> LEAF_COUNT_SHIFT);
+
+			for (int t = first; t < last; t++)
+			{
+				triangle(t, v);
+				for (i = 0; i < 3; i++)
+					v[i] = vec3(world * vec4(v[i], 1.0f));
+				triangleTests++;
+
+				float distSq;
+				if (sphere)
+				{
+					onSegment = p0;
+					onTriangle = closestPointOnTriangle(p0, v);
+					distSq = dot(p0 - onTriangle, p0 - onTriangle);
+				}
+				else
+					distSq = closestSegmentTriangle(p0, p1, v, onSegment, onTriangle);
+
+				if (distSq >= radiusSq)
+					continue;
+
+				const float dist = sqrt(distSq);
+				const float depth = radius - dist;
+				if (depth <= hit.dist)
+					continue;
+
+				vec3 normal;
+				if (dist > 1e-5f)
+					normal = (onSegment - onTriangle) / dist;
+				else
+				{
+					normal = normalize(cross(v[1] - v[0], v[2] - v[0]));
+					if (dot(normal, (p0 + p1) * 0.5f - v[0]) < 0.0f)
+						normal = -normal;
+				}
+
+				hit.dist = depth;
+				hit.point = onTriangle;
+				hit.normal = normal;
+				found = true;
+			}
+		}
+		else
+		{
+			const Node& node = m_nodes[ref];
+
+			if (boxOverlap(qMin, qMax, node.bbMin[0], node.bbMax[0]))
+				stack[stackSize++] = node.child[0];
+			if (boxOverlap(qMin, qMax, node.bbMin[1], node.bbMax[1]))
+				stack[stackSize++] = node.child[1];
+		}
+	}
+
+	Stats::add(Stats::CollisionTriangleTests, triangleTests);
+	return found;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+struct CollisionHit
+{
+	// ray: distance along dir, sphere/capsule: penetration depth
+	float dist;
+	vec3 point;
+	vec3 normal;
+};
+
+class CollisionBVH
+{
+public:
+	explicit CollisionBVH();
+	~CollisionBVH();
+
+	void build(const vec3* vertices, int vertexCount, const uint16_t* indices, int indexCount);
+
+	// queries are in world space, world being the transform of the collision mesh
+	// hit.dist must be initialised with the max ray distance (0 for sphere/capsule)
+	// and is only overwritten when a closer ray hit or a deeper penetration is found
+	bool intersectRay(const mat4& world, const mat4& invWorld, const vec3& origin, const vec3& dir, CollisionHit& hit) const;
+	bool intersectSphere(const mat4& world, const mat4& invWorld, const vec3& center, float radius, CollisionHit& hit) const;
+	bool intersectCapsule(const mat4& world, const mat4& invWorld, const vec3& p0, const vec3& p1, float radius, CollisionHit& hit) const;
+
+	bool empty() const {
+		return m_triangleCount == 0;
+	}
+	int nodeCount() const {
+		return (int)m_nodes.size();
+	}
+
+private:
+	// BVH2 node holding the quantised bounds of both children
+	struct Node
+	{
+		u16vec3 bbMin[2];
+		u16vec3 bbMax[2];
+		uint32_t child[2];
+	};
+
+	struct BuildRef
+	{
+		vec3 bbMin, bbMax;
+		vec3 center;
+		int triangle;
+	};
+
+	uint32_t buildNode(vector<BuildRef>& refs, int first, int count, int depth);
+	void quantize(const vec3& bbMin, const vec3& bbMax, u16vec3& qMin, u16vec3& qMax) const;
+	bool collide(const mat4& world, const mat4& invWorld, const vec3& p0, const vec3& p1, float radius, CollisionHit& hit) const;
+
+	void triangle(int i, vec3* out) const {
+		const uint16_t* const indices = &m_indices[i * 3];
+		out[0] = m_vertices[indices[0]];
+		out[1] = m_vertices[indices[1]];
+		out[2] = m_vertices[indices[2]];
+	}
+
+private:
+	const vec3* m_vertices;
+	vector<uint16_t> m_indices;
+	int m_triangleCount;
+	vector<Node> m_nodes;
+	uint32_t m_root;
+	vec3 m_bbMin, m_bbMax;
+	vec3 m_quantScale;
+
+private:
+	CollisionBVH(const CollisionBVH&) = delete;
+	CollisionBVH& operator=(const CollisionBVH&) = delete;
+};
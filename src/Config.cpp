@@ -9,4 +9,18 @@ namespace Config
 	int framerate = 0;
 	bool weatherEffects = true;
 	float musicVolume = 0.0;
+	int animationPhases = 1;
+	bool animationLod = true;
+	bool sharedSfx = true;
+	bool sfxAtlas = false;
+	int textureCacheSize = 32;
+	int resourceCacheSize = 256;
+	bool textureStreaming = true;
+	int textureBudget = 256;
+	int gpuBudget = 512;
+	float cacheGracePeriod = 10.0f;
+#if defined(FOREVER_DEBUG)
+	bool memoryOverlay = false;
+#endif
+	bool resourcePack = false;
 }
\ No newline at end of file
@@ -8,4 +8,18 @@ namespace Config
 	extern int framerate;
 	extern bool weatherEffects;
 	extern float musicVolume;
+	extern int animationPhases;
+	extern bool animationLod;
+	extern bool sharedSfx;
+	extern bool sfxAtlas;
+	extern int textureCacheSize;
+	extern int resourceCacheSize;
+	extern bool textureStreaming;
+	extern int textureBudget;
+	extern int gpuBudget;
+	extern float cacheGracePeriod;
+#if defined(FOREVER_DEBUG)
+	extern bool memoryOverlay;
+#endif
+	extern bool resourcePack;
 }
\ No newline at end of file
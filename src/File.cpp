@@ -1,14 +1,8 @@
 #include "StdAfx.hpp"
 #include "File.hpp"
 #include "FileNode.hpp"
-
-#define MINIZ_NO_ARCHIVE_APIS
-#define MINIZ_NO_ARCHIVE_WRITING_APIS
-#define MINIZ_NO_ZLIB_COMPATIBLE_NAMES
-
-#pragma warning(disable: 4334)
-
-#include "miniz.hpp"
+#include "Pack.hpp"
+#include "Codec.hpp"
 
 const FileNode FileNode::NullNode;
 
@@ -28,6 +22,42 @@ namespace File
 
 		vector<Package> s_packages;
 
+		// the magic, the codec size field and the encoded size followed by the encoded data
+		// null when truncated or the sizes are not ones the codec can produce, checked before anything is allocated
+		char* decodeFile(const void* data, int size, const char* magic, uint32_t& decodedSize)
+		{
+			const char* const cur = (const char*)data;
+			if (size < 12 || memcmp(cur, magic, 4) != 0)
+				return nullptr;
+
+			uint32_t sizeField, encodedSize;
+			memcpy(&sizeField, cur + 4, 4);
+			memcpy(&encodedSize, cur + 8, 4);
+
+			if (encodedSize > (uint32_t)size - 12)
+				return nullptr;
+
+			const int outSize = Codec::decodedSize(sizeField, (int)encodedSize);
+			if (outSize < 0)
+				return nullptr;
+
+			char* const out = new char[outSize];
+			if (!Codec::decode(Codec::idOf(sizeField), cur + 12, (int)encodedSize, out, outSize))
+			{
+				delete[] out;
+				return nullptr;
+			}
+
+			decodedSize = (uint32_t)outSize;
+			return out;
+		}
+
+		// count elements of elementSize bytes from index fit in size bytes
+		bool fits(uint32_t index, uint32_t count, std::size_t elementSize, uint32_t size)
+		{
+			return (uint64_t)index + (uint64_t)count * elementSize <= size;
+		}
+
 		void onPackageLoad(void* arg, void* compressedBuffer, int size)
 		{
 			const char* packageName = (const char*)arg;
@@ -45,25 +75,17 @@ namespace File
 			if (!pack)
 				return;
 
-			const char* curCompressed = (const char*)compressedBuffer;
+			uint32_t uncompressedDataSize;
+			char* uncompressedBuffer = decodeFile(compressedBuffer, size, "%CJS", uncompressedDataSize);
 
-			if (size < 12 || memcmp(curCompressed, "%CJS", 4) != 0)
+			if (!uncompressedBuffer || uncompressedDataSize < 4 * 8)
 			{
 				emscripten_log(EM_LOG_ERROR, "Invalid package file '%s'", packageName);
+				delete[] uncompressedBuffer;
 				emscripten_cancel_main_loop();
 				return;
 			}
 
-			curCompressed += 4;
-			uint32_t uncompressedDataSize, compressedDataSize;
-			memcpy(&uncompressedDataSize, curCompressed, 4); curCompressed += 4;
-			memcpy(&compressedDataSize, curCompressed, 4); curCompressed += 4;
-
-			char* uncompressedBuffer = new char[uncompressedDataSize];
-			mz_ulong uncompressedTemp;
-
-			mz_uncompress((unsigned char*)uncompressedBuffer, &uncompressedTemp, (const unsigned char*)curCompressed, (mz_ulong)compressedDataSize);
-
 			uint32_t valuesIndex;
 			uint32_t valuesCount;
 			uint32_t objectIndex;
@@ -95,6 +117,19 @@ namespace File
 				uint32_t value;
 			};
 
+			// the root node is read below, every block has to be whole
+			if (!valuesCount
+				|| !fits(valuesIndex, valuesCount, sizeof(FileNodeRaw), uncompressedDataSize)
+				|| !fits(objectIndex, objectCount, sizeof(ObjectPairRaw), uncompressedDataSize)
+				|| !fits(rawDataIndex, rawDataCount, sizeof(uint64_t), uncompressedDataSize)
+				|| !fits(stringDataIndex, stringDataCount, 1, uncompressedDataSize))
+			{
+				emscripten_log(EM_LOG_ERROR, "Truncated package file '%s'", packageName);
+				delete[] uncompressedBuffer;
+				emscripten_cancel_main_loop();
+				return;
+			}
+
 			FileNodeRaw* values = new FileNodeRaw[valuesCount];
 			ObjectPairRaw* objectPairs = new ObjectPairRaw[objectCount];
 			uint64_t* rawDataBlocks = new uint64_t[rawDataCount];
@@ -196,37 +231,48 @@ namespace File
 			s_packages.push_back(pak);
 
 			char buffer[512];
+			sprintf(buffer, "%s.bin", name);
+
+			Pack::Entry entry;
+			if (Pack::find(buffer, entry))
+			{
+				onPackageLoad((void*)name, const_cast<void*>(entry.data), entry.size);
+				return;
+			}
+
 			sprintf(buffer, "./%s.bin", name);
 			emscripten_async_wget_data(buffer, (void*)name, onPackageLoad, onPackageLoadError);
 		}
 
 		void onFilemapLoad(void* arg, void* compressedBuffer, int size)
 		{
-			const char* curCompressed = (const char*)compressedBuffer;
+			uint32_t uncompressedDataSize;
+			char* uncompressedBuffer = decodeFile(compressedBuffer, size, "%MAP", uncompressedDataSize);
 
-			if (size < 12 || memcmp(curCompressed, "%MAP", 4) != 0)
+			if (!uncompressedBuffer || uncompressedDataSize < 8)
 			{
 				emscripten_log(EM_LOG_ERROR, "Invalid filemap data");
+				delete[] uncompressedBuffer;
 				emscripten_cancel_main_loop();
 				return;
 			}
 
-			curCompressed += 4;
-			uint32_t uncompressedDataSize, compressedDataSize;
-			memcpy(&uncompressedDataSize, curCompressed, 4); curCompressed += 4;
-			memcpy(&compressedDataSize, curCompressed, 4); curCompressed += 4;
-
-			char* uncompressedBuffer = new char[uncompressedDataSize];
-			mz_ulong uncompressedTemp;
-
-			mz_uncompress((unsigned char*)uncompressedBuffer, &uncompressedTemp, (const unsigned char*)curCompressed, (mz_ulong)compressedDataSize);
-
 			char* curUncompressed = uncompressedBuffer;
 
 			uint32_t stringDataSize, fileCount;
 			memcpy(&stringDataSize, curUncompressed, 4); curUncompressed += 4;
 			memcpy(&fileCount, curUncompressed, 4); curUncompressed += 4;
 
+			// the strings, then a key and value offset per file
+			if (!fits(8, stringDataSize, 1, uncompressedDataSize)
+				|| !fits(8 + stringDataSize, fileCount, 8, uncompressedDataSize))
+			{
+				emscripten_log(EM_LOG_ERROR, "Truncated filemap data");
+				delete[] uncompressedBuffer;
+				emscripten_cancel_main_loop();
+				return;
+			}
+
 			s_mapStringBuffer.resize(stringDataSize);
 			memcpy(s_mapStringBuffer.data(), curUncompressed, stringDataSize); curUncompressed += stringDataSize;
 
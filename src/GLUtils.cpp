@@ -1,5 +1,6 @@
 #include "StdAfx.hpp"
 #include "ShaderVars.hpp"
+#include "Stats.hpp"
 
 #include <emscripten/html5.h>
 #include <vector>
@@ -11,6 +12,7 @@ namespace gl
 		bool contextActive = false;
 		EMSCRIPTEN_WEBGL_CONTEXT_HANDLE context = 0;
 		GLuint currentProgram;
+		Program* currentProgramObject = nullptr;
 		bool blendEnabled;
 		bool depthWriteEnabled;
 		bool depthTestEnabled;
@@ -22,11 +24,15 @@ namespace gl
 		int activeTextureUnit;
 		GLuint currentVertexArray;
 		bool supportsVertexArray = false;
+		bool supportsParallelCompile = false;
+		// programs linked while it is set account their stall to the restore
+		bool restoringContext = false;
 		GLuint currentVertexBuffer;
 		GLuint currentIndexBuffer;
 		GLuint nextVertexArrayId;
 		bool vertexAttribEnabled[MAX_VERTEX_ATTRIBUTES];
 		float currentLineWidth;
+		std::size_t allocatedMemory[MAX_MEMORY_CATEGORY];
 
 		class ObjectManager
 		{
@@ -84,8 +90,16 @@ namespace gl
 				m_source.c_str()
 			};
 
+			// no status query here, it would wait for the compile and serialize every shader
 			glShaderSource(m_id, sizeof(sources) / sizeof(const GLchar*), sources, NULL);
 			glCompileShader(m_id);
+			Stats::add(Stats::ShaderCompiles);
+		}
+
+		void Shader::logErrors() const
+		{
+			if (!m_id)
+				return;
 
 			GLint compiled;
 			glGetShaderiv(m_id, GL_COMPILE_STATUS, &compiled);
@@ -104,9 +118,6 @@ namespace gl
 
 					delete[] infoLog;
 				}
-
-				glDeleteShader(m_id);
-				m_id = 0;
 			}
 		}
 
@@ -172,8 +183,10 @@ namespace gl
 
 		emscripten_webgl_enable_extension(priv::context, "WEBGL_compressed_texture_s3tc");
 		priv::supportsVertexArray = emscripten_webgl_enable_extension(priv::context, "OES_vertex_array_object") != 0;
+		priv::supportsParallelCompile = emscripten_webgl_enable_extension(priv::context, "KHR_parallel_shader_compile") != 0;
 
 		priv::currentProgram = 0;
+		priv::currentProgramObject = nullptr;
 		glUseProgram(0);
 
 		glDepthFunc(GL_LEQUAL);
@@ -241,7 +254,13 @@ namespace gl
 
 		ShaderVars::initAll();
 
-		priv::ObjectManager::restoreAll();
+		{
+			Stats::Timer timer(Stats::ContextRestoreTime);
+
+			priv::restoringContext = true;
+			priv::ObjectManager::restoreAll();
+			priv::restoringContext = false;
+		}
 
 		return true;
 	}
@@ -257,6 +276,7 @@ namespace gl
 		ShaderVars::releaseAll();
 
 		priv::currentProgram = 0;
+		priv::currentProgramObject = nullptr;
 		priv::cullEnabled = false;
 		priv::blendEnabled = false;
 		priv::depthTestEnabled = false;
@@ -304,11 +324,15 @@ namespace gl
 			{
 				glUseProgram(0);
 				priv::currentProgram = 0;
+				priv::currentProgramObject = nullptr;
 			}
 
 			glDeleteProgram(m_id);
 			m_id = 0;
 		}
+
+		m_uniforms.clear();
+		m_linking = false;
 	}
 
 	void Program::onContextRestored()
@@ -326,6 +350,8 @@ namespace gl
 			"aBoneId"
 		};
 
+		m_uniforms.clear();
+		m_linking = false;
 		m_id = glCreateProgram();
 
 		if (!m_id)
@@ -342,15 +368,74 @@ namespace gl
 				glBindAttribLocation(m_id, i, attribNames[i]);
 
 		glLinkProgram(m_id);
+		Stats::add(Stats::ProgramLinks);
 
-		glDetachShader(m_id, m_vertex->id());
-		glDetachShader(m_id, m_fragment->id());
+		// the status and the locations are resolved by finishLink, the driver keeps linking until then
+		m_linking = true;
+		m_restoreLink = priv::restoringContext;
+
+		for (std::size_t i = 0; i < m_bindings.size(); i++)
+			if (m_bindings[i].location)
+				*m_bindings[i].location = -1;
+	}
+
+	void Program::bindLocation(int& l, const char* uniform)
+	{
+		UniformBinding binding;
+		binding.location = &l;
+		binding.name = uniform;
+		binding.unit = 0;
+		m_bindings.push_back(binding);
+
+		l = (m_id && !m_linking) ? glGetUniformLocation(m_id, uniform) : -1;
+	}
+
+	void Program::bindSampler(const char* name, int unit)
+	{
+		UniformBinding binding;
+		binding.location = nullptr;
+		binding.name = name;
+		binding.unit = unit;
+		m_bindings.push_back(binding);
+
+		if (m_id && !m_linking)
+		{
+			use();
+			gl::uniform(glGetUniformLocation(m_id, name), unit);
+		}
+	}
+
+	bool Program::ready() const
+	{
+		if (!m_linking || !priv::supportsParallelCompile)
+			return true;
+
+		GLint completed = GL_FALSE;
+		glGetProgramiv(m_id, GL_COMPLETION_STATUS_KHR, &completed);
+		return completed != GL_FALSE;
+	}
+
+	bool Program::finishLink()
+	{
+		if (!m_linking)
+			return m_id != 0;
+
+		m_linking = false;
 
 		GLint linked;
-		glGetProgramiv(m_id, GL_LINK_STATUS, &linked);
+		{
+			Stats::Timer timer(m_restoreLink ? Stats::ShaderRestoreStallTime : Stats::ShaderStartupStallTime);
+			glGetProgramiv(m_id, GL_LINK_STATUS, &linked);
+		}
+
+		glDetachShader(m_id, m_vertex->id());
+		glDetachShader(m_id, m_fragment->id());
 
 		if (!linked)
 		{
+			m_vertex->logErrors();
+			m_fragment->logErrors();
+
 			GLint infoLen = 0;
 			glGetProgramiv(m_id, GL_INFO_LOG_LENGTH, &infoLen);
 
@@ -366,8 +451,81 @@ namespace gl
 
 			glDeleteProgram(m_id);
 			m_id = 0;
+			return false;
 		}
+
+		for (std::size_t i = 0; i < m_bindings.size(); i++)
+		{
+			const UniformBinding& binding = m_bindings[i];
+
+			if (binding.location)
+				*binding.location = glGetUniformLocation(m_id, binding.name);
+			else
+			{
+				use();
+				gl::uniform(glGetUniformLocation(m_id, binding.name), binding.unit);
+			}
+		}
+
+		return true;
+	}
+
+	bool Program::shadowUniform(int l, const void* value, std::size_t size)
+	{
+		// not an active uniform, glUniform would ignore it
+		if (l < 0)
+			return false;
+
+		if (l >= MAX_SHADOWED_UNIFORMS)
+			return true;
+
+		// grows to the highest location used once after each link
+		if ((std::size_t)l >= m_uniforms.size())
+		{
+			UniformShadow empty;
+			empty.size = 0;
+			m_uniforms.resize(l + 1, empty);
+		}
+
+		UniformShadow& shadow = m_uniforms[l];
+
+		if (shadow.size == size && !memcmp(shadow.value, value, size))
+		{
+#if defined(FOREVER_STATS)
+			Stats::add(Stats::UniformSkips);
+#endif
+			return false;
+		}
+
+		shadow.size = (uint8_t)size;
+		memcpy(shadow.value, value, size);
+#if defined(FOREVER_STATS)
+		Stats::add(Stats::UniformUploads);
+#endif
+		return true;
+	}
+
+	std::size_t allocatedMemory()
+	{
+		std::size_t total = 0;
+		for (int i = 0; i < MAX_MEMORY_CATEGORY; i++)
+			total += priv::allocatedMemory[i];
+		return total;
+	}
+
+#if defined(FOREVER_DEBUG)
+	string memoryDump()
+	{
+		char buffer[256];
+		sprintf(buffer, "{\"texture\":%u,\"vertex\":%u,\"index\":%u,\"dynamic\":%u,\"total\":%u}",
+			(unsigned)priv::allocatedMemory[MemoryTexture],
+			(unsigned)priv::allocatedMemory[MemoryVertex],
+			(unsigned)priv::allocatedMemory[MemoryIndex],
+			(unsigned)priv::allocatedMemory[MemoryDynamic],
+			(unsigned)allocatedMemory());
+		return buffer;
 	}
+#endif
 
 	void Texture2D::create()
 	{
@@ -379,6 +537,49 @@ namespace gl
 		}
 	}
 
+	void StreamBuffer::create(GLsizeiptr size, GLsizeiptr segmentSize)
+	{
+		Buffer::create();
+		bind();
+		glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+		setAllocated(size, MemoryDynamic);
+
+		m_size = size;
+		m_segmentSize = segmentSize;
+		m_offset = 0;
+	}
+
+	GLintptr StreamBuffer::write(const GLvoid* data, GLsizeiptr size, GLsizeiptr align)
+	{
+		bind();
+
+		GLintptr offset = (m_offset + align - 1) / align * align;
+
+		if (m_segmentSize && offset / m_segmentSize != (offset + size - 1) / m_segmentSize)
+			offset = (offset / m_segmentSize + 1) * m_segmentSize;
+
+		if (offset + size > m_size)
+		{
+			if (size > m_size)
+			{
+				emscripten_log(EM_LOG_WARN, "Stream buffer grown from %d to %d bytes", (int)m_size, (int)size);
+				m_size = size;
+			}
+
+			// the draws still reading the old storage keep it, no wait for the GPU
+			glBufferData(GL_ARRAY_BUFFER, m_size, nullptr, GL_STREAM_DRAW);
+			setAllocated(m_size, MemoryDynamic);
+			Stats::add(Stats::StreamOrphans);
+			offset = 0;
+		}
+
+		glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+		m_offset = offset + size;
+
+		Stats::add(Stats::StreamedBytes, (double)size);
+		return offset;
+	}
+
 	void VertexArray::create()
 	{
 		if (!m_id)
@@ -396,4 +597,12 @@ namespace gl
 			}
 		}
 	}
-}
\ No newline at end of file
+}
+#if defined(FOREVER_DEBUG)
+extern "C" EMSCRIPTEN_KEEPALIVE const char* getGpuMemory()
+{
+	static string s_dump;
+	s_dump = gl::memoryDump();
+	return s_dump.c_str();
+}
+#endif
\ No newline at end of file
@@ -13,11 +13,28 @@ namespace gl
 {
 	static const int MAX_ACTIVE_TEXTURES = 2;
 	static const GLuint MAX_VERTEX_ATTRIBUTES = 7;
+	static const int MAX_TEXTURE_LEVELS = 16;
+	// uniforms shadowed per program, larger values and higher locations are always uploaded
+	static const std::size_t MAX_SHADOWED_UNIFORM_SIZE = 64;
+	static const int MAX_SHADOWED_UNIFORMS = 256;
+
+	// GPU memory accounted by the buffer and texture wrappers
+	enum MemoryCategory
+	{
+		MemoryTexture,
+		MemoryVertex,
+		MemoryIndex,
+		MemoryDynamic,
+		MAX_MEMORY_CATEGORY
+	};
+
+	class Program;
 
 	namespace priv
 	{
 		extern bool contextActive;
 		extern GLuint currentProgram;
+		extern Program* currentProgramObject;
 		extern bool blendEnabled;
 		extern bool depthWriteEnabled;
 		extern bool depthTestEnabled;
@@ -29,11 +46,18 @@ namespace gl
 		extern int activeTextureUnit;
 		extern GLuint currentVertexArray;
 		extern bool supportsVertexArray;
+		extern bool supportsParallelCompile;
 		extern GLuint currentVertexBuffer;
 		extern GLuint currentIndexBuffer;
 		extern GLuint nextVertexArrayId;
 		extern bool vertexAttribEnabled[MAX_VERTEX_ATTRIBUTES];
 		extern float currentLineWidth;
+		extern std::size_t allocatedMemory[MAX_MEMORY_CATEGORY];
+
+		inline void trackMemory(MemoryCategory category, std::size_t oldSize, std::size_t newSize)
+		{
+			allocatedMemory[category] = allocatedMemory[category] - oldSize + newSize;
+		}
 
 		class ObjectManager;
 		class Buffer;
@@ -44,6 +68,7 @@ namespace gl
 	class VertexShader;
 	class FragmentShader;
 	class VertexBuffer;
+	class StreamBuffer;
 	class IndexBuffer;
 	class VertexArray;
 	class Texture2D;
@@ -58,6 +83,16 @@ namespace gl
 		return priv::contextActive;
 	}
 
+	inline std::size_t allocatedMemory(MemoryCategory category)
+	{
+		return priv::allocatedMemory[category];
+	}
+	std::size_t allocatedMemory();
+#if defined(FOREVER_DEBUG)
+	// bytes per category and in total as a JSON object
+	string memoryDump();
+#endif
+
 	class DeviceObject
 	{
 	protected:
@@ -144,6 +179,9 @@ namespace gl
 				return m_id;
 			}
 
+			// the compile status is only queried once a program using the shader failed to link
+			void logErrors() const;
+
 		protected:
 			virtual void onContextLost();
 			virtual void onContextRestored();
@@ -159,7 +197,9 @@ namespace gl
 		public:
 			Buffer(GLenum type)
 				:m_id(0),
-				m_type(type)
+				m_type(type),
+				m_allocated(0),
+				m_category(type == GL_ARRAY_BUFFER ? MemoryVertex : MemoryIndex)
 			{
 			}
 			virtual ~Buffer();
@@ -180,6 +220,8 @@ namespace gl
 					glDeleteBuffers(1, &m_id);
 					m_id = 0;
 				}
+
+				setAllocated(0, m_category);
 			}
 
 			void create();
@@ -187,11 +229,24 @@ namespace gl
 			void data(GLsizeiptr size, const GLvoid* data, bool stream = false)
 			{
 				glBufferData(m_type, size, data, stream ? GL_STREAM_DRAW : GL_STATIC_DRAW);
+				setAllocated(size, stream ? MemoryDynamic : (m_type == GL_ARRAY_BUFFER ? MemoryVertex : MemoryIndex));
+			}
+
+		protected:
+			// size of the storage last given to glBufferData
+			void setAllocated(GLsizeiptr size, MemoryCategory category)
+			{
+				trackMemory(m_category, m_allocated, 0);
+				trackMemory(category, 0, (std::size_t)size);
+				m_allocated = (std::size_t)size;
+				m_category = category;
 			}
 
 		protected:
 			GLuint m_id;
 			GLenum m_type;
+			std::size_t m_allocated;
+			MemoryCategory m_category;
 
 		private:
 			Buffer(const Buffer&) = delete;
@@ -223,7 +278,9 @@ namespace gl
 		Program()
 			: m_id(0),
 			m_fragment(nullptr),
-			m_vertex(nullptr)
+			m_vertex(nullptr),
+			m_linking(false),
+			m_restoreLink(false)
 		{
 			for (GLuint i = 0; i < MAX_VERTEX_ATTRIBUTES; i++)
 				m_attribute[i] = false;
@@ -244,6 +301,11 @@ namespace gl
 
 		void use()
 		{
+			if (m_linking)
+				finishLink();
+
+			priv::currentProgramObject = this;
+
 			if (priv::currentProgram != m_id)
 			{
 				glUseProgram(m_id);
@@ -251,28 +313,81 @@ namespace gl
 			}
 		}
 
-		int location(const char* uniform) const
+		int location(const char* uniform)
 		{
+			if (m_linking)
+				finishLink();
+
 			return glGetUniformLocation(m_id, uniform);
 		}
 
+		// l is -1 until the link completed, it is looked up again after every context restore
+		void bindLocation(int& l, const char* uniform);
+		// sampler units are set each time the program is linked
+		void bindSampler(const char* uniform, int unit);
+
+		// false while the driver still links in the background, only KHR_parallel_shader_compile can tell
+		bool ready() const;
+		// waits for the pending link and resolves the bound locations, false when the link failed
+		bool finishLink();
+
+		bool linking() const
+		{
+			return m_linking;
+		}
+
+		// false when the program already holds this value at l, it is remembered otherwise
+		bool shadowUniform(int l, const void* value, std::size_t size);
+
 	protected:
 		virtual void onContextLost();
 		virtual void onContextRestored();
 
+	private:
+		// size 0 until a value is uploaded at the location
+		struct UniformShadow
+		{
+			uint8_t size;
+			uint8_t value[MAX_SHADOWED_UNIFORM_SIZE];
+		};
+
+		struct UniformBinding
+		{
+			int* location;
+			const char* name;
+			int unit;
+		};
+
 	private:
 		GLuint m_id;
 		const FragmentShader* m_fragment;
 		const VertexShader* m_vertex;
 		bool m_attribute[MAX_VERTEX_ATTRIBUTES];
+		bool m_linking;
+		bool m_restoreLink;
+		// indexed by location
+		vector<UniformShadow> m_uniforms;
+		vector<UniformBinding> m_bindings;
 	};
 
+	namespace priv
+	{
+		// uniform values are uploaded to the current program only when they changed
+		// comparing a large array like the skin palette would cost more than the upload
+		inline bool uniformChanged(int l, const void* value, std::size_t size)
+		{
+			return size > MAX_SHADOWED_UNIFORM_SIZE || !currentProgramObject || currentProgramObject->shadowUniform(l, value, size);
+		}
+	}
+
 	class Texture2D
 	{
 	public:
 		Texture2D()
 			: m_id(0)
 		{
+			for (int level = 0; level < MAX_TEXTURE_LEVELS; level++)
+				m_levelBytes[level] = 0;
 		}
 		~Texture2D()
 		{
@@ -301,6 +416,9 @@ namespace gl
 				glDeleteTextures(1, &m_id);
 				m_id = 0;
 			}
+
+			for (int level = 0; level < MAX_TEXTURE_LEVELS; level++)
+				trackLevel(level, 0);
 		}
 
 		void create();
@@ -329,6 +447,17 @@ namespace gl
 			}
 
 			glTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0, format, priv::typeOf<T>(), pixels);
+
+			int channels = 4;
+			if (format == GL_RGB)
+				channels = 3;
+			else if (format == GL_LUMINANCE_ALPHA)
+				channels = 2;
+			else if (format == GL_ALPHA || format == GL_LUMINANCE)
+				channels = 1;
+
+			// every caller uploads byte components
+			trackLevel(level, (std::size_t)width * height * channels);
 		}
 
 		void compressedImage(GLint level, GLint format, GLsizei width, GLsizei height, GLsizei imageSize, const GLvoid* data)
@@ -340,6 +469,7 @@ namespace gl
 			}
 
 			glCompressedTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0, imageSize, data);
+			trackLevel(level, (std::size_t)imageSize);
 		}
 
 		void parameter(GLenum pname, GLenum param)
@@ -364,8 +494,19 @@ namespace gl
 			glTexParameterf(GL_TEXTURE_2D, pname, param);
 		}
 
+	private:
+		void trackLevel(GLint level, std::size_t bytes)
+		{
+			if (level >= 0 && level < MAX_TEXTURE_LEVELS)
+			{
+				priv::trackMemory(MemoryTexture, m_levelBytes[level], bytes);
+				m_levelBytes[level] = bytes;
+			}
+		}
+
 	private:
 		GLuint m_id;
+		std::size_t m_levelBytes[MAX_TEXTURE_LEVELS];
 
 	private:
 		Texture2D(const Texture2D&) = delete;
@@ -531,6 +672,44 @@ namespace gl
 		}
 	};
 
+	// ring of dynamic vertices written with glBufferSubData at advancing offsets
+	// the storage is only orphaned when the ring wraps, which happens every few frames
+	class StreamBuffer : public VertexBuffer
+	{
+	public:
+		StreamBuffer()
+			: m_size(0),
+			m_segmentSize(0),
+			m_offset(0)
+		{
+		}
+
+		// size of the whole ring in bytes, a write never straddles two segments of segmentSize bytes when given
+		void create(GLsizeiptr size, GLsizeiptr segmentSize = 0);
+
+		// copies data after the previous write and returns its offset, a multiple of align
+		// the buffer is left bound
+		GLintptr write(const GLvoid* data, GLsizeiptr size, GLsizeiptr align);
+
+		// first vertex of data written at offset for drawArrays
+		static GLint first(GLintptr offset, GLsizei stride) {
+			return (GLint)(offset / stride);
+		}
+
+		// segment of data written at offset, and its offset from the start of the segment
+		int segment(GLintptr offset) const {
+			return m_segmentSize ? (int)(offset / m_segmentSize) : 0;
+		}
+		GLintptr segmentOffset(GLintptr offset) const {
+			return m_segmentSize ? offset % m_segmentSize : offset;
+		}
+
+	private:
+		GLsizeiptr m_size;
+		GLsizeiptr m_segmentSize;
+		GLintptr m_offset;
+	};
+
 	class IndexBuffer : public priv::Buffer
 	{
 	public:
@@ -658,27 +837,27 @@ namespace gl
 		glDrawArrays(mode, first, count);
 	}
 
-	inline void uniform(int l, const float& v) { glUniform1f(l, v); }
-	inline void uniform(int l, const int& v) { glUniform1i(l, v); }
-	inline void uniform(int l, const vec2& v) { glUniform2fv(l, 1, (const GLfloat*)&v); }
-	inline void uniform(int l, const ivec2& v) { glUniform2iv(l, 1, (const GLint*)&v); }
-	inline void uniform(int l, const vec3& v) { glUniform3fv(l, 1, (const GLfloat*)&v); }
-	inline void uniform(int l, const ivec3& v) { glUniform3iv(l, 1, (const GLint*)&v); }
-	inline void uniform(int l, const vec4& v) { glUniform4fv(l, 1, (const GLfloat*)&v); }
-	inline void uniform(int l, const ivec4& v) { glUniform4iv(l, 1, (const GLint*)&v); }
-	inline void uniform(int l, const mat2& v) { glUniformMatrix2fv(l, 1, GL_FALSE, (const GLfloat*)&v); }
-	inline void uniform(int l, const mat3& v) { glUniformMatrix3fv(l, 1, GL_FALSE, (const GLfloat*)&v); }
-	inline void uniform(int l, const mat4& v) { glUniformMatrix4fv(l, 1, GL_FALSE, (const GLfloat*)&v); }
-
-	inline void uniform(int l, GLsizei c, const float* v) { glUniform1fv(l, c, v); }
-	inline void uniform(int l, GLsizei c, const int* v) { glUniform1iv(l, c, v); }
-	inline void uniform(int l, GLsizei c, const vec2* v) { glUniform2fv(l, c, (const GLfloat*)v); }
-	inline void uniform(int l, GLsizei c, const ivec2* v) { glUniform2iv(l, c, (const GLint*)v); }
-	inline void uniform(int l, GLsizei c, const vec3* v) { glUniform3fv(l, c, (const GLfloat*)v); }
-	inline void uniform(int l, GLsizei c, const ivec3* v) { glUniform3iv(l, c, (const GLint*)v); }
-	inline void uniform(int l, GLsizei c, const vec4* v) { glUniform4fv(l, c, (const GLfloat*)v); }
-	inline void uniform(int l, GLsizei c, const ivec4* v) { glUniform4iv(l, c, (const GLint*)v); }
-	inline void uniform(int l, GLsizei c, const mat2* v) { glUniformMatrix2fv(l, c, GL_FALSE, (const GLfloat*)v); }
-	inline void uniform(int l, GLsizei c, const mat3* v) { glUniformMatrix3fv(l, c, GL_FALSE, (const GLfloat*)v); }
-	inline void uniform(int l, GLsizei c, const mat4* v) { glUniformMatrix4fv(l, c, GL_FALSE, (const GLfloat*)v); }
+	inline void uniform(int l, const float& v) { if (priv::uniformChanged(l, &v, sizeof(v))) glUniform1f(l, v); }
+	inline void uniform(int l, const int& v) { if (priv::uniformChanged(l, &v, sizeof(v))) glUniform1i(l, v); }
+	inline void uniform(int l, const vec2& v) { if (priv::uniformChanged(l, &v, sizeof(v))) glUniform2fv(l, 1, (const GLfloat*)&v); }
+	inline void uniform(int l, const ivec2& v) { if (priv::uniformChanged(l, &v, sizeof(v))) glUniform2iv(l, 1, (const GLint*)&v); }
+	inline void uniform(int l, const vec3& v) { if (priv::uniformChanged(l, &v, sizeof(v))) glUniform3fv(l, 1, (const GLfloat*)&v); }
+	inline void uniform(int l, const ivec3& v) { if (priv::uniformChanged(l, &v, sizeof(v))) glUniform3iv(l, 1, (const GLint*)&v); }
+	inline void uniform(int l, const vec4& v) { if (priv::uniformChanged(l, &v, sizeof(v))) glUniform4fv(l, 1, (const GLfloat*)&v); }
+	inline void uniform(int l, const ivec4& v) { if (priv::uniformChanged(l, &v, sizeof(v))) glUniform4iv(l, 1, (const GLint*)&v); }
+	inline void uniform(int l, const mat2& v) { if (priv::uniformChanged(l, &v, sizeof(v))) glUniformMatrix2fv(l, 1, GL_FALSE, (const GLfloat*)&v); }
+	inline void uniform(int l, const mat3& v) { if (priv::uniformChanged(l, &v, sizeof(v))) glUniformMatrix3fv(l, 1, GL_FALSE, (const GLfloat*)&v); }
+	inline void uniform(int l, const mat4& v) { if (priv::uniformChanged(l, &v, sizeof(v))) glUniformMatrix4fv(l, 1, GL_FALSE, (const GLfloat*)&v); }
+
+	inline void uniform(int l, GLsizei c, const float* v) { if (priv::uniformChanged(l, v, c * sizeof(*v))) glUniform1fv(l, c, v); }
+	inline void uniform(int l, GLsizei c, const int* v) { if (priv::uniformChanged(l, v, c * sizeof(*v))) glUniform1iv(l, c, v); }
+	inline void uniform(int l, GLsizei c, const vec2* v) { if (priv::uniformChanged(l, v, c * sizeof(*v))) glUniform2fv(l, c, (const GLfloat*)v); }
+	inline void uniform(int l, GLsizei c, const ivec2* v) { if (priv::uniformChanged(l, v, c * sizeof(*v))) glUniform2iv(l, c, (const GLint*)v); }
+	inline void uniform(int l, GLsizei c, const vec3* v) { if (priv::uniformChanged(l, v, c * sizeof(*v))) glUniform3fv(l, c, (const GLfloat*)v); }
+	inline void uniform(int l, GLsizei c, const ivec3* v) { if (priv::uniformChanged(l, v, c * sizeof(*v))) glUniform3iv(l, c, (const GLint*)v); }
+	inline void uniform(int l, GLsizei c, const vec4* v) { if (priv::uniformChanged(l, v, c * sizeof(*v))) glUniform4fv(l, c, (const GLfloat*)v); }
+	inline void uniform(int l, GLsizei c, const ivec4* v) { if (priv::uniformChanged(l, v, c * sizeof(*v))) glUniform4iv(l, c, (const GLint*)v); }
+	inline void uniform(int l, GLsizei c, const mat2* v) { if (priv::uniformChanged(l, v, c * sizeof(*v))) glUniformMatrix2fv(l, c, GL_FALSE, (const GLfloat*)v); }
+	inline void uniform(int l, GLsizei c, const mat3* v) { if (priv::uniformChanged(l, v, c * sizeof(*v))) glUniformMatrix3fv(l, c, GL_FALSE, (const GLfloat*)v); }
+	inline void uniform(int l, GLsizei c, const mat4* v) { if (priv::uniformChanged(l, v, c * sizeof(*v))) glUniformMatrix4fv(l, c, GL_FALSE, (const GLfloat*)v); }
 }
\ No newline at end of file
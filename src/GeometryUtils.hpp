@@ -10,4 +10,33 @@ inline vec4 planeFromPoints(const vec3& v1, const vec3& v2, const vec3& v3)
 {
 	const vec3 normal = normalize(cross(v2 - v1, v3 - v1));
 	return vec4(normal, -dot(v1, normal));
-}
\ No newline at end of file
+}
+
+inline bool intersectRayBox(const vec3& origin, const vec3& dir, const vec3& bbMin, const vec3& bbMax, float maxDist)
+{
+	float tMin = 0.0f, tMax = maxDist;
+
+	for (int i = 0; i < 3; i++)
+	{
+		if (glm::abs(dir[i]) < 1e-8f)
+		{
+			if (origin[i] < bbMin[i] || origin[i] > bbMax[i])
+				return false;
+		}
+		else
+		{
+			const float invDir = 1.0f / dir[i];
+			float t0 = (bbMin[i] - origin[i]) * invDir;
+			float t1 = (bbMax[i] - origin[i]) * invDir;
+			if (t0 > t1)
+				std::swap(t0, t1);
+
+			tMin = glm::max(tMin, t0);
+			tMax = glm::min(tMax, t1);
+			if (tMin > tMax)
+				return false;
+		}
+	}
+
+	return true;
+}
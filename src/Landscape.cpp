@@ -3,6 +3,9 @@
 #include "World.hpp"
 #include "Shaders.hpp"
 #include "TextureManager.hpp"
+#include "Mesh.hpp"
+#include "Config.hpp"
+#include "Stats.hpp"
 
 namespace
 {
@@ -37,9 +40,16 @@ Landscape::~Landscape()
 	{
 		vector<Object*>& objs = m_objects[i];
 		for (std::size_t j = 0; j < objs.size(); j++)
-			delete objs[j];
+		{
+			// objects added to the world later come from the heap
+			if (objs[j]->hasObjFlag(Object::Pooled))
+				objs[j]->~Object();
+			else
+				delete objs[j];
+		}
 		objs.clear();
 	}
+	m_objectPool.clear();
 
 	if (m_layers)
 		delete[] m_layers;
@@ -161,6 +171,9 @@ void Landscape::onContextRestored()
 
 void Landscape::onLoad(BinaryReader reader)
 {
+	Stats::Timer timer(Stats::LandscapeLoadTime);
+	Stats::add(Stats::LandscapeLoads);
+
 	const uint8_t ver = reader.read<uint8_t>();
 
 	ivec2 p;
@@ -211,6 +224,8 @@ void Landscape::onLoad(BinaryReader reader)
 
 	const vec3 landObjOffset = ivec3(m_pos.x, 0, m_pos.y) * ShaderVars::MPU * MAP_SIZE;
 
+	const double objectStart = Stats::now();
+
 	for (int i = 0; i < sizeof(objTypes) / sizeof(ObjectType); i++)
 	{
 		reader >> objCount;
@@ -225,21 +240,30 @@ void Landscape::onLoad(BinaryReader reader)
 			pos *= vec3(ShaderVars::MPU, 1, ShaderVars::MPU);
 			pos += landObjOffset;
 
-			obj = new Object(objTypes[i]);
+			obj = m_objectPool.create(objTypes[i]);
+			obj->setFlag(Object::Pooled, true);
 			obj->setPos(pos);
 			obj->setRot(rot);
 			obj->setScale(scale);
 			obj->setWorld(m_world);
 
 			if (obj->setModelId(modelId) && insertObjLink(obj))
+			{
+				if (Config::animationPhases > 1 && obj->model()->modelType() == MODELTYPE_ANIMATED_MESH)
+					((Mesh*)obj->model())->setPhaseQuantization(Config::animationPhases);
+
 				addObjArray(obj);
+				Stats::add(Stats::LandscapeObjects);
+			}
 			else
-				delete obj;
+				m_objectPool.destroy(obj);
 		}
 
 		m_objects[objTypes[i]].shrink_to_fit();
 	}
 
+	Stats::add(Stats::LandscapeObjectTime, Stats::now() - objectStart);
+
 	for (p.y = 0; p.y < NUM_PATCHES_PER_SIDE; p.y++)
 		for (p.x = 0; p.x < NUM_PATCHES_PER_SIDE; p.x++)
 			m_patches[p.y * NUM_PATCHES_PER_SIDE + p.x].init(m_heightMap, m_waterHeight[p.y * NUM_PATCHES_PER_SIDE + p.x], m_pos, p);
@@ -2,6 +2,7 @@
 
 #include "Texture.hpp"
 #include "Object.hpp"
+#include "Pool.hpp"
 
 #define NUM_PATCHES_PER_SIDE	8
 #define PATCH_SIZE 8
@@ -103,6 +104,8 @@ private:
 	uint32_t m_cloudVertexOffset;
 	WaterHeight m_waterHeight[NUM_PATCHES_PER_SIDE * NUM_PATCHES_PER_SIDE];
 	vector<Object*> m_objects[MAX_OBJTYPE];
+	// the placed objects, released at once with the landscape
+	Pool<Object> m_objectPool;
 };
 
 typedef RefCountedPtr<Landscape> LandscapePtr;
\ No newline at end of file
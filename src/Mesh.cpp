@@ -3,13 +3,40 @@
 #include "ModelManager.hpp"
 #include "Shaders.hpp"
 #include "Object3D.hpp"
+#include "CollisionBVH.hpp"
+#include "Stats.hpp"
+#include "Pool.hpp"
+
+namespace
+{
+	Pool<Mesh, 64> s_meshPool;
+}
+
+void* Mesh::operator new(std::size_t size)
+{
+	if (size != sizeof(Mesh))
+		return ::operator new(size);
+	return s_meshPool.allocate();
+}
+
+void Mesh::operator delete(void* ptr, std::size_t size)
+{
+	if (size != sizeof(Mesh))
+		::operator delete(ptr);
+	else
+		s_meshPool.free(ptr);
+}
 
 Mesh::Mesh(const ModelProp* prop)
 	: Model(prop),
 	m_maxPart(0),
 	m_bones(nullptr),
+	m_palette(nullptr),
 	m_skeleton(nullptr),
-	m_motion(nullptr)
+	m_motion(nullptr),
+	m_pose(nullptr),
+	m_phases(0),
+	m_phaseOffset(-1.0f)
 {
 	for (int p = 0; p < MAX_MESH_ELEMENTS; p++)
 		m_parts[p].obj = nullptr;
@@ -17,8 +44,12 @@ Mesh::Mesh(const ModelProp* prop)
 
 Mesh::~Mesh()
 {
+	if (m_pose)
+		PoseCache::release(m_pose);
 	if (m_bones)
 		delete[] m_bones;
+	if (m_palette)
+		delete[] m_palette;
 }
 
 void Mesh::loadPart(const string& filename, int part)
@@ -33,36 +64,105 @@ void Mesh::loadPart(const string& filename, int part)
 		m_maxPart = part + 1;
 }
 
-void Mesh::update(const vec3& pos, int frameCount)
+void Mesh::update(const vec3& pos, int frameCount, int boneLod)
 {
 	if (!m_loaded)
 		return;
 
 	if (m_motion)
 	{
-		m_currentFrame = mod(m_currentFrame + 0.5f * frameCount, (float)m_frameCount);
+		if (m_phases > 1)
+		{
+			if (m_phaseOffset < 0.0f)
+			{
+				const float slot = (float)m_frameCount / m_phases;
+				const float offset = (float)fmod(m_currentFrame - PoseCache::clock(), (double)m_frameCount);
+				m_phaseOffset = mod(floor(offset / slot + 0.5f) * slot, (float)m_frameCount);
+			}
+
+			m_currentFrame = (float)fmod(PoseCache::clock() + m_phaseOffset, (double)m_frameCount);
+		}
+		else
+			m_currentFrame = mod(m_currentFrame + 0.5f * frameCount, (float)m_frameCount);
+
+		const PoseCache::Pose* const pose = PoseCache::acquire(m_skeleton, m_motion, m_currentFrame, nextFrame(), boneLod);
+		if (m_pose)
+			PoseCache::release(m_pose);
+		m_pose = pose;
 
-		m_skeleton->animate(m_motion, m_bones, m_currentFrame, nextFrame());
+		Stats::add(Stats::AnimatedObjectCount);
 	}
 }
 
+void Mesh::setPhaseQuantization(int phases)
+{
+	m_phases = phases;
+	m_phaseOffset = -1.0f;
+}
+
 void Mesh::render(const mat4& world, int lod) const
 {
-	if (m_bones && m_skeleton->sendVS())
-	{
-		Shaders::skin.use();
-		m_skeleton->sendSkinBones(m_bones, nullptr, 0);
-	}
+	const mat4* const bones = m_pose ? m_pose->bones : m_bones;
+
+	if (bones && m_skeleton->sendVS())
+		Shaders::setSkinPalette(m_pose ? m_pose->palette : m_palette, m_skeleton->paletteSize());
+	else
+		Shaders::setSkinPalette(nullptr, 0);
 
 	for (int p = 0; p < m_maxPart; p++)
 	{
 		const Part& part = m_parts[p];
 
 		if (part.obj)
-			part.obj->render(m_bones, world, lod, 0, 0, 1.0f);
+			part.obj->render(bones, world, lod, 0, 0, 1.0f);
 	}
 }
 
+bool Mesh::intersectRay(const mat4& world, const mat4& invWorld, const vec3& origin, const vec3& dir, CollisionHit& hit) const
+{
+	bool ret = false;
+
+	for (int p = 0; p < m_maxPart; p++)
+	{
+		const CollisionBVH* const collision = m_parts[p].obj ? m_parts[p].obj->collision() : nullptr;
+
+		if (collision && collision->intersectRay(world, invWorld, origin, dir, hit))
+			ret = true;
+	}
+
+	return ret;
+}
+
+bool Mesh::intersectSphere(const mat4& world, const mat4& invWorld, const vec3& center, float radius, CollisionHit& hit) const
+{
+	bool ret = false;
+
+	for (int p = 0; p < m_maxPart; p++)
+	{
+		const CollisionBVH* const collision = m_parts[p].obj ? m_parts[p].obj->collision() : nullptr;
+
+		if (collision && collision->intersectSphere(world, invWorld, center, radius, hit))
+			ret = true;
+	}
+
+	return ret;
+}
+
+bool Mesh::intersectCapsule(const mat4& world, const mat4& invWorld, const vec3& p0, const vec3& p1, float radius, CollisionHit& hit) const
+{
+	bool ret = false;
+
+	for (int p = 0; p < m_maxPart; p++)
+	{
+		const CollisionBVH* const collision = m_parts[p].obj ? m_parts[p].obj->collision() : nullptr;
+
+		if (collision && collision->intersectCapsule(world, invWorld, p0, p1, radius, hit))
+			ret = true;
+	}
+
+	return ret;
+}
+
 bool Mesh::checkLoaded()
 {
 	for (int p = 0; p < m_maxPart; p++)
@@ -97,7 +197,12 @@ bool Mesh::checkLoaded()
 			m_skeleton = part.file->skeleton();
 
 			if (m_skeleton)
+			{
 				m_bones = m_skeleton->createBones();
+				m_palette = m_skeleton->createPalette();
+				if (m_palette)
+					m_skeleton->updatePalette(m_bones, m_palette);
+			}
 
 			m_motion = part.file->motion();
 			if (m_motion)
@@ -2,18 +2,33 @@
 
 #include "Model.hpp"
 #include "ModelFile.hpp"
+#include "PoseCache.hpp"
 
 #define MAX_MESH_ELEMENTS 21
 
+struct CollisionHit;
+
 class Mesh : public Model
 {
 public:
 	Mesh(const ModelProp* prop);
 	virtual ~Mesh();
 
+	// pooled, a subclass of another size goes to the heap
+	static void* operator new(std::size_t size);
+	static void operator delete(void* ptr, std::size_t size);
+
 	void loadPart(const string& filename, int part = 0);
 	void render(const mat4& world, int lod) const;
-	void update(const vec3& pos, int frameCount);
+	void update(const vec3& pos, int frameCount, int boneLod = 0);
+
+	// locks the animation to the shared clock at one of 'phases' evenly spaced offsets
+	// so instances can share poses, 1 or less to run freely
+	void setPhaseQuantization(int phases);
+
+	bool intersectRay(const mat4& world, const mat4& invWorld, const vec3& origin, const vec3& dir, CollisionHit& hit) const;
+	bool intersectSphere(const mat4& world, const mat4& invWorld, const vec3& center, float radius, CollisionHit& hit) const;
+	bool intersectCapsule(const mat4& world, const mat4& invWorld, const vec3& p0, const vec3& p1, float radius, CollisionHit& hit) const;
 
 protected:
 	virtual bool checkLoaded();
@@ -27,7 +42,11 @@ private:
 
 	Part m_parts[MAX_MESH_ELEMENTS];
 	mat4* m_bones;
+	vec4* m_palette;
 	Skeleton* m_skeleton;
 	int m_maxPart;
 	Motion* m_motion;
+	const PoseCache::Pose* m_pose;
+	int m_phases;
+	float m_phaseOffset;
 };
\ No newline at end of file
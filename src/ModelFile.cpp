@@ -2,18 +2,10 @@
 #include "ModelFile.hpp"
 #include "Object3D.hpp"
 #include "SfxBase.hpp"
+#include "Stats.hpp"
 
-namespace
-{
-	enum class ComponentType
-	{
-		None,
-		Object3D,
-		Sfx,
-		Motion,
-		Skeleton
-	};
-}
+// the parsed arrays mostly copy the file, plus the texture names and pointers, bone rows...
+#define ARENA_SLACK 16384
 
 ModelFile::ModelFile(const string& filename)
 	: Resource(filename),
@@ -38,6 +30,11 @@ ModelFile::~ModelFile()
 
 void ModelFile::onLoad(BinaryReader reader)
 {
+	Stats::Timer timer(Stats::ModelFileLoadTime);
+	Stats::add(Stats::ModelFileLoads);
+
+	m_arena.reserve(reader.size() + ARENA_SLACK);
+
 	const uint8_t ver = reader.read<uint8_t>();
 
 	uint8_t type, nameLen;
@@ -56,11 +53,11 @@ void ModelFile::onLoad(BinaryReader reader)
 		{
 		case ComponentType::Object3D:
 			m_obj = new Object3D();
-			m_obj->load(reader, ver);
+			m_obj->load(reader, ver, m_arena);
 			break;
 		case ComponentType::Skeleton:
 			m_skel = new Skeleton();
-			m_skel->load(reader, ver);
+			m_skel->load(reader, ver, m_arena);
 			break;
 		case ComponentType::Sfx:
 			m_sfx = new SfxBase();
@@ -69,7 +66,14 @@ void ModelFile::onLoad(BinaryReader reader)
 		case ComponentType::Motion:
 		{
 			Motion* motion = new Motion(name);
-			motion->load(reader, ver);
+			motion->load(reader, ver, m_arena);
+			m_motions.push_back(motion);
+			break;
+		}
+		case ComponentType::CompressedMotion:
+		{
+			Motion* motion = new Motion(name);
+			motion->loadCompressed(reader, ver, m_arena);
 			m_motions.push_back(motion);
 			break;
 		}
@@ -8,6 +8,18 @@ class SfxBase;
 
 class ModelFile : public Resource
 {
+public:
+	// a model file is a version byte followed by named components up to None
+	enum class ComponentType : uint8_t
+	{
+		None,
+		Object3D,
+		Sfx,
+		Motion,
+		Skeleton,
+		CompressedMotion
+	};
+
 public:
 	explicit ModelFile(const string& filename);
 	virtual ~ModelFile();
@@ -36,6 +48,8 @@ private:
 	Skeleton* m_skel;
 	vector<Motion*> m_motions;
 	SfxBase* m_sfx;
+	// backs the arrays of the object, skeleton and motions
+	Arena m_arena;
 };
 
 typedef RefCountedPtr<ModelFile> ModelFilePtr;
\ No newline at end of file
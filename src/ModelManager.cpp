@@ -2,18 +2,25 @@
 #include "ModelManager.hpp"
 #include "Mesh.hpp"
 #include "SfxModel.hpp"
+#include "WeakCache.hpp"
+#include "Config.hpp"
+#include "Stats.hpp"
 
-#include <unordered_map>
+// ids past this one are not indexed, the project props are numbered densely from 0
+#define MAX_PROP_ID 65535
 
 namespace ModelManager
 {
 	namespace
 	{
 		vector<ModelProp> s_modelProps[MAX_OBJTYPE];
+		// prop index by id, -1 for the ids the project doesn't have
+		vector<int> s_propIndices[MAX_OBJTYPE];
 
-		vector<ModelPtr> s_meshes;
+		// static meshes are shared by every object of the prop
+		WeakCache<const ModelProp*, Model> s_meshes;
 
-		unordered_map<string, ModelFilePtr> s_modelFiles;
+		WeakCache<string, ModelFile> s_modelFiles;
 	}
 
 	ModelPtr createModel(ObjectType objType, int id)
@@ -26,13 +33,13 @@ namespace ModelManager
 		{
 		case MODELTYPE_MESH:
 		{
-			for (std::size_t i = 0; i < s_meshes.size(); i++)
-				if (s_meshes[i]->prop() == prop)
-					return s_meshes[i];
+			ModelPtr meshPtr = s_meshes.find(prop);
+			if (meshPtr)
+				return meshPtr;
 
-			ModelPtr meshPtr = ModelPtr::create<Mesh>(prop);
+			meshPtr = ModelPtr::create<Mesh>(prop);
 			((Mesh*)meshPtr.get())->loadPart(prop->filename);
-			s_meshes.push_back(meshPtr);
+			s_meshes.insert(prop, meshPtr);
 			return meshPtr;
 		}
 		case MODELTYPE_ANIMATED_MESH:
@@ -45,6 +52,7 @@ namespace ModelManager
 		{
 			ModelPtr sfxPtr = ModelPtr::create<SfxModel>(prop);
 			((SfxModel*)sfxPtr.get())->load(prop->filename);
+			Stats::add(Stats::SfxModelAllocs);
 			return sfxPtr;
 		}
 		default:
@@ -63,6 +71,8 @@ namespace ModelManager
 				>> modelCount;
 
 			s_modelProps[objType].resize(modelCount);
+			vector<int>& indices = s_propIndices[objType];
+			indices.clear();
 
 			for (j = 0; j < modelCount; j++)
 			{
@@ -74,16 +84,27 @@ namespace ModelManager
 				prop.filename[len] = '\0';
 				reader >> prop.modelType
 					>> prop.distant;
+
+				if (prop.id < 0 || prop.id > MAX_PROP_ID)
+				{
+					emscripten_log(EM_LOG_WARN, "Model prop %d (type %d) out of range", prop.id, objType);
+					continue;
+				}
+
+				if (prop.id >= (int)indices.size())
+					indices.resize(prop.id + 1, -1);
+				indices[prop.id] = j;
 			}
+
+			indices.shrink_to_fit();
 		}
 	}
 
 	const ModelProp* modelProp(ObjectType type, int id)
 	{
-		const vector<ModelProp>& models = s_modelProps[type];
-		for (std::size_t i = 0; i < models.size(); i++)
-			if (models[i].id == id)
-				return &models[i];
+		const vector<int>& indices = s_propIndices[type];
+		if (id >= 0 && id < (int)indices.size() && indices[id] != -1)
+			return &s_modelProps[type][indices[id]];
 
 		emscripten_log(EM_LOG_ERROR, "Model prop %d (type %d) not found", id, type);
 		return nullptr;
@@ -91,12 +112,30 @@ namespace ModelManager
 
 	ModelFilePtr getModelFile(const string& filename)
 	{
-		auto it = s_modelFiles.find(filename);
-		if (it != s_modelFiles.end())
-			return it->second;
+		ModelFilePtr model = s_modelFiles.find(filename);
+		if (model)
+			return model;
 
-		ModelFilePtr model = ModelFilePtr::create("model/" + filename + ".bin");
-		s_modelFiles.insert(pair<string, ModelFilePtr>(filename, model));
+		model = ModelFilePtr::create("model/" + filename + ".bin");
+		s_modelFiles.insert(filename, model);
 		return model;
 	}
+
+	void update(double now)
+	{
+		s_meshes.update(now);
+		s_modelFiles.update(now);
+	}
+
+	void collect(double now)
+	{
+		const double evictBefore = now - Config::cacheGracePeriod * 1000.0;
+
+		// meshes first, the files they held are released by the next update
+		// files still loading hold a reference of their own
+		int count = s_meshes.evict(evictBefore);
+		count += s_modelFiles.evict(evictBefore);
+
+		Stats::add(Stats::ModelEvictions, count);
+	}
 }
\ No newline at end of file
@@ -13,4 +13,9 @@ namespace ModelManager
 	ModelFilePtr getModelFile(const string& filename);
 
 	void loadProject(BinaryReader& reader);
+
+	// stamps the shared meshes and model files no object references anymore
+	void update(double now);
+	// evicts the ones released for longer than Config::cacheGracePeriod
+	void collect(double now);
 }
\ No newline at end of file
@@ -1,37 +1,295 @@
 #include "StdAfx.hpp"
 #include "Motion.hpp"
-#include "Shaders.hpp"
+#include "Stats.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// scratch for Skeleton::animate: SoA local pose, then local and world affine matrices
+	vector<float> s_scratch;
+
+	// deepest bone still animated for each bone LOD, roughly dropping fingers and toes then the limbs
+	const int boneLodDepth[MAX_BONE_LODS] = { 0, 6, 3 };
+
+	const float smallestThreeRange = 0.70710678f;
+	const float smallestThreeMax = 32767.0f;
+
+	inline quat nlerp(const quat& a, const quat& b, float t)
+	{
+		const float sign = dot(a, b) < 0.0f ? -1.0f : 1.0f;
+		return normalize(quat(
+			a.w + (b.w * sign - a.w) * t,
+			a.x + (b.x * sign - a.x) * t,
+			a.y + (b.y * sign - a.y) * t,
+			a.z + (b.z * sign - a.z) * t));
+	}
+
+	inline float rotationError(const quat& a, const quat& b)
+	{
+		return 2.0f * acos(glm::min(glm::abs(dot(a, b)), 1.0f));
+	}
+
+	void encodeQuat(const quat& rot, uint16_t* out)
+	{
+		const quat q = normalize(rot);
+		float c[4] = { q.x, q.y, q.z, q.w };
+
+		int largest = 0;
+		for (int i = 1; i < 4; i++)
+			if (glm::abs(c[i]) > glm::abs(c[largest]))
+				largest = i;
+
+		const float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+		uint64_t bits = (uint64_t)largest;
+
+		for (int i = 0; i < 4; i++)
+		{
+			if (i == largest)
+				continue;
+
+			const float v = clamp(c[i] * sign / smallestThreeRange, -1.0f, 1.0f);
+			bits = (bits << 15) | (uint64_t)(int)((v * 0.5f + 0.5f) * smallestThreeMax + 0.5f);
+		}
+
+		out[0] = (uint16_t)bits;
+		out[1] = (uint16_t)(bits >> 16);
+		out[2] = (uint16_t)(bits >> 32);
+	}
+
+	void decodeQuat(const uint16_t* in, quat& q)
+	{
+		uint64_t bits = (uint64_t)in[0] | ((uint64_t)in[1] << 16) | ((uint64_t)in[2] << 32);
+		const int largest = (int)(bits >> 45);
+		float c[4];
+		float sum = 0.0f;
+
+		for (int i = 3; i >= 0; i--)
+		{
+			if (i == largest)
+				continue;
+
+			c[i] = ((float)(bits & 0x7fff) / smallestThreeMax * 2.0f - 1.0f) * smallestThreeRange;
+			sum += c[i] * c[i];
+			bits >>= 15;
+		}
+
+		c[largest] = sqrt(glm::max(1.0f - sum, 0.0f));
+		q = quat(c[3], c[0], c[1], c[2]);
+	}
+
+	inline void decodePos(const MotionTrack& track, int key, vec3& pos)
+	{
+		const uint16_t* const p = track.positions + key * 3;
+		pos = track.posMin + vec3((float)p[0], (float)p[1], (float)p[2]) * track.posScale;
+	}
+
+	void sampleTrack(const MotionTrack& track, int frame, TMAnimation& out)
+	{
+		const uint16_t* const key = upper_bound(track.frames, track.frames + track.keyCount, (uint16_t)frame);
+		const int k = glm::max((int)(key - track.frames) - 1, 0);
+
+		decodeQuat(track.rotations + k * 3, out.rot);
+		decodePos(track, k, out.pos);
+
+		if (k + 1 < track.keyCount && track.frames[k] < frame)
+		{
+			const float t = (float)(frame - track.frames[k]) / (float)(track.frames[k + 1] - track.frames[k]);
+			TMAnimation next;
+			decodeQuat(track.rotations + (k + 1) * 3, next.rot);
+			decodePos(track, k + 1, next.pos);
+
+			out.rot = nlerp(out.rot, next.rot, t);
+			out.pos = mix(out.pos, next.pos, t);
+		}
+
+		Stats::add(Stats::MotionKeysDecoded, 1.0);
+	}
+
+	// whether nlerp/lerp between the quantised keys first and last stays within the tolerances on every frame between them
+	bool segmentFits(const TMAnimation* frames, const vector<TMAnimation>& quantized, int first, int last, float rotTolerance, float posTolerance)
+	{
+		for (int j = first + 1; j < last; j++)
+		{
+			const float t = (float)(j - first) / (float)(last - first);
+
+			if (rotationError(nlerp(quantized[first].rot, quantized[last].rot, t), normalize(frames[j].rot)) > rotTolerance
+				|| length(mix(quantized[first].pos, quantized[last].pos, t) - frames[j].pos) > posTolerance)
+				return false;
+		}
+		return true;
+	}
+
+	template<typename T>
+	void append(vector<uint8_t>& out, const T* data, int count)
+	{
+		const uint8_t* const bytes = (const uint8_t*)data;
+		out.insert(out.end(), bytes, bytes + sizeof(T) * count);
+	}
+
+	// affine matrices are stored as 3 rows of 4 floats, translation in the last column
+	void toAffine(const mat4& m, float* out)
+	{
+		for (int r = 0; r < 3; r++)
+		{
+			out[r * 4 + 0] = m[0][r];
+			out[r * 4 + 1] = m[1][r];
+			out[r * 4 + 2] = m[2][r];
+			out[r * 4 + 3] = m[3][r];
+		}
+	}
+
+	void toMat4(const float* m, mat4& out)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			out[c][0] = m[c];
+			out[c][1] = m[4 + c];
+			out[c][2] = m[8 + c];
+			out[c][3] = c == 3 ? 1.0f : 0.0f;
+		}
+	}
+
+#if defined(__SSE2__)
+	inline void mulAffine(const float* a, const float* b, float* out)
+	{
+		const __m128 b0 = _mm_loadu_ps(b);
+		const __m128 b1 = _mm_loadu_ps(b + 4);
+		const __m128 b2 = _mm_loadu_ps(b + 8);
+		const __m128 b3 = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+
+		for (int r = 0; r < 3; r++)
+		{
+			const __m128 row = _mm_loadu_ps(a + r * 4);
+			__m128 res = _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+			res = _mm_add_ps(res, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+			res = _mm_add_ps(res, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+			res = _mm_add_ps(res, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(3, 3, 3, 3)), b3));
+			_mm_storeu_ps(out + r * 4, res);
+		}
+	}
+
+	// four bones per iteration, count is a multiple of 4
+	void buildLocalPose(const float* qx, const float* qy, const float* qz, const float* qw,
+		const float* tx, const float* ty, const float* tz, float* out, int count)
+	{
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+
+		for (int i = 0; i < count; i += 4)
+		{
+			const __m128 x = _mm_loadu_ps(qx + i);
+			const __m128 y = _mm_loadu_ps(qy + i);
+			const __m128 z = _mm_loadu_ps(qz + i);
+			const __m128 w = _mm_loadu_ps(qw + i);
+
+			const __m128 x2 = _mm_mul_ps(x, two);
+			const __m128 y2 = _mm_mul_ps(y, two);
+			const __m128 z2 = _mm_mul_ps(z, two);
+			const __m128 xx = _mm_mul_ps(x, x2);
+			const __m128 yy = _mm_mul_ps(y, y2);
+			const __m128 zz = _mm_mul_ps(z, z2);
+			const __m128 xy = _mm_mul_ps(x, y2);
+			const __m128 xz = _mm_mul_ps(x, z2);
+			const __m128 yz = _mm_mul_ps(y, z2);
+			const __m128 wx = _mm_mul_ps(w, x2);
+			const __m128 wy = _mm_mul_ps(w, y2);
+			const __m128 wz = _mm_mul_ps(w, z2);
+
+			__m128 r0 = _mm_sub_ps(one, _mm_add_ps(yy, zz));
+			__m128 r1 = _mm_sub_ps(xy, wz);
+			__m128 r2 = _mm_add_ps(xz, wy);
+			__m128 r3 = _mm_loadu_ps(tx + i);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_mm_storeu_ps(out + (i + 0) * 12, r0);
+			_mm_storeu_ps(out + (i + 1) * 12, r1);
+			_mm_storeu_ps(out + (i + 2) * 12, r2);
+			_mm_storeu_ps(out + (i + 3) * 12, r3);
+
+			r0 = _mm_add_ps(xy, wz);
+			r1 = _mm_sub_ps(one, _mm_add_ps(xx, zz));
+			r2 = _mm_sub_ps(yz, wx);
+			r3 = _mm_loadu_ps(ty + i);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_mm_storeu_ps(out + (i + 0) * 12 + 4, r0);
+			_mm_storeu_ps(out + (i + 1) * 12 + 4, r1);
+			_mm_storeu_ps(out + (i + 2) * 12 + 4, r2);
+			_mm_storeu_ps(out + (i + 3) * 12 + 4, r3);
+
+			r0 = _mm_sub_ps(xz, wy);
+			r1 = _mm_add_ps(yz, wx);
+			r2 = _mm_sub_ps(one, _mm_add_ps(xx, yy));
+			r3 = _mm_loadu_ps(tz + i);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_mm_storeu_ps(out + (i + 0) * 12 + 8, r0);
+			_mm_storeu_ps(out + (i + 1) * 12 + 8, r1);
+			_mm_storeu_ps(out + (i + 2) * 12 + 8, r2);
+			_mm_storeu_ps(out + (i + 3) * 12 + 8, r3);
+		}
+	}
+#else
+	inline void mulAffine(const float* a, const float* b, float* out)
+	{
+		for (int r = 0; r < 3; r++)
+		{
+			const float* const row = a + r * 4;
+			for (int c = 0; c < 4; c++)
+				out[r * 4 + c] = row[0] * b[c] + row[1] * b[4 + c] + row[2] * b[8 + c] + (c == 3 ? row[3] : 0.0f);
+		}
+	}
+
+	void buildLocalPose(const float* qx, const float* qy, const float* qz, const float* qw,
+		const float* tx, const float* ty, const float* tz, float* out, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			const float x2 = qx[i] * 2.0f, y2 = qy[i] * 2.0f, z2 = qz[i] * 2.0f;
+			const float xx = qx[i] * x2, yy = qy[i] * y2, zz = qz[i] * z2;
+			const float xy = qx[i] * y2, xz = qx[i] * z2, yz = qy[i] * z2;
+			const float wx = qw[i] * x2, wy = qw[i] * y2, wz = qw[i] * z2;
+			float* const m = out + i * 12;
+
+			m[0] = 1.0f - (yy + zz);
+			m[1] = xy - wz;
+			m[2] = xz + wy;
+			m[3] = tx[i];
+			m[4] = xy + wz;
+			m[5] = 1.0f - (xx + zz);
+			m[6] = yz - wx;
+			m[7] = ty[i];
+			m[8] = xz - wy;
+			m[9] = yz + wx;
+			m[10] = 1.0f - (xx + yy);
+			m[11] = tz[i];
+		}
+	}
+#endif
+}
 
 Motion::Motion(const char* name)
 	: m_frameCount(0),
 	m_boneCount(0),
 	m_attributes(nullptr),
 	m_frames(nullptr),
-	m_anis(nullptr)
+	m_anis(nullptr),
+	m_tracks(nullptr),
+	m_trackData(nullptr)
 {
 	strcpy(m_name, name);
 }
 
-Motion::~Motion()
-{
-	if (m_anis)
-		delete[] m_anis;
-	if (m_frames)
-		delete[] m_frames;
-	if (m_attributes)
-		delete[] m_attributes;
-}
-
-void Motion::load(BinaryReader& reader, uint8_t ver)
+void Motion::load(BinaryReader& reader, uint8_t ver, Arena& arena)
 {
 	reader >> m_frameCount
 		>> m_boneCount;
 
 	const int aniCount = reader.read<int>();
 
-	m_frames = new BoneFrame[m_boneCount];
-	m_attributes = new MotionAttribute[m_frameCount];
-	m_anis = new TMAnimation[aniCount];
+	m_frames = arena.alloc<BoneFrame>(m_boneCount);
+	m_attributes = arena.alloc<MotionAttribute>(m_frameCount);
+	m_anis = arena.alloc<TMAnimation>(aniCount);
 
 	TMAnimation* ani = m_anis;
 	int debug = 0;
@@ -66,6 +324,265 @@ void Motion::load(BinaryReader& reader, uint8_t ver)
 	}
 }
 
+void Motion::loadCompressed(BinaryReader& reader, uint8_t ver, Arena& arena)
+{
+	int totalKeyCount;
+
+	reader >> m_frameCount
+		>> m_boneCount
+		>> totalKeyCount;
+
+	m_frames = arena.alloc<BoneFrame>(m_boneCount);
+	m_tracks = arena.alloc<MotionTrack>(m_boneCount);
+	m_attributes = arena.alloc<MotionAttribute>(m_frameCount);
+	m_trackData = arena.alloc<uint16_t>(totalKeyCount * 7);
+
+	uint16_t* data = m_trackData;
+
+	for (int i = 0; i < m_boneCount; i++)
+	{
+		BoneFrame& frame = m_frames[i];
+		MotionTrack& track = m_tracks[i];
+
+		frame.frames = nullptr;
+		reader >> track.keyCount;
+
+		if (track.keyCount)
+		{
+			reader >> track.posMin
+				>> track.posScale;
+
+			track.frames = data;
+			track.rotations = data + track.keyCount;
+			track.positions = data + track.keyCount * 4;
+			reader.read(data, track.keyCount * 7);
+
+			data += track.keyCount * 7;
+		}
+		else
+		{
+			reader >> frame.TM;
+			track.frames = track.rotations = track.positions = nullptr;
+		}
+	}
+
+	for (int i = 0; i < m_frameCount; i++)
+	{
+		MotionAttribute& attrib = m_attributes[i];
+
+		reader >> attrib.type
+			>> attrib.soundId;
+	}
+}
+
+void Motion::compress(Arena& arena, const Skeleton* skeleton, float rotTolerance, float posTolerance, MotionCompressionStats* stats)
+{
+	if (m_tracks || !m_frames)
+		return;
+
+	int i, j, k;
+
+	// errors near the root are amplified by every bone below it
+	vector<int> chainLength(m_boneCount, 0);
+	if (skeleton && skeleton->boneCount() == m_boneCount)
+	{
+		for (i = m_boneCount - 1; i >= 0; i--)
+		{
+			const int parentId = skeleton->bone(i).parentId;
+			if (parentId >= 0 && parentId < i)
+				chainLength[parentId] = glm::max(chainLength[parentId], chainLength[i] + 1);
+		}
+	}
+
+	vector<uint16_t> data;
+	vector<TMAnimation> quantized(m_frameCount);
+	vector<int> keys;
+	int rawFrameCount = 0;
+
+	m_tracks = arena.alloc<MotionTrack>(m_boneCount);
+
+	if (stats)
+	{
+		stats->frameCount = 0;
+		stats->keyCount = 0;
+		stats->maxRotError = 0.0f;
+		stats->maxPosError = 0.0f;
+	}
+
+	for (i = 0; i < m_boneCount; i++)
+	{
+		MotionTrack& track = m_tracks[i];
+		const TMAnimation* const frames = m_frames[i].frames;
+
+		track.keyCount = 0;
+		track.frames = track.rotations = track.positions = nullptr;
+
+		if (!frames || !m_frameCount)
+			continue;
+
+		rawFrameCount += m_frameCount;
+
+		vec3 posMin = frames[0].pos, posMax = frames[0].pos;
+		for (j = 1; j < m_frameCount; j++)
+		{
+			posMin = glm::min(posMin, frames[j].pos);
+			posMax = glm::max(posMax, frames[j].pos);
+		}
+
+		track.posMin = posMin;
+		track.posScale = (posMax - posMin) / 65535.0f;
+
+		// reduce on the quantised values so the tolerance covers both errors
+		uint16_t rot[3], pos[3];
+		for (j = 0; j < m_frameCount; j++)
+		{
+			encodeQuat(frames[j].rot, rot);
+			decodeQuat(rot, quantized[j].rot);
+
+			for (k = 0; k < 3; k++)
+			{
+				pos[k] = track.posScale[k] > 0.0f ? (uint16_t)((frames[j].pos[k] - posMin[k]) / track.posScale[k] + 0.5f) : 0;
+				quantized[j].pos[k] = posMin[k] + pos[k] * track.posScale[k];
+			}
+		}
+
+		const float boneRotTolerance = rotTolerance / (1 + chainLength[i]);
+		const float bonePosTolerance = posTolerance / (1 + chainLength[i]);
+
+		keys.clear();
+		keys.push_back(0);
+
+		// greedy: the next key is searched by doubling the segment then bisecting between the last
+		// fitting and the first failing end, O(n log n) segment checks instead of growing one frame at a time
+		int first = 0;
+		while (first < m_frameCount - 1)
+		{
+			int last = first + 1;
+			int fail = m_frameCount;
+
+			for (int step = 1; last + step < m_frameCount; step *= 2)
+			{
+				if (!segmentFits(frames, quantized, first, last + step, boneRotTolerance, bonePosTolerance))
+				{
+					fail = last + step;
+					break;
+				}
+				last += step;
+			}
+
+			while (fail - last > 1)
+			{
+				const int mid = (last + fail) / 2;
+				if (segmentFits(frames, quantized, first, mid, boneRotTolerance, bonePosTolerance))
+					last = mid;
+				else
+					fail = mid;
+			}
+
+			keys.push_back(last);
+			first = last;
+		}
+
+		track.keyCount = (int)keys.size();
+
+		const std::size_t offset = data.size();
+		data.resize(offset + track.keyCount * 7);
+		uint16_t* const out = &data[offset];
+
+		for (j = 0; j < track.keyCount; j++)
+		{
+			const int frame = keys[j];
+
+			out[j] = (uint16_t)frame;
+			encodeQuat(frames[frame].rot, out + track.keyCount + j * 3);
+
+			for (k = 0; k < 3; k++)
+				out[track.keyCount * 4 + j * 3 + k] = track.posScale[k] > 0.0f ? (uint16_t)((frames[frame].pos[k] - posMin[k]) / track.posScale[k] + 0.5f) : 0;
+		}
+
+		if (stats)
+		{
+			stats->frameCount += m_frameCount;
+			stats->keyCount += track.keyCount;
+		}
+	}
+
+	m_trackData = arena.alloc<uint16_t>((int)data.size());
+	if (!data.empty())
+		memcpy(m_trackData, &data[0], data.size() * sizeof(uint16_t));
+
+	uint16_t* ptr = m_trackData;
+	for (i = 0; i < m_boneCount; i++)
+	{
+		MotionTrack& track = m_tracks[i];
+		if (!track.keyCount)
+			continue;
+
+		track.frames = ptr;
+		track.rotations = ptr + track.keyCount;
+		track.positions = ptr + track.keyCount * 4;
+		ptr += track.keyCount * 7;
+
+		if (stats)
+		{
+			TMAnimation decoded;
+			for (j = 0; j < m_frameCount; j++)
+			{
+				sampleTrack(track, j, decoded);
+				stats->maxRotError = glm::max(stats->maxRotError, rotationError(decoded.rot, normalize(m_frames[i].frames[j].rot)));
+				stats->maxPosError = glm::max(stats->maxPosError, length(decoded.pos - m_frames[i].frames[j].pos));
+			}
+		}
+
+		m_frames[i].frames = nullptr;
+	}
+
+	if (stats)
+	{
+		stats->rawSize = rawFrameCount * (int)sizeof(TMAnimation);
+		stats->compressedSize = (int)(data.size() * sizeof(uint16_t)) + m_boneCount * (int)sizeof(MotionTrack);
+	}
+
+	// the raw frames stay in the arena until the file is released
+	m_anis = nullptr;
+}
+
+void Motion::writeCompressed(vector<uint8_t>& out) const
+{
+	if (!m_tracks)
+		return;
+
+	int totalKeyCount = 0;
+	for (int i = 0; i < m_boneCount; i++)
+		totalKeyCount += m_tracks[i].keyCount;
+
+	append(out, &m_frameCount, 1);
+	append(out, &m_boneCount, 1);
+	append(out, &totalKeyCount, 1);
+
+	for (int i = 0; i < m_boneCount; i++)
+	{
+		const MotionTrack& track = m_tracks[i];
+
+		append(out, &track.keyCount, 1);
+
+		if (track.keyCount)
+		{
+			append(out, &track.posMin, 1);
+			append(out, &track.posScale, 1);
+			append(out, track.frames, track.keyCount * 7);
+		}
+		else
+			append(out, &m_frames[i].TM, 1);
+	}
+
+	for (int i = 0; i < m_frameCount; i++)
+	{
+		append(out, &m_attributes[i].type, 1);
+		append(out, &m_attributes[i].soundId, 1);
+	}
+}
+
 Skeleton::Skeleton()
 	: m_bones(nullptr),
 	m_boneCount(0),
@@ -74,17 +591,11 @@ Skeleton::Skeleton()
 {
 }
 
-Skeleton::~Skeleton()
-{
-	if (m_bones)
-		delete[] m_bones;
-}
-
-void Skeleton::load(BinaryReader& reader, uint8_t ver)
+void Skeleton::load(BinaryReader& reader, uint8_t ver, Arena& arena)
 {
 	reader >> m_boneCount;
 
-	m_bones = new Bone[m_boneCount];
+	m_bones = arena.alloc<Bone>(m_boneCount);
 
 	for (int i = 0; i < m_boneCount; i++)
 	{
@@ -93,10 +604,32 @@ void Skeleton::load(BinaryReader& reader, uint8_t ver)
 		reader >> bone.parentId
 			>> bone.TM
 			>> bone.inverseTM;
+
+		toAffine(bone.inverseTM, &bone.inverseRows[0].x);
+
+		if (bone.parentId >= 0 && bone.parentId < i)
+		{
+			const Bone& parent = m_bones[bone.parentId];
+			bone.depth = parent.depth + 1;
+			toAffine(parent.inverseTM * bone.TM, &bone.restRows[0].x);
+		}
+		else
+		{
+			bone.depth = 0;
+			toAffine(bone.TM, &bone.restRows[0].x);
+		}
 	}
 
 	reader >> m_sendVS
 		>> m_skinBoneCount;
+
+	if (m_skinBoneCount > MAX_SHADER_BONES)
+	{
+		emscripten_log(EM_LOG_ERROR, "Skeleton has too many skin bones (%d > %d)", m_skinBoneCount, MAX_SHADER_BONES);
+		m_skinBoneCount = MAX_SHADER_BONES;
+	}
+	if (m_skinBoneCount > m_boneCount)
+		m_skinBoneCount = m_boneCount;
 }
 
 mat4* Skeleton::createBones() const
@@ -112,44 +645,120 @@ void Skeleton::resetBones(mat4* bones) const
 		bones[i] = m_bones[i].TM;
 }
 
-void Skeleton::animate(Motion* motion, mat4* bones, float currentFrame_, int nextFrame)
+vec4* Skeleton::createPalette() const
+{
+	return m_skinBoneCount ? new vec4[m_skinBoneCount * 3] : nullptr;
+}
+
+void Skeleton::updatePalette(const mat4* bones, vec4* palette) const
 {
+	float world[12];
+
+	for (int i = 0; i < m_skinBoneCount; i++)
+	{
+		toAffine(bones[i], world);
+		mulAffine(world, &m_bones[i].inverseRows[0].x, &palette[i * 3].x);
+	}
+}
+
+void Skeleton::animate(Motion* motion, mat4* bones, vec4* palette, float currentFrame_, int nextFrame, int boneLod) const
+{
+	Stats::Timer timer(Stats::AnimationTime);
+
 	const BoneFrame* const frames = motion->m_frames;
+	const MotionTrack* const tracks = motion->m_tracks;
 	const int currentFrame = (int)currentFrame_;
 	const float slp = currentFrame_ - (float)currentFrame;
+	const int count = (m_boneCount + 3) & ~3;
+	const int maxDepth = boneLod > 0 ? boneLodDepth[glm::min(boneLod, MAX_BONE_LODS - 1)] : m_boneCount;
 
-	mat4 m;
+	if ((int)s_scratch.size() < count * 31)
+		s_scratch.resize(count * 31);
 
-	for (int i = 0; i < m_boneCount; i++)
+	float* const qx = &s_scratch[0];
+	float* const qy = qx + count;
+	float* const qz = qy + count;
+	float* const qw = qz + count;
+	float* const tx = qw + count;
+	float* const ty = tx + count;
+	float* const tz = ty + count;
+	float* const local = tz + count;
+	float* const world = local + count * 12;
+
+	int i, evaluated = 0;
+	TMAnimation decoded[2];
+
+	// local pose as SoA, nlerp through the shortest arc
+	for (i = 0; i < m_boneCount; i++)
 	{
-		if (frames[i].frames)
+		if (m_bones[i].depth <= maxDepth && (frames[i].frames || (tracks && tracks[i].keyCount)))
 		{
-			const TMAnimation& frame = frames[i].frames[currentFrame];
-			const TMAnimation& next = frames[i].frames[nextFrame];
+			if (!frames[i].frames)
+			{
+				sampleTrack(tracks[i], currentFrame, decoded[0]);
+				if (nextFrame != currentFrame)
+					sampleTrack(tracks[i], nextFrame, decoded[1]);
+				else
+					decoded[1] = decoded[0];
+			}
 
-			m = translate(mat4(), lerp(frame.pos, next.pos, slp)) * mat4_cast(lerp(frame.rot, next.rot, slp));
+			const TMAnimation& frame = frames[i].frames ? frames[i].frames[currentFrame] : decoded[0];
+			const TMAnimation& next = frames[i].frames ? frames[i].frames[nextFrame] : decoded[1];
+
+			const float sign = dot(frame.rot, next.rot) < 0.0f ? -1.0f : 1.0f;
+			const float x = frame.rot.x + (next.rot.x * sign - frame.rot.x) * slp;
+			const float y = frame.rot.y + (next.rot.y * sign - frame.rot.y) * slp;
+			const float z = frame.rot.z + (next.rot.z * sign - frame.rot.z) * slp;
+			const float w = frame.rot.w + (next.rot.w * sign - frame.rot.w) * slp;
+			const float lenSq = x * x + y * y + z * z + w * w;
+			const float invLen = lenSq > 0.0f ? 1.0f / sqrt(lenSq) : 0.0f;
+
+			qx[i] = x * invLen;
+			qy[i] = y * invLen;
+			qz[i] = z * invLen;
+			qw[i] = lenSq > 0.0f ? w * invLen : 1.0f;
+			tx[i] = frame.pos.x + (next.pos.x - frame.pos.x) * slp;
+			ty[i] = frame.pos.y + (next.pos.y - frame.pos.y) * slp;
+			tz[i] = frame.pos.z + (next.pos.z - frame.pos.z) * slp;
+			evaluated++;
 		}
 		else
-			m = frames[i].TM;
-
-		if (m_bones[i].parentId != -1)
-			m = bones[m_bones[i].parentId] * m;
+		{
+			qx[i] = qy[i] = qz[i] = 0.0f;
+			qw[i] = 1.0f;
+			tx[i] = ty[i] = tz[i] = 0.0f;
+		}
+	}
 
-		bones[i] = m;
+	for (; i < count; i++)
+	{
+		qx[i] = qy[i] = qz[i] = 0.0f;
+		qw[i] = 1.0f;
+		tx[i] = ty[i] = tz[i] = 0.0f;
 	}
-}
 
-void Skeleton::sendSkinBones(const mat4* bones, const int* boneList, int boneCount) const
-{
-	static mat4 buffer[MAX_SHADER_BONES];
+	buildLocalPose(qx, qy, qz, qw, tx, ty, tz, local, count);
 
-	if (!boneList)
+	for (i = 0; i < m_boneCount; i++)
 	{
-		boneCount = m_skinBoneCount;
+		float* const m = local + i * 12;
 
-		for (int i = 0; i < boneCount; i++)
-			buffer[i] = bones[i] * m_bones[i].inverseTM;
+		if (m_bones[i].depth > maxDepth)
+			memcpy(m, &m_bones[i].restRows[0].x, sizeof(float) * 12);
+		else if (!frames[i].frames && !(tracks && tracks[i].keyCount))
+			toAffine(frames[i].TM, m);
+
+		const int parentId = m_bones[i].parentId;
+		if (parentId != -1)
+			mulAffine(world + parentId * 12, m, world + i * 12);
+		else
+			memcpy(world + i * 12, m, sizeof(float) * 12);
+
+		toMat4(world + i * 12, bones[i]);
 	}
 
-	gl::uniform(Shaders::skin.uBones, boneCount, buffer);
-}
\ No newline at end of file
+	for (i = 0; i < m_skinBoneCount; i++)
+		mulAffine(world + i * 12, &m_bones[i].inverseRows[0].x, &palette[i * 3].x);
+
+	Stats::add(Stats::AnimatedBones, evaluated);
+}
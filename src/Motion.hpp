@@ -1,6 +1,13 @@
 #pragma once
 
 #include "BinaryReader.hpp"
+#include "Arena.hpp"
+
+// skin bones the skinning shader can take
+#define MAX_SHADER_BONES 36
+
+// bone LOD 0 evaluates the whole skeleton, higher LODs skip the deepest bones
+#define MAX_BONE_LODS 3
 
 struct MotionAttribute
 {
@@ -20,6 +27,11 @@ struct Bone
 	int parentId;
 	mat4 TM;
 	mat4 inverseTM;
+	// inverseTM as the rows of an affine 3x4 matrix
+	vec4 inverseRows[3];
+	// bind pose relative to the parent, used for bones skipped by the bone LOD
+	vec4 restRows[3];
+	int depth;
 };
 
 struct TMAnimation
@@ -34,16 +46,47 @@ struct BoneFrame
 	mat4 TM;
 };
 
+// key reduced track, rotations as 48 bit smallest-three quaternions and
+// positions as 16 bit values in the [posMin, posMin + posScale * 65535] range
+struct MotionTrack
+{
+	int keyCount;
+	uint16_t* frames;
+	uint16_t* rotations;
+	uint16_t* positions;
+	vec3 posMin;
+	vec3 posScale;
+};
+
+struct MotionCompressionStats
+{
+	int frameCount;
+	int keyCount;
+	int rawSize;
+	int compressedSize;
+	float maxRotError;
+	float maxPosError;
+};
+
 class Skeleton;
 
 class Motion
 {
 public:
 	explicit Motion(const char* name);
-	~Motion();
 
-	void load(BinaryReader& reader, uint8_t ver);
+	// the frames and tracks are allocated in the arena of the model file
+	void load(BinaryReader& reader, uint8_t ver, Arena& arena);
+	void loadCompressed(BinaryReader& reader, uint8_t ver, Arena& arena);
 
+	// replaces the raw frames with compressed tracks, the tolerances (radians and
+	// model units) are tightened for bones with long chains below them
+	void compress(Arena& arena, const Skeleton* skeleton, float rotTolerance, float posTolerance, MotionCompressionStats* stats = nullptr);
+	void writeCompressed(vector<uint8_t>& out) const;
+
+	bool compressed() const {
+		return m_tracks != nullptr;
+	}
 	const char* name() const {
 		return m_name;
 	}
@@ -58,6 +101,8 @@ private:
 	BoneFrame* m_frames;
 	MotionAttribute* m_attributes;
 	TMAnimation* m_anis;
+	MotionTrack* m_tracks;
+	uint16_t* m_trackData;
 
 	friend class Skeleton;
 
@@ -70,19 +115,29 @@ class Skeleton
 {
 public:
 	explicit Skeleton();
-	~Skeleton();
 
-	void load(BinaryReader& reader, uint8_t ver);
+	void load(BinaryReader& reader, uint8_t ver, Arena& arena);
 
 	mat4* createBones() const;
 	void resetBones(mat4* bones) const;
 
-	void animate(Motion* motion, mat4* bones, float currentFrame, int nextFrame);
+	// skinning palette, 3 vec4 rows per skin bone with the inverse bind pose applied
+	vec4* createPalette() const;
+	void updatePalette(const mat4* bones, vec4* palette) const;
+
+	void animate(Motion* motion, mat4* bones, vec4* palette, float currentFrame, int nextFrame, int boneLod = 0) const;
 	bool sendVS() const {
 		return m_sendVS;
 	}
-
-	void sendSkinBones(const mat4* bones, const int* boneList, int boneCount) const;
+	int boneCount() const {
+		return m_boneCount;
+	}
+	int paletteSize() const {
+		return m_skinBoneCount * 3;
+	}
+	const Bone& bone(int i) const {
+		return m_bones[i];
+	}
 
 private:
 	int m_boneCount;
@@ -6,6 +6,8 @@
 #include "Mesh.hpp"
 #include "SfxModel.hpp"
 #include "Config.hpp"
+#include "CollisionBVH.hpp"
+#include "Stats.hpp"
 
 namespace
 {
@@ -14,6 +16,14 @@ namespace
 	const float factorDistant[4] = { maxDistant[0] - minDistant[0], maxDistant[1] - minDistant[1], maxDistant[2] - minDistant[2], maxDistant[3] - minDistant[3] };
 
 	const float objectQuality[3] = { 15, 30, 50 };
+
+	// animation update tiers: every frame, every 2nd, every 4th, frozen beyond the last one
+	// an object takes the finer of its distance and projected size (radius / half screen height) tiers
+	const int animationTierFrozen = 3;
+	const float animationTierDistance[animationTierFrozen] = { 40, 80, 120 };
+	const float animationTierSize[animationTierFrozen] = { 0.25f, 0.1f, 0.04f };
+
+	uint32_t s_animationSlot = 0;
 }
 
 bool Object::sortFarToNear(const Object* obj1, const Object* obj2)
@@ -28,8 +38,11 @@ Object::Object(ObjectType type)
 	m_updateMatrix(true),
 	m_visible(false),
 	m_distToCamera(99999.9f),
+	m_pixelsPerUnit(0.0f),
 	m_scale(1),
-	m_objFlags(0)
+	m_objFlags(0),
+	m_animationSlot(s_animationSlot++),
+	m_animationFrames(0)
 {
 }
 
@@ -101,7 +114,43 @@ void Object::update(int frameCount)
 	if (m_model->modelType() == MODELTYPE_SFX)
 		((SfxModel*)m_model.get())->update(frameCount);
 	else
-		((Mesh*)m_model.get())->update(m_pos, frameCount);
+	{
+		m_animationFrames += frameCount;
+
+		const int tier = Config::animationLod ? animationTier() : 0;
+		if (tier == animationTierFrozen)
+		{
+			m_animationFrames = 0;
+			Stats::add(Stats::AnimationFrozen);
+			return;
+		}
+
+		// objects of a tier are spread over the frames of its interval
+		if ((m_world->updateTick() + m_animationSlot) & ((1 << tier) - 1))
+		{
+			Stats::add(Stats::AnimationThrottled);
+			return;
+		}
+
+		((Mesh*)m_model.get())->update(m_pos, m_animationFrames, tier);
+		m_animationFrames = 0;
+	}
+}
+
+int Object::animationTier() const
+{
+	const float radius = length(m_bbMax - m_bbMin) * 0.5f;
+	const float size = radius * ShaderVars::proj[1][1] / glm::max(m_distToCamera, 1.0f);
+
+	int tier = 0;
+	while (tier < animationTierFrozen && m_distToCamera >= animationTierDistance[tier] && size <= animationTierSize[tier])
+		tier++;
+
+	// keep the ones out of the frustum moving, they are only seen when the camera turns
+	if (!m_visible && tier < 2)
+		tier = 2;
+
+	return tier;
 }
 
 void Object::setFlag(uint32_t flag, bool val)
@@ -121,6 +170,7 @@ void Object::cull()
 		updateMatrix();
 
 	m_distToCamera = length(ShaderVars::cameraPos - m_pos);
+	m_pixelsPerUnit = glm::max(m_scale.x, glm::max(m_scale.y, m_scale.z)) * 0.5f * ShaderVars::proj[1][1] * (float)ShaderVars::viewport.height() / glm::max(m_distToCamera, 1.0f);
 
 	const uint8_t distant = m_model->prop()->distant;
 	if (m_distToCamera > (minDistant[distant] + Config::fieldViewFactor * factorDistant[distant]))
@@ -193,7 +243,66 @@ void Object::updateMatrix()
 	m_bounds[7].z = bbMax.z;
 
 	for (int i = 0; i < 8; i++)
+	{
 		m_bounds[i] = transformCoord(m_bounds[i], m_TM);
 
+		m_bbMin = i ? glm::min(m_bbMin, m_bounds[i]) : m_bounds[i];
+		m_bbMax = i ? glm::max(m_bbMax, m_bounds[i]) : m_bounds[i];
+	}
+
+	m_invTM = inverse(m_TM);
 	m_updateMatrix = false;
+}
+
+Mesh* Object::collisionMesh()
+{
+	if (!m_model || !m_model->loaded())
+		return nullptr;
+
+	const int type = m_model->modelType();
+	if (type != MODELTYPE_MESH && type != MODELTYPE_ANIMATED_MESH)
+		return nullptr;
+
+	if (m_updateMatrix)
+		updateMatrix();
+
+	return static_cast<Mesh*>(m_model.get());
+}
+
+bool Object::intersectRay(const vec3& origin, const vec3& dir, CollisionHit& hit)
+{
+	Mesh* const mesh = collisionMesh();
+	if (!mesh || !intersectRayBox(origin, dir, m_bbMin, m_bbMax, hit.dist))
+		return false;
+
+	return mesh->intersectRay(m_TM, m_invTM, origin, dir, hit);
+}
+
+bool Object::intersectSphere(const vec3& center, float radius, CollisionHit& hit)
+{
+	Mesh* const mesh = collisionMesh();
+	if (!mesh)
+		return false;
+
+	if (center.x + radius < m_bbMin.x || center.y + radius < m_bbMin.y || center.z + radius < m_bbMin.z
+		|| center.x - radius > m_bbMax.x || center.y - radius > m_bbMax.y || center.z - radius > m_bbMax.z)
+		return false;
+
+	return mesh->intersectSphere(m_TM, m_invTM, center, radius, hit);
+}
+
+bool Object::intersectCapsule(const vec3& p0, const vec3& p1, float radius, CollisionHit& hit)
+{
+	Mesh* const mesh = collisionMesh();
+	if (!mesh)
+		return false;
+
+	const vec3 bbMin = glm::min(p0, p1) - vec3(radius);
+	const vec3 bbMax = glm::max(p0, p1) + vec3(radius);
+
+	if (bbMax.x < m_bbMin.x || bbMax.y < m_bbMin.y || bbMax.z < m_bbMin.z
+		|| bbMin.x > m_bbMax.x || bbMin.y > m_bbMax.y || bbMin.z > m_bbMax.z)
+		return false;
+
+	return mesh->intersectCapsule(m_TM, m_invTM, p0, p1, radius, hit);
 }
\ No newline at end of file
@@ -3,13 +3,17 @@
 #include "Model.hpp"
 
 class World;
+class Mesh;
+struct CollisionHit;
 
 class Object
 {
 public:
 	enum ObjFlags
 	{
-		Delete = 1 << 0
+		Delete = 1 << 0,
+		// in the object pool of its landscape, only destructed when deleted
+		Pooled = 1 << 1
 	};
 
 public:
@@ -25,6 +29,11 @@ public:
 	void cull();
 	void updateMatrix();
 
+	// world space, see CollisionBVH for the hit.dist convention
+	bool intersectRay(const vec3& origin, const vec3& dir, CollisionHit& hit);
+	bool intersectSphere(const vec3& center, float radius, CollisionHit& hit);
+	bool intersectCapsule(const vec3& p0, const vec3& p1, float radius, CollisionHit& hit);
+
 	World* world() const {
 		return m_world;
 	}
@@ -43,6 +52,10 @@ public:
 	const float distToCamera() const {
 		return m_distToCamera;
 	}
+	// screen pixels a unit of the model covers at its distance, updated by cull
+	float pixelsPerUnit() const {
+		return m_pixelsPerUnit;
+	}
 
 	bool hasObjFlag(uint32_t flag) const {
 		return (m_objFlags & flag) != 0;
@@ -69,14 +82,23 @@ protected:
 	ModelPtr m_model;
 	bool m_updateMatrix;
 	mat4 m_TM;
+	mat4 m_invTM;
 	vec3 m_bounds[8];
+	vec3 m_bbMin, m_bbMax;
 	bool m_visible;
 	float m_distToCamera;
+	float m_pixelsPerUnit;
 	uint32_t m_objFlags;
+	uint32_t m_animationSlot;
+	int m_animationFrames;
 
 public:
 	static bool sortFarToNear(const Object*, const Object*);
 
+private:
+	Mesh* collisionMesh();
+	int animationTier() const;
+
 private:
 	Object(const Object&) = delete;
 	Object& operator=(const Object&) = delete;
@@ -4,6 +4,7 @@
 #include "ShaderVars.hpp"
 #include "TextureManager.hpp"
 #include "GameTime.hpp"
+#include "CollisionBVH.hpp"
 
 Object3D::Object3D()
 	: m_hasCollObj(false),
@@ -12,6 +13,7 @@ Object3D::Object3D()
 	m_collVertices(nullptr),
 	m_collIndexCount(0),
 	m_collIndices(nullptr),
+	m_collision(nullptr),
 	m_vertexBufferSize(0),
 	m_vertexBufferData(nullptr),
 	m_indices(nullptr),
@@ -33,22 +35,14 @@ Object3D::~Object3D()
 	if (gl::isContextActive())
 		onContextLost();
 
-	if (m_collVertices)
-		delete[] m_collVertices;
-	if (m_collIndices)
-		delete[] m_collIndices;
-	if (m_vertexBufferData)
-		delete[] m_vertexBufferData;
-	if (m_indices)
-		delete[] m_indices;
-	if (m_textureNames)
-		delete[] m_textureNames;
-	if (m_materialBlocks)
-		delete[] m_materialBlocks;
-	if (m_geometryObjects)
-		delete[] m_geometryObjects;
+	if (m_collision)
+		delete m_collision;
+
 	if (m_textures)
-		delete[] m_textures;
+	{
+		for (int i = 0; i < m_textureCount * MAX_TEXTURE_EX; i++)
+			m_textures[i].~TexturePtr();
+	}
 }
 
 void Object3D::onContextLost()
@@ -113,7 +107,8 @@ void Object3D::render(const mat4* bones, const mat4& world, int lod, int texture
 
 	GeometryObjectType curType = GMT_ERROR;
 	Shaders::ObjectProgram* program = nullptr;
-	ivec3 shaderEffects;
+	int curFeatures = -1;
+	bool worldChanged;
 	mat4 worldTM;
 
 	for (int i = 0; i < group.objectCount; i++)
@@ -128,15 +123,9 @@ void Object3D::render(const mat4* bones, const mat4& world, int lod, int texture
 				break;
 
 			if (curType != GMT_SKIN)
-			{
 				m_normalVAO.bind();
-				program = &Shaders::object;
-			}
 			else
-			{
 				m_skinVAO.bind();
-				program = &Shaders::skin;
-			}
 
 			if (curType != GMT_LIGHT)
 				gl::enableDepthWrite();
@@ -146,11 +135,7 @@ void Object3D::render(const mat4* bones, const mat4& world, int lod, int texture
 				gl::disableCull();
 				gl::enableBlend();
 				gl::blendFunc(GL_ONE, GL_ONE);
-
-				shaderEffects = ivec3(false);
 			}
-
-			program->use();
 		}
 
 		if (curType == GMT_SKIN)
@@ -158,14 +143,12 @@ void Object3D::render(const mat4* bones, const mat4& world, int lod, int texture
 		else
 			worldTM = world * bones[obj.boneId];
 
-		const mat4 WVP = ShaderVars::viewProj * worldTM;
-
-		gl::uniform(program->uWVP, WVP);
-		gl::uniform(program->uWorld, worldTM);
+		worldChanged = true;
 
 		for (int j = 0; j < obj.materialBlockCount; j++)
 		{
 			const MaterialBlock& block = obj.materialBlocks[j];
+			int features = curType == GMT_SKIN ? Shaders::ObjectSkin : 0;
 
 			if (curType != GMT_LIGHT)
 			{
@@ -183,21 +166,37 @@ void Object3D::render(const mat4* bones, const mat4& world, int lod, int texture
 				else
 					gl::enableCull();
 
-				if (effect & NoEffect)
-					shaderEffects = ivec3(false);
-				else
-					shaderEffects = ivec3(true, !(block.effect & SelfIlluminate), (block.effect & Reflect));
+				if (!(effect & NoEffect))
+				{
+					features |= Shaders::ObjectFog;
+					if (!(block.effect & SelfIlluminate))
+						features |= Shaders::ObjectLighting;
+				}
 			}
 
 			if (block.textureId == -1)
 				ShaderVars::blankTexture.bind();
 			else
-				textures[block.textureId]->bind();
+			{
+				const Texture* const texture = textures[block.textureId].get();
+				texture->bind(0, block.uvDensity);
+
+				// opaque textures never reach the discard
+				if (texture->resident() && texture->hasAlpha())
+					features |= Shaders::ObjectAlphaTest;
+			}
 
-			if (program->curEffects != shaderEffects)
+			if (features != curFeatures)
 			{
-				gl::uniform(program->uEffects, shaderEffects);
-				program->curEffects = shaderEffects;
+				curFeatures = features;
+				program = &Shaders::useObjectVariant(features);
+				worldChanged = true;
+			}
+
+			if (worldChanged)
+			{
+				gl::uniform(program->uWorld, worldTM);
+				worldChanged = false;
 			}
 
 			gl::drawElements<uint16_t>(GL_TRIANGLES, block.indexCount, block.indices);
@@ -205,7 +204,7 @@ void Object3D::render(const mat4* bones, const mat4& world, int lod, int texture
 	}
 }
 
-void Object3D::load(BinaryReader& reader, uint8_t ver)
+void Object3D::load(BinaryReader& reader, uint8_t ver, Arena& arena)
 {
 	reader >> m_bbMin
 		>> m_bbMax
@@ -215,14 +214,14 @@ void Object3D::load(BinaryReader& reader, uint8_t ver)
 	reader >> m_collVertexCount;
 	if (m_collVertexCount)
 	{
-		m_collVertices = new vec3[m_collVertexCount];
+		m_collVertices = arena.alloc<vec3>(m_collVertexCount);
 		reader.read(m_collVertices, m_collVertexCount);
 	}
 
 	reader >> m_collIndexCount;
 	if (m_collIndexCount)
 	{
-		m_collIndices = new uint16_t[m_collIndexCount];
+		m_collIndices = arena.alloc<uint16_t>(m_collIndexCount);
 		reader.read(m_collIndices, m_collIndexCount);
 	}
 
@@ -230,20 +229,20 @@ void Object3D::load(BinaryReader& reader, uint8_t ver)
 		>> m_skinVertexCount;
 
 	m_vertexBufferSize = sizeof(NormalObjectVertex) * m_normalVertexCount + sizeof(SkinObjectVertex) * m_skinVertexCount;
-	m_vertexBufferData = new char[m_vertexBufferSize];
+	m_vertexBufferData = arena.alloc<char>(m_vertexBufferSize);
 	reader.read(m_vertexBufferData, m_vertexBufferSize);
 
 	reader >> m_indexCount;
 	if (m_indexCount)
 	{
-		m_indices = new uint16_t[m_indexCount];
+		m_indices = arena.alloc<uint16_t>(m_indexCount);
 		reader.read(m_indices, m_indexCount);
 	}
 
 	reader >> m_textureCount;
 	if (m_textureCount)
 	{
-		m_textureNames = new char[m_textureCount * 128];
+		m_textureNames = arena.alloc<char>(m_textureCount * 128);
 
 		int bufferLen;
 		for (int i = 0; i < m_textureCount; i++)
@@ -254,12 +253,12 @@ void Object3D::load(BinaryReader& reader, uint8_t ver)
 		}
 	}
 
-	m_textures = new TexturePtr[m_textureCount * MAX_TEXTURE_EX];
+	m_textures = arena.alloc<TexturePtr>(m_textureCount * MAX_TEXTURE_EX);
 
 	reader >> m_materialBlockCount;
 	if (m_materialBlockCount)
 	{
-		m_materialBlocks = new MaterialBlock[m_materialBlockCount];
+		m_materialBlocks = arena.alloc<MaterialBlock>(m_materialBlockCount);
 		for (int i = 0; i < m_materialBlockCount; i++)
 		{
 			MaterialBlock& block = m_materialBlocks[i];
@@ -275,7 +274,7 @@ void Object3D::load(BinaryReader& reader, uint8_t ver)
 	reader >> m_geometryObjectCount;
 	if (m_geometryObjectCount)
 	{
-		m_geometryObjects = new GeometryObject[m_geometryObjectCount];
+		m_geometryObjects = arena.alloc<GeometryObject>(m_geometryObjectCount);
 		for (int i = 0; i < m_geometryObjectCount; i++)
 		{
 			GeometryObject& gm = m_geometryObjects[i];
@@ -300,10 +299,90 @@ void Object3D::load(BinaryReader& reader, uint8_t ver)
 		reader >> group.objectCount;
 	}
 
+	computeUVDensity();
+
 	if (gl::isContextActive())
 		onContextRestored();
 }
 
+void Object3D::computeUVDensity()
+{
+	int i;
+	for (i = 0; i < m_materialBlockCount; i++)
+		m_materialBlocks[i].uvDensity = 0.0f;
+
+	for (i = 0; i < m_geometryObjectCount; i++)
+	{
+		const GeometryObject& gm = m_geometryObjects[i];
+
+		// skin indices start at the first skin vertex, like the attributes of m_skinVAO
+		const bool skin = gm.type == GMT_SKIN;
+		const char* const vertices = m_vertexBufferData + (skin ? m_normalVertexCount * sizeof(NormalObjectVertex) : 0);
+		const int vertexCount = skin ? m_skinVertexCount : m_normalVertexCount;
+
+		for (int j = 0; j < gm.materialBlockCount; j++)
+		{
+			MaterialBlock& block = gm.materialBlocks[j];
+			const int first = (int)(block.indices / sizeof(uint16_t));
+			if (block.indexCount < 3 || first + block.indexCount > m_indexCount)
+				continue;
+
+			float area = 0.0f, uvArea = 0.0f;
+			vec3 p[3];
+			vec2 t[3];
+
+			for (int k = 0; k + 2 < block.indexCount; k += 3)
+			{
+				int v;
+				for (v = 0; v < 3; v++)
+				{
+					const int index = m_indices[first + k + v];
+					if (index >= vertexCount)
+						break;
+
+					if (skin)
+					{
+						const SkinObjectVertex& vertex = ((const SkinObjectVertex*)vertices)[index];
+						p[v] = vertex.p;
+						t[v] = vertex.t;
+					}
+					else
+					{
+						const NormalObjectVertex& vertex = ((const NormalObjectVertex*)vertices)[index];
+						p[v] = vertex.p;
+						t[v] = vertex.t;
+					}
+				}
+
+				if (v < 3)
+					continue;
+
+				const vec2 e1 = t[1] - t[0], e2 = t[2] - t[0];
+				area += length(cross(p[1] - p[0], p[2] - p[0]));
+				uvArea += glm::abs(e1.x * e2.y - e1.y * e2.x);
+			}
+
+			// the textures of blocks without area are streamed in full
+			if (area > 0.0f && uvArea > 0.0f)
+				block.uvDensity = sqrt(uvArea / area);
+		}
+	}
+}
+
+const CollisionBVH* Object3D::collision() const
+{
+	if (!m_hasCollObj || !m_collVertexCount || m_collIndexCount < 3)
+		return nullptr;
+
+	if (!m_collision)
+	{
+		m_collision = new CollisionBVH();
+		m_collision->build(m_collVertices, m_collVertexCount, m_collIndices, m_collIndexCount);
+	}
+
+	return m_collision->empty() ? nullptr : m_collision;
+}
+
 void Object3D::loadTextureEx(int textureEx)
 {
 	TexturePtr* const textures = &m_textures[m_textureCount * textureEx];
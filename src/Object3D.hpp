@@ -1,6 +1,9 @@
 #pragma once
 
 #include "Texture.hpp"
+#include "Arena.hpp"
+
+class CollisionBVH;
 
 #define LOD_COUNT 3
 #define MAX_TEXTURE_EX 8
@@ -12,6 +15,8 @@ struct MaterialBlock
 	uint32_t effect;
 	float alpha;
 	uint32_t indices;
+	// uv units per model unit on average over the triangles, computed on load
+	float uvDensity;
 };
 
 enum GeometryObjectType
@@ -56,7 +61,8 @@ public:
 	explicit Object3D();
 	virtual ~Object3D();
 
-	void load(BinaryReader& reader, uint8_t ver);
+	// the arrays live in the arena of the model file and go away with it
+	void load(BinaryReader& reader, uint8_t ver, Arena& arena);
 	void loadTextureEx(int textureEx);
 
 	void render(const mat4* bones, const mat4& world, int lod, int textureEx, uint32_t effect, float alpha) const;
@@ -66,10 +72,16 @@ public:
 		bbMax = m_bbMax;
 	}
 
+	// built on first use, nullptr if the object has no collision mesh
+	const CollisionBVH* collision() const;
+
 protected:
 	virtual void onContextLost();
 	virtual void onContextRestored();
 
+private:
+	void computeUVDensity();
+
 private:
 	vec3 m_bbMin, m_bbMax;
 	bool m_LOD, m_hasCollObj;
@@ -77,6 +89,7 @@ private:
 	vec3* m_collVertices;
 	int m_collIndexCount;
 	uint16_t* m_collIndices;
+	mutable CollisionBVH* m_collision;
 	int m_normalVertexCount;
 	int m_skinVertexCount;
 	int m_vertexBufferSize;
@@ -0,0 +1,95 @@
+#include "StdAfx.hpp"
+#include "Pack.hpp"
+#include "Network.hpp"
+#include "Stats.hpp"
+
+#include <unordered_map>
+
+namespace Pack
+{
+	namespace
+	{
+		// the pack buffers are never given back, entries point into them
+		vector<void*> s_packs;
+		unordered_map<uint64_t, Entry> s_entries;
+
+		bool addEntries(const uint8_t* data, uint32_t size)
+		{
+			Header header;
+			if (size < sizeof(Header))
+				return false;
+
+			memcpy(&header, data, sizeof(Header));
+			if (header.magic != PACK_MAGIC || header.version != PACK_VERSION
+				|| header.entryCount > (size - sizeof(Header)) / sizeof(IndexEntry))
+				return false;
+
+			const IndexEntry* const index = (const IndexEntry*)(data + sizeof(Header));
+
+			for (uint32_t i = 0; i < header.entryCount; i++)
+			{
+				if (index[i].offset > size || index[i].size > size - index[i].offset || index[i].storage > Compressed)
+					return false;
+			}
+
+			for (uint32_t i = 0; i < header.entryCount; i++)
+			{
+				Entry entry;
+				entry.data = data + index[i].offset;
+				entry.size = (int)index[i].size;
+				entry.storage = (Storage)index[i].storage;
+
+				// a later pack overrides the files of the previous ones
+				s_entries[index[i].key] = entry;
+			}
+
+			return true;
+		}
+
+		void onPackLoad(unsigned handle, void* arg, void* buffer, unsigned size)
+		{
+			void(*ready)(bool) = (void(*)(bool))arg;
+
+			if (!addEntries((const uint8_t*)buffer, size))
+			{
+				emscripten_log(EM_LOG_ERROR, "Invalid resource pack");
+				free(buffer);
+				ready(false);
+				return;
+			}
+
+			s_packs.push_back(buffer);
+			Stats::add(Stats::PackBytes, size);
+			ready(true);
+		}
+
+		void onPackLoadError(unsigned handle, void* arg, int status, const char* message)
+		{
+			void(*ready)(bool) = (void(*)(bool))arg;
+			ready(false);
+		}
+	}
+
+	void mount(const string& filename, void(*ready)(bool))
+	{
+		const string url = Network::resourcesPath() + filename;
+
+		// the buffer is kept, stored entries are read from it directly
+		emscripten_async_wget2_data(url.c_str(), "GET", "", (void*)ready, false, onPackLoad, onPackLoadError, nullptr);
+	}
+
+	bool contains(const string& filename)
+	{
+		return s_entries.find(keyOf(filename)) != s_entries.end();
+	}
+
+	bool find(const string& filename, Entry& entry)
+	{
+		auto it = s_entries.find(keyOf(filename));
+		if (it == s_entries.end())
+			return false;
+
+		entry = it->second;
+		return true;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#define PACK_MAGIC 0x4b415046
+#define PACK_VERSION 1
+#define PACK_ALIGNMENT 4096
+
+// resource packs: an index followed by entries aligned on 4K pages, written offline by PackTool
+// a mounted pack stays whole in memory, stored entries are read in place instead of being copied and inflated
+namespace Pack
+{
+	enum Storage
+	{
+		Stored,
+		// as served, the uncompressed size with the codec id followed by the encoded data
+		Compressed
+	};
+
+	// the file starts with the header and an index entry per file
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t reserved;
+	};
+
+	struct IndexEntry
+	{
+		uint64_t key;
+		uint32_t offset;
+		uint32_t size;
+		uint32_t storage;
+		uint32_t reserved;
+	};
+
+	struct Entry
+	{
+		const void* data;
+		int size;
+		Storage storage;
+	};
+
+	// of the path relative to the resources path
+	inline uint64_t keyOf(const string& filename)
+	{
+		uint64_t h = 0xcbf29ce484222325ull;
+		for (std::size_t i = 0; i < filename.size(); i++)
+			h = (h ^ (uint8_t)filename[i]) * 0x100000001b3ull;
+		return h;
+	}
+
+	// downloads the pack from the resources path, ready gets false when it is missing or invalid
+	void mount(const string& filename, void(*ready)(bool));
+
+	bool contains(const string& filename);
+	bool find(const string& filename, Entry& entry);
+}
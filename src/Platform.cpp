@@ -7,6 +7,17 @@ using namespace emscripten;
 
 namespace Platform
 {
+	namespace
+	{
+		void(*s_persistentReady)(bool) = nullptr;
+	}
+
+	void onPersistentDirectoryMount(bool success)
+	{
+		if (s_persistentReady)
+			s_persistentReady(success);
+	}
+
 	void removeSplash()
 	{
 		val::global("Platform").call<void>("removeSplash");
@@ -42,4 +53,38 @@ namespace Platform
 	{
 		val::global("Platform").call<void>("setCursor", filename);
 	}
+
+	void mountPersistentDirectory(const char* path, void(*ready)(bool))
+	{
+		s_persistentReady = ready;
+
+		EM_ASM({
+			var path = UTF8ToString($0);
+			try {
+				FS.mkdir(path);
+				FS.mount(IDBFS, {}, path);
+			} catch (e) {
+				Module._onPersistentDirectoryMount(0);
+				return;
+			}
+			FS.syncfs(true, function(err) {
+				Module._onPersistentDirectoryMount(err ? 0 : 1);
+			});
+		}, path);
+	}
+
+	void syncPersistentDirectory()
+	{
+		EM_ASM({
+			FS.syncfs(false, function(err) {
+				if (err)
+					console.warn('Persistent directory sync failed');
+			});
+		});
+	}
+}
+
+extern "C" EMSCRIPTEN_KEEPALIVE void onPersistentDirectoryMount(int success)
+{
+	Platform::onPersistentDirectoryMount(success != 0);
 }
\ No newline at end of file
@@ -15,4 +15,9 @@ namespace Platform
 	void playMusic(const string& filename, float offset);
 
 	void setCursor(const string& filename);
+
+	// IDBFS mounted at path, ready is called once the stored files were read back
+	void mountPersistentDirectory(const char* path, void(*ready)(bool));
+	// writes the changes of the mounted directory back to IndexedDB
+	void syncPersistentDirectory();
 }
\ No newline at end of file
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Stats.hpp"
+
+// fixed size slots carved out of slabs, a free slot keeps the next free one in its own storage
+// used as a per type free list through allocate/free, or as an arena emptied at once by clear
+template<typename T, int SlabSize = 256>
+class Pool
+{
+public:
+	Pool()
+		: m_free(nullptr),
+		m_count(0)
+	{
+	}
+
+	~Pool()
+	{
+		clear();
+	}
+
+	void* allocate()
+	{
+		if (!m_free)
+			grow();
+
+		Slot* const slot = m_free;
+		m_free = slot->next;
+		m_count++;
+		return slot;
+	}
+
+	void free(void* ptr)
+	{
+		Slot* const slot = (Slot*)ptr;
+		slot->next = m_free;
+		m_free = slot;
+		m_count--;
+	}
+
+	template<typename... Args>
+	T* create(Args... args)
+	{
+		return ::new(allocate()) T(args...);
+	}
+
+	void destroy(T* obj)
+	{
+		obj->~T();
+		free(obj);
+	}
+
+	// the objects still in the pool are not destroyed
+	void clear()
+	{
+		for (std::size_t i = 0; i < m_slabs.size(); i++)
+			delete[] m_slabs[i];
+		m_slabs.clear();
+		m_free = nullptr;
+		m_count = 0;
+	}
+
+	int size() const {
+		return m_count;
+	}
+	int slabCount() const {
+		return (int)m_slabs.size();
+	}
+
+private:
+	union Slot
+	{
+		Slot* next;
+		alignas(T) unsigned char storage[sizeof(T)];
+	};
+
+	void grow()
+	{
+		Slot* const slab = new Slot[SlabSize];
+		for (int i = 0; i < SlabSize - 1; i++)
+			slab[i].next = &slab[i + 1];
+		slab[SlabSize - 1].next = m_free;
+
+		m_free = slab;
+		m_slabs.push_back(slab);
+		Stats::add(Stats::PoolSlabAllocs);
+	}
+
+	Slot* m_free;
+	int m_count;
+	vector<Slot*> m_slabs;
+
+private:
+	Pool(const Pool&) = delete;
+	Pool& operator=(const Pool&) = delete;
+};
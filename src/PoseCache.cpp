@@ -0,0 +1,122 @@
+#include "StdAfx.hpp"
+#include "PoseCache.hpp"
+#include "Stats.hpp"
+
+#include <unordered_map>
+
+#define MAX_FREE_POSES 64
+
+namespace PoseCache
+{
+	namespace
+	{
+		struct Key
+		{
+			const Skeleton* skeleton;
+			const Motion* motion;
+			int frame;
+			int boneLod;
+
+			bool operator==(const Key& other) const {
+				return skeleton == other.skeleton && motion == other.motion && frame == other.frame && boneLod == other.boneLod;
+			}
+		};
+
+		struct KeyHash
+		{
+			std::size_t operator()(const Key& key) const {
+				std::size_t h = hash<const void*>()(key.skeleton);
+				h = h * 31 + hash<const void*>()(key.motion);
+				h = h * 31 + (std::size_t)key.frame;
+				return h * 31 + (std::size_t)key.boneLod;
+			}
+		};
+
+		unordered_map<Key, Pose*, KeyHash> s_poses;
+		vector<Pose*> s_free;
+		double s_clock = 0.0;
+	}
+
+	const Pose* acquire(Skeleton* skeleton, Motion* motion, float frame, int nextFrame, int boneLod)
+	{
+		const Key key = { skeleton, motion, (int)(frame * POSE_FRAME_STEPS), boneLod };
+
+		auto it = s_poses.find(key);
+		if (it != s_poses.end())
+		{
+			it->second->refCount++;
+			Stats::add(Stats::PoseCacheHits);
+			return it->second;
+		}
+
+		const int boneCount = skeleton->boneCount();
+		const int paletteSize = skeleton->paletteSize();
+		Pose* pose = nullptr;
+
+		for (std::size_t i = 0; i < s_free.size(); i++)
+		{
+			if (s_free[i]->boneCount == boneCount && s_free[i]->paletteSize == paletteSize)
+			{
+				pose = s_free[i];
+				s_free[i] = s_free.back();
+				s_free.pop_back();
+				break;
+			}
+		}
+
+		if (!pose)
+		{
+			pose = new Pose();
+			pose->boneCount = boneCount;
+			pose->paletteSize = paletteSize;
+			pose->bones = new mat4[boneCount];
+			pose->palette = skeleton->createPalette();
+		}
+
+		pose->skeleton = skeleton;
+		pose->motion = motion;
+		pose->frame = key.frame;
+		pose->boneLod = boneLod;
+		pose->refCount = 1;
+
+		skeleton->animate(motion, pose->bones, pose->palette, (float)key.frame / POSE_FRAME_STEPS, nextFrame, boneLod);
+		Stats::add(Stats::PoseEvaluations);
+
+		s_poses.insert(pair<Key, Pose*>(key, pose));
+		return pose;
+	}
+
+	void release(const Pose* pose)
+	{
+		pose->refCount--;
+		if (pose->refCount)
+			return;
+
+		const Key key = { pose->skeleton, pose->motion, pose->frame, pose->boneLod };
+		s_poses.erase(key);
+		s_free.push_back(const_cast<Pose*>(pose));
+	}
+
+	void collect()
+	{
+		while (s_free.size() > MAX_FREE_POSES)
+		{
+			Pose* const pose = s_free.back();
+			delete[] pose->bones;
+			if (pose->palette)
+				delete[] pose->palette;
+			delete pose;
+			s_free.pop_back();
+		}
+	}
+
+	void advance(int frameCount)
+	{
+		s_clock += 0.5 * frameCount;
+	}
+
+	double clock()
+	{
+		return s_clock;
+	}
+}
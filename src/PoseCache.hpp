@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Motion.hpp"
+
+// frames are quantised to 1 / POSE_FRAME_STEPS, meshes advance by half a frame per tick
+#define POSE_FRAME_STEPS 2
+
+namespace PoseCache
+{
+	struct Pose
+	{
+		const Skeleton* skeleton;
+		const Motion* motion;
+		int frame;
+		int boneLod;
+		mutable int refCount;
+		int boneCount;
+		int paletteSize;
+		mat4* bones;
+		vec4* palette;
+	};
+
+	// the pose is evaluated once and shared by every mesh at the same (skeleton, motion, frame, bone LOD)
+	const Pose* acquire(Skeleton* skeleton, Motion* motion, float frame, int nextFrame, int boneLod = 0);
+
+	// the pose leaves the cache with its last reference, so it can't outlive its skeleton or motion
+	void release(const Pose* pose);
+
+	// trims the recycled poses
+	void collect();
+
+	// shared animation clock in motion frames, used by phase-locked meshes
+	void advance(int frameCount);
+	double clock();
+}
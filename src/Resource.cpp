@@ -1,12 +1,10 @@
 #include "StdAfx.hpp"
 #include "Resource.hpp"
 #include "Network.hpp"
-
-#define MINIZ_NO_ARCHIVE_APIS
-#define MINIZ_NO_ARCHIVE_WRITING_APIS
-#define MINIZ_NO_ZLIB_COMPATIBLE_NAMES
-
-#include "miniz.hpp"
+#include "ResourceCache.hpp"
+#include "Pack.hpp"
+#include "Codec.hpp"
+#include "Stats.hpp"
 
 namespace
 {
@@ -17,18 +15,48 @@ void onResourceLoad(void* userArg, void* rawBuffer, int rawSize)
 {
 	Resource* const res = (Resource*)userArg;
 
-	int uncompressedDataSize = 0;
-	memcpy(&uncompressedDataSize, rawBuffer, sizeof(int));
+	if (!ResourceCache::store(res->filename(), rawBuffer, rawSize))
+		res->onDownload(rawBuffer, rawSize);
+	res->loadPayload(rawBuffer, rawSize);
+	res->release();
+}
 
-	mz_ulong len = (mz_ulong)uncompressedDataSize;
-	char* uncompressData = new char[len];
-	mz_uncompress((unsigned char*)uncompressData, &len, ((const unsigned char*)rawBuffer) + sizeof(int), (mz_ulong)rawSize);
+void onResourceCacheLoad(void* userArg)
+{
+	Resource* const res = (Resource*)userArg;
 
-	res->onLoad(BinaryReader(uncompressData, uncompressedDataSize));
+	vector<uint8_t> payload;
+	if (!ResourceCache::read(res->filename(), payload))
+	{
+		res->download();
+		return;
+	}
 
-	delete[] uncompressData;
+	res->loadPayload(payload.data(), (int)payload.size());
+	res->release();
+}
+
+void onResourcePackLoad(void* userArg)
+{
+	Resource* const res = (Resource*)userArg;
+
+	Pack::Entry entry;
+	if (!Pack::find(res->filename(), entry))
+	{
+		res->download();
+		return;
+	}
+
+	// nothing to keep for a context loss either, the pack is still there for the next load
+	if (entry.storage == Pack::Stored)
+	{
+		Stats::add(Stats::PackReadsInPlace);
+		res->onLoad(BinaryReader(entry.data, entry.size));
+		res->m_loadState = Resource::Loaded;
+	}
+	else
+		res->loadPayload(entry.data, entry.size);
 
-	res->m_loadState = Resource::Loaded;
 	res->release();
 }
 
@@ -36,7 +64,7 @@ void onResourceLoadError(void* userArg)
 {
 	Resource* const res = (Resource*)userArg;
 	emscripten_log(EM_LOG_ERROR, "Failed to load resource '%s'", res->filename().c_str());
-	res->m_loadState = Resource::NotLoaded;
+	res->m_loadState = Resource::Failed;
 	res->release();
 }
 
@@ -60,10 +88,22 @@ void Resource::startLoad()
 
 	m_loadState = Loading;
 
-	const string url = Network::resourcesPath() + m_filename;
-
 	addRef();
 
+	// still completes asynchronously, onLoad never runs from inside startLoad
+	if (Pack::contains(m_filename))
+		emscripten_async_call(onResourcePackLoad, this, 0);
+	else if (ResourceCache::contains(m_filename))
+		emscripten_async_call(onResourceCacheLoad, this, 0);
+	else
+		download();
+}
+
+void Resource::download()
+{
+	const string url = Network::resourcesPath() + m_filename;
+	Stats::add(Stats::ResourceRequests);
+
 	emscripten_async_wget_data(
 		url.c_str(),
 		this,
@@ -72,6 +112,38 @@ void Resource::startLoad()
 	);
 }
 
+void Resource::loadPayload(const void* data, int size)
+{
+	const int uncompressedDataSize = Codec::payloadSize(data, size);
+	if (uncompressedDataSize < 0)
+	{
+		emscripten_log(EM_LOG_ERROR, "Invalid payload for resource '%s'", m_filename.c_str());
+		m_loadState = Failed;
+		return;
+	}
+
+	char* uncompressData = new char[uncompressedDataSize];
+	bool decoded;
+	{
+		Stats::Timer timer(Stats::ResourceInflateTime);
+		decoded = Codec::decodePayload(data, size, uncompressData, uncompressedDataSize);
+	}
+
+	if (!decoded)
+	{
+		emscripten_log(EM_LOG_ERROR, "Invalid payload for resource '%s'", m_filename.c_str());
+		delete[] uncompressData;
+		m_loadState = Failed;
+		return;
+	}
+
+	onLoad(BinaryReader(uncompressData, uncompressedDataSize));
+
+	delete[] uncompressData;
+
+	m_loadState = Loaded;
+}
+
 void Resource::setFilename(const string& newFilename)
 {
 	m_filename = newFilename;
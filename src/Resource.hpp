@@ -10,7 +10,8 @@ public:
 	{
 		NotLoaded,
 		Loading,
-		Loaded
+		Loaded,
+		Failed
 	};
 
 public:
@@ -37,6 +38,18 @@ public:
 
 protected:
 	virtual void onLoad(BinaryReader reader) = 0;
+	// the compressed payload as downloaded, before it is decompressed for onLoad
+	// only called when ResourceCache doesn't keep it, loading it again would mean another download
+	virtual void onDownload(const void* data, int size) {}
+
+	// decompresses a payload as sent by the server and hands it to onLoad
+	void loadPayload(const void* data, int size);
+	void setLoadState(LoadState state) {
+		m_loadState = state;
+	}
+
+private:
+	void download();
 
 private:
 	const uint32_t m_uniqueId;
@@ -46,4 +59,6 @@ private:
 private:
 	friend void onResourceLoad(void*, void*, int);
 	friend void onResourceLoadError(void*);
+	friend void onResourceCacheLoad(void*);
+	friend void onResourcePackLoad(void*);
 };
\ No newline at end of file
@@ -0,0 +1,346 @@
+#include "StdAfx.hpp"
+#include "ResourceCache.hpp"
+#include "ResourceManifest.hpp"
+#include "Network.hpp"
+#include "Platform.hpp"
+#include "Config.hpp"
+#include "Stats.hpp"
+
+#include <cstdio>
+#include <list>
+#include <unordered_map>
+
+#define CACHE_DIR "/cache"
+#define CACHE_INDEX CACHE_DIR "/index.bin"
+#define CACHE_INDEX_MAGIC 0x32435246
+// pending payloads above it are not kept for writing
+#define MAX_PENDING_BYTES (32 * 1024 * 1024)
+#define SYNC_DELAY 5000.0
+
+namespace ResourceCache
+{
+	namespace
+	{
+		struct Entry
+		{
+			uint64_t key;
+			uint32_t size;
+			uint32_t hash;
+		};
+
+		struct PendingWrite
+		{
+			uint64_t key;
+			uint32_t hash;
+			vector<uint8_t> payload;
+		};
+
+		bool s_mounted = false;
+		bool s_manifestLoaded = false;
+		bool s_enabled = false;
+
+		// payload hash of each resource of this deploy
+		unordered_map<uint64_t, uint32_t> s_manifest;
+
+		// most recently used first, the index file keeps that order
+		list<Entry> s_entries;
+		unordered_map<uint64_t, list<Entry>::iterator> s_index;
+		std::size_t s_size = 0;
+
+		vector<PendingWrite> s_pending;
+		std::size_t s_pendingSize = 0;
+		bool s_dirty = false;
+		double s_lastSync = 0.0;
+
+		string pathOf(uint64_t key)
+		{
+			char buffer[64];
+			sprintf(buffer, CACHE_DIR "/%016llx.bin", (unsigned long long)key);
+			return buffer;
+		}
+
+		// hash of the resource in this deploy, false when the manifest doesn't list it
+		bool manifestHash(uint64_t key, uint32_t& hash)
+		{
+			auto it = s_manifest.find(key);
+			if (it == s_manifest.end())
+				return false;
+
+			hash = it->second;
+			return true;
+		}
+
+		void remove(uint64_t key)
+		{
+			auto it = s_index.find(key);
+			if (it == s_index.end())
+				return;
+
+			s_size -= it->second->size;
+			Stats::add(Stats::ResourceCacheBytes, -(double)it->second->size);
+			s_entries.erase(it->second);
+			s_index.erase(it);
+
+			::remove(pathOf(key).c_str());
+			s_dirty = true;
+		}
+
+		void evict(std::size_t maxSize)
+		{
+			while (s_size > maxSize && !s_entries.empty())
+				remove(s_entries.back().key);
+		}
+
+		void loadIndex()
+		{
+			FILE* const file = fopen(CACHE_INDEX, "rb");
+			if (!file)
+				return;
+
+			uint32_t magic = 0, count = 0;
+			if (fread(&magic, 4, 1, file) == 1 && magic == CACHE_INDEX_MAGIC
+				&& fread(&count, 4, 1, file) == 1)
+			{
+				Entry entry;
+
+				for (uint32_t i = 0; i < count; i++)
+				{
+					if (fread(&entry, sizeof(Entry), 1, file) != 1)
+						break;
+
+					if (s_index.find(entry.key) != s_index.end())
+						continue;
+
+					s_entries.push_back(entry);
+					s_index[entry.key] = --s_entries.end();
+					s_size += entry.size;
+				}
+			}
+
+			fclose(file);
+			Stats::add(Stats::ResourceCacheBytes, (double)s_size);
+		}
+
+		void saveIndex()
+		{
+			FILE* const file = fopen(CACHE_INDEX, "wb");
+			if (!file)
+				return;
+
+			const uint32_t magic = CACHE_INDEX_MAGIC;
+			const uint32_t count = (uint32_t)s_entries.size();
+			fwrite(&magic, 4, 1, file);
+			fwrite(&count, 4, 1, file);
+
+			for (auto it = s_entries.begin(); it != s_entries.end(); it++)
+				fwrite(&*it, sizeof(Entry), 1, file);
+
+			fclose(file);
+		}
+
+		bool write(const PendingWrite& pending)
+		{
+			const std::size_t maxSize = (std::size_t)Config::resourceCacheSize * 1024 * 1024;
+			if (pending.payload.size() > maxSize)
+				return false;
+
+			remove(pending.key);
+			evict(maxSize - pending.payload.size());
+
+			FILE* const file = fopen(pathOf(pending.key).c_str(), "wb");
+			if (!file)
+				return false;
+
+			const bool written = fwrite(pending.payload.data(), 1, pending.payload.size(), file) == pending.payload.size();
+			fclose(file);
+
+			if (!written)
+			{
+				::remove(pathOf(pending.key).c_str());
+				return false;
+			}
+
+			Entry entry;
+			entry.key = pending.key;
+			entry.size = (uint32_t)pending.payload.size();
+			entry.hash = pending.hash;
+			s_entries.push_front(entry);
+			s_index[entry.key] = s_entries.begin();
+
+			s_size += entry.size;
+			Stats::add(Stats::ResourceCacheBytes, entry.size);
+			s_dirty = true;
+			return true;
+		}
+
+		void enable()
+		{
+			s_enabled = s_mounted && s_manifestLoaded;
+		}
+
+		void onMount(bool success)
+		{
+			s_mounted = success;
+
+			if (success)
+				loadIndex();
+			else
+				emscripten_log(EM_LOG_WARN, "Resource cache unavailable, every resource is downloaded");
+
+			enable();
+		}
+
+		void onManifestLoad(void* arg, void* buffer, int size)
+		{
+			const uint8_t* const data = (const uint8_t*)buffer;
+			uint32_t magic = 0, count = 0;
+
+			if (size >= (int)sizeof(uint32_t) * 2)
+			{
+				memcpy(&magic, data, sizeof(uint32_t));
+				memcpy(&count, data + sizeof(uint32_t), sizeof(uint32_t));
+			}
+
+			if (magic != RESOURCE_MANIFEST_MAGIC || count > (size - sizeof(uint32_t) * 2) / sizeof(ResourceManifest::Entry))
+			{
+				emscripten_log(EM_LOG_ERROR, "Invalid resource manifest, the resource cache is not used");
+				return;
+			}
+
+			ResourceManifest::Entry entry;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				memcpy(&entry, data + sizeof(uint32_t) * 2 + sizeof(entry) * i, sizeof(entry));
+				s_manifest[entry.key] = entry.hash;
+			}
+
+			s_manifestLoaded = true;
+			enable();
+		}
+
+		void onManifestLoadError(void* arg)
+		{
+			emscripten_log(EM_LOG_WARN, "No resource manifest, the resource cache is not used");
+		}
+	}
+
+	void initialize()
+	{
+		Platform::mountPersistentDirectory(CACHE_DIR, onMount);
+
+		const string url = Network::resourcesPath() + RESOURCE_MANIFEST;
+		emscripten_async_wget_data(url.c_str(), nullptr, onManifestLoad, onManifestLoadError);
+	}
+
+	bool contains(const string& filename)
+	{
+		if (!s_enabled)
+			return false;
+
+		const uint64_t key = ResourceManifest::keyOf(filename);
+		uint32_t hash;
+		if (!manifestHash(key, hash))
+			return false;
+
+		auto it = s_index.find(key);
+		if (it != s_index.end() && it->second->hash == hash)
+			return true;
+
+		Stats::add(Stats::ResourceCacheMisses);
+		return false;
+	}
+
+	bool read(const string& filename, vector<uint8_t>& payload)
+	{
+		if (!s_enabled)
+			return false;
+
+		const uint64_t key = ResourceManifest::keyOf(filename);
+		uint32_t hash;
+		auto it = s_index.find(key);
+		if (it == s_index.end() || !manifestHash(key, hash))
+			return false;
+
+		const Entry& entry = *it->second;
+		payload.resize(entry.size);
+
+		FILE* const file = fopen(pathOf(key).c_str(), "rb");
+		bool valid = false;
+		if (file)
+		{
+			valid = fread(payload.data(), 1, payload.size(), file) == payload.size()
+				&& fgetc(file) == EOF
+				&& entry.hash == hash
+				&& ResourceManifest::hashOf(payload.data(), payload.size()) == hash;
+			fclose(file);
+		}
+
+		if (!valid)
+		{
+			emscripten_log(EM_LOG_WARN, "Dropping invalid cache entry for '%s'", filename.c_str());
+			Stats::add(Stats::ResourceCacheInvalid);
+			remove(key);
+			payload.clear();
+			return false;
+		}
+
+		s_entries.splice(s_entries.begin(), s_entries, it->second);
+		s_dirty = true;
+
+		Stats::add(Stats::ResourceCacheHits);
+		return true;
+	}
+
+	bool store(const string& filename, const void* data, int size)
+	{
+		if (!s_enabled || s_pendingSize + size > MAX_PENDING_BYTES)
+			return false;
+
+		// only the payload the manifest lists for this deploy, not one a stale proxy served
+		const uint64_t key = ResourceManifest::keyOf(filename);
+		uint32_t hash;
+		if (!manifestHash(key, hash) || ResourceManifest::hashOf(data, size) != hash)
+			return false;
+
+		s_pending.push_back(PendingWrite());
+		PendingWrite& pending = s_pending.back();
+		pending.key = key;
+		pending.hash = hash;
+		pending.payload.assign((const uint8_t*)data, (const uint8_t*)data + size);
+		s_pendingSize += size;
+		return true;
+	}
+
+	void update(double budget)
+	{
+		if (!s_enabled)
+			return;
+
+		const double start = emscripten_get_now();
+
+		if (!s_pending.empty() && budget > 0.0)
+		{
+			Stats::Timer timer(Stats::ResourceCacheWriteTime);
+
+			// oldest downloads first, at least one entry per idle frame
+			std::size_t written = 0;
+			do
+			{
+				write(s_pending[written]);
+				s_pendingSize -= s_pending[written].payload.size();
+				written++;
+			} while (written < s_pending.size() && emscripten_get_now() - start < budget);
+
+			s_pending.erase(s_pending.begin(), s_pending.begin() + written);
+		}
+
+		if (s_dirty && s_pending.empty() && start - s_lastSync > SYNC_DELAY)
+		{
+			saveIndex();
+			Platform::syncPersistentDirectory();
+
+			s_dirty = false;
+			s_lastSync = start;
+		}
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+// downloaded resource payloads persisted across sessions in an IDBFS directory
+// an entry is used while its hash matches the one of the resource manifest, the least recently used ones are evicted
+namespace ResourceCache
+{
+	// mounts the directory and downloads the manifest without waiting, resources are downloaded until both are ready
+	void initialize();
+
+	// false on a miss, when the entry is missing or outdated
+	bool contains(const string& filename);
+	// false when the entry is missing or does not match its size and content hash, it is dropped then
+	bool read(const string& filename, vector<uint8_t>& payload);
+	// copies the payload, it is written during idle frames
+	// false when it is not kept, with the cache unavailable or too many writes pending
+	bool store(const string& filename, const void* data, int size);
+
+	// writes pending entries until budget milliseconds are spent and syncs the directory when idle
+	void update(double budget);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+// hash of every served resource payload, written next to the resources by ResourceManifestTool at each deploy
+// ResourceCache only keeps the resources listed there and drops an entry once its hash changes
+#define RESOURCE_MANIFEST "resources.manifest"
+#define RESOURCE_MANIFEST_MAGIC 0x4e414d52
+
+namespace ResourceManifest
+{
+	// the file is the magic and entry count followed by the entries
+	struct Entry
+	{
+		uint64_t key;
+		uint32_t hash;
+		uint32_t size;
+	};
+
+	// of the path relative to the resources path
+	inline uint64_t keyOf(const string& filename)
+	{
+		uint64_t h = 0xcbf29ce484222325ull;
+		for (std::size_t i = 0; i < filename.size(); i++)
+			h = (h ^ (uint8_t)filename[i]) * 0x100000001b3ull;
+		return h;
+	}
+
+	// of the payload as served
+	inline uint32_t hashOf(const void* data, std::size_t size)
+	{
+		const uint8_t* const bytes = (const uint8_t*)data;
+		uint32_t h = 0x811c9dc5u;
+		for (std::size_t i = 0; i < size; i++)
+			h = (h ^ bytes[i]) * 0x01000193u;
+		return h;
+	}
+}
@@ -1,6 +1,12 @@
 #include "StdAfx.hpp"
 #include "Sfx.hpp"
 #include "World.hpp"
+#include "Pool.hpp"
+
+namespace
+{
+	Pool<Sfx> s_sfxPool;
+}
 
 Sfx* Sfx::create(World* world, int sfxId, const vec3& pos)
 {
@@ -24,6 +30,21 @@ Sfx* Sfx::create(World* world, int sfxId, const vec3& pos)
 	return sfx;
 }
 
+void* Sfx::operator new(std::size_t size)
+{
+	if (size != sizeof(Sfx))
+		return ::operator new(size);
+	return s_sfxPool.allocate();
+}
+
+void Sfx::operator delete(void* ptr, std::size_t size)
+{
+	if (size != sizeof(Sfx))
+		::operator delete(ptr);
+	else
+		s_sfxPool.free(ptr);
+}
+
 Sfx::Sfx()
 	: Object(OT_SFX),
 	m_playCount(0),
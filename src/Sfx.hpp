@@ -16,4 +16,8 @@ private:
 
 public:
 	static Sfx* create(World* world, int sfxId, const vec3& pos);
+
+	// spawned and killed with every effect, the slots are recycled
+	static void* operator new(std::size_t size);
+	static void operator delete(void* ptr, std::size_t size);
 };
\ No newline at end of file
@@ -0,0 +1,265 @@
+#include "StdAfx.hpp"
+#include "SfxAtlas.hpp"
+#include "BinaryReader.hpp"
+
+#include <cctype>
+
+// largest side of an atlas, the frames are left apart above it
+#define MAX_ATLAS_SIZE 2048
+
+namespace SfxAtlas
+{
+	namespace
+	{
+		// Texture::Format, the formats from DXT1 on are stored in 4x4 blocks
+		const uint8_t FORMAT_DXT1 = 3;
+
+		struct Level
+		{
+			ivec2 size;
+			int dataSize;
+			const uint8_t* data;
+		};
+
+		struct Frame
+		{
+			uint8_t ver;
+			uint8_t format;
+			vector<Level> levels;
+		};
+
+		// the layout Texture::onLoad reads
+		bool parse(const vector<uint8_t>& file, Frame& frame)
+		{
+			const int headerSize = sizeof(uint8_t) * 3;
+			if ((int)file.size() < headerSize)
+				return false;
+
+			BinaryReader reader(file.data(), (int)file.size());
+			reader >> frame.ver
+				>> frame.format;
+
+			frame.levels.resize(reader.read<uint8_t>());
+
+			for (std::size_t i = 0; i < frame.levels.size(); i++)
+			{
+				Level& level = frame.levels[i];
+
+				if (reader.size() - reader.tell() < (int)sizeof(int) * 3)
+					return false;
+
+				reader >> level.size.x
+					>> level.size.y
+					>> level.dataSize;
+
+				if (level.size.x <= 0 || level.size.y <= 0
+					|| level.dataSize < 0 || level.dataSize > reader.size() - reader.tell())
+					return false;
+
+				level.data = (const uint8_t*)reader.data() + reader.tell();
+				reader.skip(level.dataSize);
+			}
+
+			return !frame.levels.empty();
+		}
+
+		template<typename T>
+		void append(vector<uint8_t>& out, const T& value)
+		{
+			const uint8_t* const bytes = (const uint8_t*)&value;
+			out.insert(out.end(), bytes, bytes + sizeof(T));
+		}
+	}
+
+	ivec2 grid(int frameCount)
+	{
+		int columns = 1;
+		while (columns * columns < frameCount)
+			columns *= 2;
+
+		int rows = 1;
+		while (columns * rows < frameCount)
+			rows *= 2;
+
+		return ivec2(columns, rows);
+	}
+
+	void frameNames(const char* textureName, int frameCount, vector<string>& names)
+	{
+		int numDigits = 0;
+		int strIndex = strlen(textureName) - 1;
+
+		while (isdigit(textureName[strIndex]))
+		{
+			numDigits++;
+			if (!strIndex)
+				break;
+			strIndex--;
+		}
+
+		const int nameLen = strlen(textureName) - numDigits;
+		char name[128];
+		strncpy(name, textureName, nameLen);
+		name[nameLen] = '\0';
+
+		char frameName[160];
+		names.resize(frameCount);
+
+		if (numDigits == 1)
+		{
+			for (int i = 0; i < frameCount; i++)
+			{
+				sprintf(frameName, "%s%d", name, i + 1);
+				names[i] = frameName;
+			}
+		}
+		else
+		{
+			const int numStart = stol(textureName + nameLen);
+
+			for (int i = 0; i < frameCount; i++)
+			{
+				sprintf(frameName, "%s%02d", name, numStart + i);
+				names[i] = frameName;
+			}
+		}
+	}
+
+	string atlasName(const char* textureName, int frameCount)
+	{
+		return string(textureName) + "_atlas" + to_string(frameCount);
+	}
+
+	bool build(const vector<vector<uint8_t>>& files, vector<uint8_t>& out)
+	{
+		const int frameCount = (int)files.size();
+		if (frameCount == 0)
+			return false;
+
+		vector<Frame> frames(frameCount);
+		int i;
+
+		for (i = 0; i < frameCount; i++)
+		{
+			if (!parse(files[i], frames[i]))
+			{
+				emscripten_log(EM_LOG_ERROR, "Invalid texture for frame %d", i);
+				return false;
+			}
+		}
+
+		const Frame& first = frames[0];
+		const int frameLevelCount = (int)first.levels.size();
+
+		for (i = 1; i < frameCount; i++)
+		{
+			bool same = frames[i].format == first.format && (int)frames[i].levels.size() == frameLevelCount;
+			for (int level = 0; same && level < frameLevelCount; level++)
+			{
+				same = frames[i].levels[level].size == first.levels[level].size
+					&& frames[i].levels[level].dataSize == first.levels[level].dataSize;
+			}
+
+			if (!same)
+			{
+				emscripten_log(EM_LOG_ERROR, "Frame %d doesn't have the format and size of the first one", i);
+				return false;
+			}
+		}
+
+		const int unit = first.format >= FORMAT_DXT1 ? 4 : 1;
+		const ivec2 frameSize = first.levels[0].size;
+		const int frameUnits = (frameSize.x / unit) * (frameSize.y / unit);
+
+		if (frameSize.x % unit || frameSize.y % unit || frameUnits == 0 || first.levels[0].dataSize % frameUnits)
+		{
+			emscripten_log(EM_LOG_ERROR, "Frames of %dx%d can't be packed", frameSize.x, frameSize.y);
+			return false;
+		}
+
+		// bytes per block or texel
+		const int unitSize = first.levels[0].dataSize / frameUnits;
+		const ivec2 cells = grid(frameCount);
+		const ivec2 atlasSize = frameSize * cells;
+
+		if (atlasSize.x > MAX_ATLAS_SIZE || atlasSize.y > MAX_ATLAS_SIZE)
+		{
+			emscripten_log(EM_LOG_ERROR, "Atlas of %d frames of %dx%d is too large", frameCount, frameSize.x, frameSize.y);
+			return false;
+		}
+
+		// a complete mip chain goes on down to the 1x1 level of the atlas
+		int levelCount = frameLevelCount;
+		if (first.levels.back().size == ivec2(1))
+		{
+			levelCount = 1;
+			for (ivec2 size = atlasSize; size.x > 1 || size.y > 1; size = max(size / 2, ivec2(1)))
+				levelCount++;
+		}
+
+		out.clear();
+		append(out, first.ver);
+		append(out, first.format);
+		append(out, (uint8_t)levelCount);
+
+		vector<uint8_t> data, whole;
+		ivec2 wholeUnits(0);
+		int wholeLevel = 0;
+
+		for (int level = 0; level < levelCount; level++)
+		{
+			const ivec2 size(glm::max(atlasSize.x >> level, 1), glm::max(atlasSize.y >> level, 1));
+			const ivec2 units((size.x + unit - 1) / unit, (size.y + unit - 1) / unit);
+			data.assign((std::size_t)units.x * units.y * unitSize, 0);
+
+			const bool packed = level < frameLevelCount
+				&& first.levels[level].size * cells == size
+				&& first.levels[level].size.x % unit == 0
+				&& first.levels[level].size.y % unit == 0;
+
+			if (packed)
+			{
+				const ivec2 cellUnits = first.levels[level].size / unit;
+				const int rowSize = cellUnits.x * unitSize;
+
+				for (i = 0; i < frameCount; i++)
+				{
+					const ivec2 cell(i % cells.x, i / cells.x);
+					const uint8_t* const src = frames[i].levels[level].data;
+
+					for (int y = 0; y < cellUnits.y; y++)
+					{
+						const int dst = ((cell.y * cellUnits.y + y) * units.x + cell.x * cellUnits.x) * unitSize;
+						memcpy(&data[dst], src + y * rowSize, rowSize);
+					}
+				}
+
+				whole = data;
+				wholeUnits = units;
+				wholeLevel = level;
+			}
+			else
+			{
+				// nearest block of the last whole level, a frame doesn't fill a block anymore
+				const int shift = level - wholeLevel;
+
+				for (int y = 0; y < units.y; y++)
+				{
+					for (int x = 0; x < units.x; x++)
+					{
+						const int srcX = glm::min(x << shift, wholeUnits.x - 1);
+						const int srcY = glm::min(y << shift, wholeUnits.y - 1);
+						memcpy(&data[(y * units.x + x) * unitSize], &whole[(srcY * wholeUnits.x + srcX) * unitSize], unitSize);
+					}
+				}
+			}
+
+			append(out, size.x);
+			append(out, size.y);
+			append(out, (int)data.size());
+			out.insert(out.end(), data.begin(), data.end());
+		}
+
+		return true;
+	}
+}
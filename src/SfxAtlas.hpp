@@ -0,0 +1,17 @@
+#pragma once
+
+// flipbook atlases of the animated sfx textures, made offline by SfxAtlasTool from the frame textures
+// the frames are laid out row by row, row 0 at v = 0, on a power of two grid so the atlas can keep its mips
+namespace SfxAtlas
+{
+	// columns and rows for frameCount frames
+	ivec2 grid(int frameCount);
+
+	// the texture of each frame, numbered on from the first frame the sfx part names
+	void frameNames(const char* textureName, int frameCount, vector<string>& names);
+	string atlasName(const char* textureName, int frameCount);
+
+	// packs decoded frame textures of the same format, size and mip count into one texture
+	// DXT frames are copied block by block, the mips where a frame is under a block are sampled from the last whole one
+	bool build(const vector<vector<uint8_t>>& frames, vector<uint8_t>& out);
+}
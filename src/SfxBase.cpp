@@ -5,17 +5,24 @@
 #include "GeometryUtils.hpp"
 #include "TextureManager.hpp"
 #include "Shaders.hpp"
+#include "Stats.hpp"
+#include "SfxBatcher.hpp"
+#include "SfxAtlas.hpp"
+#include "Config.hpp"
 
 #define MAX_POINTS_SFX_CUSTOMMESH 180
 
 SfxPart::SfxPart()
 	: m_keys(nullptr),
+	m_keyDeltas(nullptr),
 	m_keyCount(0),
 	m_texFrame(1),
 	m_texLoop(1),
 	m_billType(SfxPartBillType::Bill),
 	m_alphaType(SfxPartAlphaType::Blend),
 	m_textureName(""),
+	m_atlasColumns(1),
+	m_atlasRows(1),
 	m_textures(nullptr),
 	m_hasTexture(false)
 {
@@ -25,6 +32,8 @@ SfxPart::~SfxPart()
 {
 	if (m_keys)
 		delete[] m_keys;
+	if (m_keyDeltas)
+		delete[] m_keyDeltas;
 	if (m_textures)
 		delete[] m_textures;
 }
@@ -55,6 +64,24 @@ void SfxPart::load(BinaryReader& reader, uint8_t ver)
 			>> key.frame;
 	}
 
+	if (m_keyCount > 1)
+	{
+		m_keyDeltas = new SfxKeyFrame[m_keyCount - 1];
+		for (int i = 0; i < m_keyCount - 1; i++)
+		{
+			const SfxKeyFrame& key = m_keys[i];
+			const SfxKeyFrame& next = m_keys[i + 1];
+			SfxKeyFrame& delta = m_keyDeltas[i];
+
+			delta.pos = next.pos - key.pos;
+			delta.posRotate = next.posRotate - key.posRotate;
+			delta.rotate = next.rotate - key.rotate;
+			delta.scale = next.scale - key.scale;
+			delta.alpha = next.alpha - key.alpha;
+			delta.frame = next.frame - key.frame;
+		}
+	}
+
 	setTexture();
 }
 
@@ -65,6 +92,7 @@ void SfxPart::setTexture()
 		delete[] m_textures;
 		m_textures = nullptr;
 	}
+	m_atlas = nullptr;
 
 	if (strlen(m_textureName) == 0)
 	{
@@ -76,72 +104,114 @@ void SfxPart::setTexture()
 
 	if (m_texFrame > 1)
 	{
-		int numDigits = 0;
-		int strIndex = strlen(m_textureName) - 1;
+		const string atlasName = SfxAtlas::atlasName(m_textureName, m_texFrame);
 
-		while (isdigit(m_textureName[strIndex]))
+		// custom meshes repeat their texture along the strip, which an atlas cannot do
+		// without a pack listing it, the atlas is only requested when the deploy says it has them
+		if (type() != SfxPartType::CustomMesh && (Config::sfxAtlas || TextureManager::packedSfxTexture(atlasName)))
 		{
-			numDigits++;
-			if (!strIndex)
-				break;
-			strIndex--;
+			const ivec2 grid = SfxAtlas::grid(m_texFrame);
+			m_atlasColumns = grid.x;
+			m_atlasRows = grid.y;
+			m_atlas = TextureManager::getSfxTexture(atlasName);
 		}
+		else
+			loadFrameTextures();
+	}
+	else
+		m_texture = TextureManager::getSfxTexture(m_textureName);
+}
 
-		const int nameLen = strlen(m_textureName) - numDigits;
-		char name[128];
-		strncpy(name, m_textureName, nameLen);
-		name[nameLen] = '\0';
+void SfxPart::loadFrameTextures() const
+{
+	vector<string> names;
+	SfxAtlas::frameNames(m_textureName, m_texFrame, names);
 
-		char textureName[128];
-		m_textures = new TexturePtr[m_texFrame];
+	m_textures = new TexturePtr[m_texFrame];
+	for (int i = 0; i < (int)m_texFrame; i++)
+		m_textures[i] = TextureManager::getSfxTexture(names[i]);
+}
 
-		if (numDigits == 1)
+const Texture* SfxPart::frameTexture(int texFrame, vec4& rect) const
+{
+	rect = vec4(0.0f, 0.0f, 1.0f, 1.0f);
+
+	if (!m_hasTexture)
+		return nullptr;
+
+	if (m_texFrame <= 1)
+		return m_texture.get();
+
+	if (m_atlas)
+	{
+		if (m_atlas->loadState() != Resource::Failed)
 		{
-			for (int i = 0; i < (int)m_texFrame; i++)
-			{
-				sprintf(textureName, "%s%d", name, i + 1);
-				m_textures[i] = TextureManager::getSfxTexture(textureName);
-			}
+			rect = vec4((float)(texFrame % m_atlasColumns) / m_atlasColumns,
+				(float)(texFrame / m_atlasColumns) / m_atlasRows,
+				1.0f / m_atlasColumns,
+				1.0f / m_atlasRows);
+			return m_atlas.get();
 		}
-		else
-		{
-			const int numStart = stol(m_textureName + nameLen);
 
-			for (int i = 0; i < (int)m_texFrame; i++)
-			{
-				sprintf(textureName, "%s%02d", name, numStart + i);
-				m_textures[i] = TextureManager::getSfxTexture(textureName);
-			}
-		}
+		// the packed atlas failed to load
+		if (!m_textures)
+			loadFrameTextures();
 	}
-	else
-		m_texture = TextureManager::getSfxTexture(m_textureName);
+
+	return m_textures[texFrame].get();
+}
+
+int SfxPart::findKey(int frame) const
+{
+	return SfxKeys::find(m_keys, m_keyCount, frame);
+}
+
+int SfxPart::findKey(int frame, int& cursor) const
+{
+	return SfxKeys::find(m_keys, m_keyCount, frame, cursor);
 }
 
 const SfxKeyFrame* SfxPart::getKey(int frame) const
 {
-	for (int i = 0; i < m_keyCount; i++)
-		if (m_keys[i].frame == frame)
-			return &m_keys[i];
+	const SfxKeyFrame* const key = lower_bound(m_keys, m_keys + m_keyCount, frame,
+		[](const SfxKeyFrame& k, int f) { return k.frame < f; });
+
+	if (key != m_keys + m_keyCount && key->frame == frame)
+		return key;
 	return nullptr;
 }
 
 const bool SfxPart::getKey(int frame, SfxKeyFrame& key) const
 {
-	const SfxKeyFrame* prevKey = getPrevKey(frame);
-	const SfxKeyFrame* nextKey = getNextKey(frame);
-	if (!prevKey || !nextKey)
+	int cursor = -1;
+	return getKey(frame, key, cursor);
+}
+
+const bool SfxPart::getKey(int frame, SfxKeyFrame& key, int& cursor) const
+{
+	const int prev = findKey(frame, cursor);
+	if (prev < 0)
 		return false;
 
-	const int deltaFrame = nextKey->frame - prevKey->frame;
-	key = *prevKey;
+	const SfxKeyFrame& prevKey = m_keys[prev];
+	key = prevKey;
+
+	if (prevKey.frame == frame)
+		return true;
+
+	// past the last key
+	if (prev + 1 >= m_keyCount)
+		return false;
+
+	const SfxKeyFrame& delta = m_keyDeltas[prev];
+	const int deltaFrame = delta.frame;
 	if (deltaFrame != 0)
 	{
-		key.pos += (nextKey->pos - prevKey->pos) * (float)((frame - prevKey->frame)) / (float)(deltaFrame);
-		key.posRotate += (nextKey->posRotate - prevKey->posRotate) * (float)((frame - prevKey->frame)) / (float)(deltaFrame);
-		key.rotate += (nextKey->rotate - prevKey->rotate) * (float)((frame - prevKey->frame)) / (float)(deltaFrame);
-		key.scale += (nextKey->scale - prevKey->scale) * (float)((frame - prevKey->frame)) / (float)(deltaFrame);
-		key.alpha += (nextKey->alpha - prevKey->alpha) * (frame - prevKey->frame) / deltaFrame;
+		key.pos += delta.pos * (float)((frame - prevKey.frame)) / (float)(deltaFrame);
+		key.posRotate += delta.posRotate * (float)((frame - prevKey.frame)) / (float)(deltaFrame);
+		key.rotate += delta.rotate * (float)((frame - prevKey.frame)) / (float)(deltaFrame);
+		key.scale += delta.scale * (float)((frame - prevKey.frame)) / (float)(deltaFrame);
+		key.alpha += delta.alpha * (frame - prevKey.frame) / deltaFrame;
 		key.frame = deltaFrame;
 	}
 
@@ -164,71 +234,51 @@ const SfxKeyFrame* SfxPart::getLastKey() const
 
 const SfxKeyFrame* SfxPart::getPrevKey(int frame) const
 {
-	const SfxKeyFrame* key = nullptr;
-	for (int i = 0; i < m_keyCount; i++)
-	{
-		if (m_keys[i].frame > frame)
-			break;
-		key = &m_keys[i];
-	}
-	return key;
+	const int i = findKey(frame);
+	return i >= 0 ? &m_keys[i] : nullptr;
 }
 
 const SfxKeyFrame* SfxPart::getNextKey(int frame, bool skip) const
 {
-	const SfxKeyFrame* key = nullptr;
+	const SfxKeyFrame* key;
 	if (skip)
-	{
-		for (int i = 0; i < m_keyCount; i++)
-		{
-			if (m_keys[i].frame >= frame)
-			{
-				key = &m_keys[i];
-				break;
-			}
-		}
-	}
+		key = lower_bound(m_keys, m_keys + m_keyCount, frame, [](const SfxKeyFrame& k, int f) { return k.frame < f; });
 	else
-	{
-		for (int i = 0; i < m_keyCount; i++)
-		{
-			if (m_keys[i].frame > frame)
-			{
-				key = &m_keys[i];
-				break;
-			}
-		}
+		key = upper_bound(m_keys, m_keys + m_keyCount, frame, [](int f, const SfxKeyFrame& k) { return f < k.frame; });
+
+	return key != m_keys + m_keyCount ? key : nullptr;
+}
+
+bool SfxPart::currentTexture(int frame, const Texture*& texture, vec4& rect) const
+{
+	int texFrame = 0;
 
+	if (m_hasTexture && m_texFrame > 1)
+	{
+		const SfxKeyFrame* firstKey = getNextKey(0);
+		if (!firstKey || frame < firstKey->frame)
+			return false;
+		texFrame = (int)((m_texFrame * (frame - firstKey->frame) / m_texLoop) % m_texFrame);
 	}
-	return key;
+
+	texture = frameTexture(texFrame, rect);
+	return true;
 }
 
 SfxPartBill::SfxPartBill()
 {
 }
 
-void SfxPartBill::render(int frame, const vec3& pos, const vec3& angle, const vec3& scale)
+void SfxPartBill::render(int frame, int& keyCursor, const vec3& pos, const vec3& angle, const vec3& scale)
 {
 	SfxKeyFrame key;
-	if (!getKey(frame, key))
+	if (!getKey(frame, key, keyCursor))
 		return;
 
-	ShaderVars::sfxVAO.bind();
-
-	if (m_hasTexture)
-	{
-		if (m_texFrame > 1)
-		{
-			const SfxKeyFrame* firstKey = getNextKey(0);
-			if (!firstKey || frame < firstKey->frame)
-				return;
-			m_textures[(int)((m_texFrame * (frame - firstKey->frame) / m_texLoop) % m_texFrame)]->bind();
-		}
-		else
-			m_texture->bind();
-	}
-	else
-		ShaderVars::blankTexture.bind();
+	const Texture* texture;
+	vec4 rect;
+	if (!currentTexture(frame, texture, rect))
+		return;
 
 	const mat4 matScale = glm::scale(mat4(), scale * key.scale);
 	const vec3 rot = radians(angle);
@@ -254,22 +304,19 @@ void SfxPartBill::render(int frame, const vec3& pos, const vec3& angle, const ve
 	}
 
 	const vec3 temp = radians(key.posRotate);
-	const mat4 world = ShaderVars::viewProj * (translate(mat4(), pos + transformCoord(key.pos, yawPitchRoll(temp.y, temp.x, temp.z)) * scale) * matTemp);
-
-	if (m_alphaType == SfxPartAlphaType::Glow)
-		gl::blendFunc(GL_SRC_ALPHA, GL_ONE);
-	else
-		gl::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-	gl::uniform(Shaders::sfx.uWVP, world);
-
-	if (Shaders::sfx.alphaFactor != key.alpha)
-	{
-		gl::uniform(Shaders::sfx.uAlphaFactor, key.alpha);
-		Shaders::sfx.alphaFactor = key.alpha;
-	}
-
-	gl::drawArrays(GL_TRIANGLE_FAN, 0, 4);
+	const mat4 world = translate(mat4(), pos + transformCoord(key.pos, yawPitchRoll(temp.y, temp.x, temp.z)) * scale) * matTemp;
+
+	SfxParticleVertex* const v = SfxBatcher::addQuads(texture, m_alphaType == SfxPartAlphaType::Glow, 1);
+
+	v[0].p = transformCoord(vec3(-0.5f, 0.5f, 0.0f), world);
+	v[0].t = vec2(rect.x, rect.y + rect.w);
+	v[1].p = transformCoord(vec3(0.5f, 0.5f, 0.0f), world);
+	v[1].t = vec2(rect.x + rect.z, rect.y + rect.w);
+	v[2].p = transformCoord(vec3(-0.5f, -0.5f, 0.0f), world);
+	v[2].t = vec2(rect.x, rect.y);
+	v[3].p = transformCoord(vec3(0.5f, -0.5f, 0.0f), world);
+	v[3].t = vec2(rect.x + rect.z, rect.y);
+	v[0].a = v[1].a = v[2].a = v[3].a = key.alpha;
 }
 
 SfxPartMesh::SfxPartMesh()
@@ -284,7 +331,7 @@ SfxPartMesh::~SfxPartMesh()
 		delete[] m_bones;
 }
 
-void SfxPartMesh::render(int frame, const vec3& pos, const vec3& angle, const vec3& scale)
+void SfxPartMesh::render(int frame, int& keyCursor, const vec3& pos, const vec3& angle, const vec3& scale)
 {
 	if (!m_obj3d)
 	{
@@ -298,7 +345,7 @@ void SfxPartMesh::render(int frame, const vec3& pos, const vec3& angle, const ve
 	}
 
 	SfxKeyFrame key;
-	if (!getKey(frame, key))
+	if (!getKey(frame, key, keyCursor))
 		return;
 
 	const vec3 rot = radians(key.rotate + vec3(0.0f, angle.y, 0.0f));
@@ -314,6 +361,7 @@ void SfxPartMesh::render(int frame, const vec3& pos, const vec3& angle, const ve
 		gl::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	m_obj3d->render(m_bones, world, 0, 0, Object3D::NoEffect, key.alpha);
+	Stats::add(Stats::SfxDrawCalls);
 }
 
 void SfxPartMesh::setTexture()
@@ -327,28 +375,17 @@ SfxPartCustomMesh::SfxPartCustomMesh()
 {
 }
 
-void SfxPartCustomMesh::render(int frame, const vec3& pos, const vec3& angle, const vec3& scale)
+void SfxPartCustomMesh::render(int frame, int& keyCursor, const vec3& pos, const vec3& angle, const vec3& scale)
 {
 	SfxKeyFrame key;
-	if (!getKey(frame, key))
+	if (!getKey(frame, key, keyCursor))
 		return;
 
-	ShaderVars::customSfxVAO.bind();
-
-	if (m_hasTexture)
-	{
-		if (m_texFrame > 1)
-		{
-			const SfxKeyFrame* firstKey = getNextKey(0);
-			if (!firstKey || frame < firstKey->frame)
-				return;
-			m_textures[(int)((m_texFrame * (frame - firstKey->frame) / m_texLoop) % m_texFrame)]->bind();
-		}
-		else
-			m_texture->bind();
-	}
-	else
-		ShaderVars::blankTexture.bind();
+	// never packed in an atlas, the rect is the whole texture
+	const Texture* texture;
+	vec4 rect;
+	if (!currentTexture(frame, texture, rect))
+		return;
 
 	const vec3 rot = radians(angle);
 	const mat4 matRot = yawPitchRoll(rot.y, rot.x, rot.z);
@@ -374,9 +411,9 @@ void SfxPartCustomMesh::render(int frame, const vec3& pos, const vec3& angle, co
 	}
 	}
 
-	const mat4 world = ShaderVars::viewProj * (translate(mat4(), pos + transformCoord(key.pos, matRot) * scale) * matTemp);
+	const mat4 world = translate(mat4(), pos + transformCoord(key.pos, matRot) * scale) * matTemp;
 
-	static SfxVertex vertices[((MAX_POINTS_SFX_CUSTOMMESH * 2) + 1) * 2];
+	static SfxParticleVertex vertices[((MAX_POINTS_SFX_CUSTOMMESH * 2) + 1) * 2];
 
 	float texX = 0.0f;
 
@@ -386,8 +423,8 @@ void SfxPartCustomMesh::render(int frame, const vec3& pos, const vec3& angle, co
 		const float sinAnglePos = sin(tmpAnglePos);
 		const float cosAnglePos = cos(tmpAnglePos);
 
-		vertices[i * 2].p = vec3(sinAnglePos * key.scale.x, key.scale.y, cosAnglePos * key.scale.x) * scale;
-		vertices[i * 2 + 1].p = vec3(sinAnglePos * key.scale.z, 0.0f, cosAnglePos * key.scale.z) * scale;
+		vertices[i * 2].p = transformCoord(vec3(sinAnglePos * key.scale.x, key.scale.y, cosAnglePos * key.scale.x) * scale, world);
+		vertices[i * 2 + 1].p = transformCoord(vec3(sinAnglePos * key.scale.z, 0.0f, cosAnglePos * key.scale.z) * scale, world);
 
 		vertices[i * 2].t.y = 1.0f - (key.posRotate.y + 0.1f);
 		vertices[i * 2 + 1].t.y = 1.0f - key.posRotate.z;
@@ -403,28 +440,21 @@ void SfxPartCustomMesh::render(int frame, const vec3& pos, const vec3& angle, co
 			texX = key.posRotate.x * ((float)i) / (m_pointCount * 2);
 
 		vertices[i * 2].t.x = vertices[i * 2 + 1].t.x = texX;
+		vertices[i * 2].a = vertices[i * 2 + 1].a = key.alpha;
 	}
 
-	ShaderVars::customSfxVBO.bind();
-	ShaderVars::customSfxVBO.data(((m_pointCount * 2) + 1) * 2 * sizeof(SfxVertex), &vertices, true);
+	// the strip was drawn with both windings, consecutive vertex pairs are the quads
+	const int quadCount = m_pointCount * 2;
+	SfxParticleVertex* v = SfxBatcher::addQuads(texture, m_alphaType == SfxPartAlphaType::Glow, quadCount * 2);
 
-	if (m_alphaType == SfxPartAlphaType::Glow)
-		gl::blendFunc(GL_SRC_ALPHA, GL_ONE);
-	else
-		gl::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-	gl::uniform(Shaders::sfx.uWVP, world);
-
-	if (Shaders::sfx.alphaFactor != key.alpha)
+	for (int pass = 0; pass < 2; pass++)
 	{
-		gl::uniform(Shaders::sfx.uAlphaFactor, key.alpha);
-		Shaders::sfx.alphaFactor = key.alpha;
+		for (int i = 0; i < quadCount; i++)
+		{
+			memcpy(v, &vertices[i * 2], sizeof(SfxParticleVertex) * 4);
+			v += 4;
+		}
 	}
-
-	gl::frontFace(GL_CW);
-	gl::drawArrays(GL_TRIANGLE_STRIP, 0, m_pointCount * 4 + 2);
-	gl::frontFace(GL_CCW);
-	gl::drawArrays(GL_TRIANGLE_STRIP, 0, m_pointCount * 4 + 2);
 }
 
 void SfxPartCustomMesh::load(BinaryReader& reader, uint8_t ver)
@@ -498,7 +528,7 @@ void SfxPartParticle::load(BinaryReader& reader, uint8_t ver)
 		>> m_repeat;
 }
 
-void SfxPartParticle::render(int frame, const vec3& pos, const vec3& angle, const vec3& scale)
+void SfxPartParticle::render(int frame, int& keyCursor, const vec3& pos, const vec3& angle, const vec3& scale)
 {
 	// In the SfxModel
 }
@@ -3,6 +3,7 @@
 #include "BinaryReader.hpp"
 #include "ModelFile.hpp"
 #include "Texture.hpp"
+#include "SfxKeyFrame.hpp"
 
 enum class SfxPartType : uint8_t
 {
@@ -26,16 +27,6 @@ enum class SfxPartAlphaType : uint8_t
 	Glow = 2,
 };
 
-struct SfxKeyFrame
-{
-	vec3 pos;
-	vec3 posRotate;
-	vec3 scale;
-	vec3 rotate;
-	float alpha;
-	int frame;
-};
-
 class SfxModel;
 
 class SfxPart
@@ -45,12 +36,19 @@ public:
 	virtual ~SfxPart();
 
 	virtual void load(BinaryReader& reader, uint8_t ver);
-	virtual void render(int frame, const vec3& pos, const vec3& angle, const vec3& scale) = 0;
+	// keyCursor is the last key found for the rendering instance, see findKey
+	virtual void render(int frame, int& keyCursor, const vec3& pos, const vec3& angle, const vec3& scale) = 0;
 
 	virtual SfxPartType type() const = 0;
 
+	// index of the last key at or before frame, -1 before the first key
+	// the cursor version steps forward from the previous result and falls back to a binary search
+	int findKey(int frame) const;
+	int findKey(int frame, int& cursor) const;
+
 	const SfxKeyFrame* getKey(int frame) const;
 	const bool getKey(int frame, SfxKeyFrame& key) const;
+	const bool getKey(int frame, SfxKeyFrame& key, int& cursor) const;
 	const SfxKeyFrame* getPrevKey(int frame) const;
 	const SfxKeyFrame* getNextKey(int frame, bool skip = true) const;
 	const SfxKeyFrame* getFirstKey() const;
@@ -58,6 +56,13 @@ public:
 
 protected:
 	virtual void setTexture();
+	// one texture per animation frame, used without an atlas or when the atlas is missing
+	void loadFrameTextures() const;
+
+	// rect is the uv offset and size of the frame, the whole texture outside an atlas
+	const Texture* frameTexture(int texFrame, vec4& rect) const;
+	// null for the blank texture, false before the first key of an animated texture
+	bool currentTexture(int frame, const Texture*& texture, vec4& rect) const;
 
 protected:
 	SfxPartBillType m_billType;
@@ -67,8 +72,14 @@ protected:
 	char m_textureName[128];
 	int m_keyCount;
 	SfxKeyFrame* m_keys;
+	// difference from each key to the next one, frame being the frame count between them
+	SfxKeyFrame* m_keyDeltas;
 	TexturePtr m_texture;
-	TexturePtr* m_textures;
+	// animated textures are packed on the SfxAtlas::grid of their frame count
+	TexturePtr m_atlas;
+	int m_atlasColumns;
+	int m_atlasRows;
+	mutable TexturePtr* m_textures;
 	bool m_hasTexture;
 };
 
@@ -81,7 +92,7 @@ public:
 		return SfxPartType::Bill;
 	}
 
-	virtual void render(int frame, const vec3& pos, const vec3& angle, const vec3& scale);
+	virtual void render(int frame, int& keyCursor, const vec3& pos, const vec3& angle, const vec3& scale);
 };
 
 class SfxPartMesh : public SfxPart
@@ -94,7 +105,7 @@ public:
 		return SfxPartType::Mesh;
 	}
 
-	virtual void render(int frame, const vec3& pos, const vec3& angle, const vec3& scale);
+	virtual void render(int frame, int& keyCursor, const vec3& pos, const vec3& angle, const vec3& scale);
 
 protected:
 	virtual void setTexture();
@@ -116,7 +127,7 @@ public:
 		return SfxPartType::CustomMesh;
 	}
 
-	virtual void render(int frame, const vec3& pos, const vec3& angle, const vec3& scale);
+	virtual void render(int frame, int& keyCursor, const vec3& pos, const vec3& angle, const vec3& scale);
 
 private:
 	int m_pointCount;
@@ -133,7 +144,7 @@ public:
 		return SfxPartType::Particle;
 	}
 
-	virtual void render(int frame, const vec3& pos, const vec3& angle, const vec3& scale);
+	virtual void render(int frame, int& keyCursor, const vec3& pos, const vec3& angle, const vec3& scale);
 
 private:
 	int m_particleCreate;
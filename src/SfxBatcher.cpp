@@ -0,0 +1,117 @@
+#include "StdAfx.hpp"
+#include "SfxBatcher.hpp"
+#include "Texture.hpp"
+#include "Shaders.hpp"
+#include "Stats.hpp"
+
+namespace SfxBatcher
+{
+	namespace
+	{
+		struct Batch
+		{
+			const Texture* texture;
+			bool glow;
+			vector<SfxParticleVertex> vertices;
+		};
+
+		vector<Batch> s_batches;
+		int s_batchCount = 0;
+		// last texture drawn, counts the texture switches of the flush
+		const Texture* s_boundTexture = nullptr;
+		bool s_bound = false;
+
+		void draw(const Batch& batch)
+		{
+			if (batch.texture)
+				batch.texture->bind();
+			else
+				ShaderVars::blankTexture.bind();
+
+			if (!s_bound || batch.texture != s_boundTexture)
+			{
+				s_boundTexture = batch.texture;
+				s_bound = true;
+				Stats::add(Stats::SfxTextureBinds);
+			}
+
+			const int quadCount = (int)batch.vertices.size() / 4;
+
+			for (int first = 0; first < quadCount; first += MAX_QUADS)
+			{
+				const int count = glm::min(quadCount - first, MAX_QUADS);
+
+				const GLintptr offset = ShaderVars::particleVBO.write(&batch.vertices[first * 4], count * 4 * sizeof(SfxParticleVertex), 4 * sizeof(SfxParticleVertex));
+				const int firstQuad = gl::StreamBuffer::first(ShaderVars::particleVBO.segmentOffset(offset), 4 * sizeof(SfxParticleVertex));
+
+				ShaderVars::particleVAO[ShaderVars::particleVBO.segment(offset)].bind();
+
+				gl::drawElements<uint16_t>(GL_TRIANGLES, count * 6, firstQuad * 6 * sizeof(uint16_t));
+				Stats::add(Stats::SfxDrawCalls);
+			}
+
+			Stats::add(Stats::SfxBatchedQuads, quadCount);
+		}
+	}
+
+	SfxParticleVertex* addQuads(const Texture* texture, bool glow, int quadCount)
+	{
+		Batch* batch = nullptr;
+
+		// additive glow is order independent and grouped by texture back to the last blended batch
+		// blended quads keep the far to near order, only a run of the same texture is merged
+		for (int i = s_batchCount - 1; i >= 0 && s_batches[i].glow == glow; i--)
+		{
+			if (s_batches[i].texture == texture)
+				batch = &s_batches[i];
+			if (batch || !glow)
+				break;
+		}
+
+		if (!batch)
+		{
+			if (s_batchCount == (int)s_batches.size())
+				s_batches.resize(s_batchCount + 1);
+
+			batch = &s_batches[s_batchCount++];
+			batch->texture = texture;
+			batch->glow = glow;
+			batch->vertices.clear();
+		}
+
+		const std::size_t first = batch->vertices.size();
+		batch->vertices.resize(first + quadCount * 4);
+		return &batch->vertices[first];
+	}
+
+	void flush()
+	{
+		if (!s_batchCount)
+			return;
+
+		Shaders::particle.use();
+
+		gl::disableDepthWrite();
+		gl::disableCull();
+		gl::enableBlend();
+
+		s_bound = false;
+
+		for (int i = 0; i < s_batchCount; i++)
+		{
+			const Batch& batch = s_batches[i];
+
+			if (i == 0 || batch.glow != s_batches[i - 1].glow)
+			{
+				if (batch.glow)
+					gl::blendFunc(GL_SRC_ALPHA, GL_ONE);
+				else
+					gl::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			}
+
+			draw(batch);
+		}
+
+		s_batchCount = 0;
+	}
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "Vertex.hpp"
+
+class Texture;
+
+// world space sfx quads collected during the frame and drawn in submission order
+// a run of glowing quads is grouped by texture, blended quads only merge with the previous batch
+// anything drawn without the batcher must flush it first to keep the order
+namespace SfxBatcher
+{
+	// room for quadCount quads of 4 vertices in quadsIBO order, valid until the next call
+	// texture null for the blank texture
+	SfxParticleVertex* addQuads(const Texture* texture, bool glow, int quadCount);
+
+	// draws the batches in order, switching the blend function between the modes
+	void flush();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Stats.hpp"
+
+struct SfxKeyFrame
+{
+	vec3 pos;
+	vec3 posRotate;
+	vec3 scale;
+	vec3 rotate;
+	float alpha;
+	int frame;
+};
+
+// keys are sorted by frame, the searches return the index of the last key at or before frame, -1 before the first key
+namespace SfxKeys
+{
+	inline int find(const SfxKeyFrame* keys, int keyCount, int frame)
+	{
+		Stats::add(Stats::SfxKeySearches);
+
+		const SfxKeyFrame* const key = upper_bound(keys, keys + keyCount, frame,
+			[](int f, const SfxKeyFrame& k) { return f < k.frame; });
+
+		return (int)(key - keys) - 1;
+	}
+
+	// steps forward from the previous result of the instance and falls back to a binary search
+	inline int find(const SfxKeyFrame* keys, int keyCount, int frame, int& cursor)
+	{
+		Stats::add(Stats::SfxKeyLookups);
+
+		int i = cursor;
+		if (i < 0 || i >= keyCount || keys[i].frame > frame)
+			i = find(keys, keyCount, frame);
+		else
+		{
+			// a few keys at most between two rendered frames
+			for (int steps = 0; i + 1 < keyCount && keys[i + 1].frame <= frame; steps++)
+			{
+				if (steps == 4)
+				{
+					i = find(keys, keyCount, frame);
+					break;
+				}
+				i++;
+			}
+		}
+
+		if (i >= 0)
+			cursor = i;
+		return i;
+	}
+}
@@ -4,13 +4,51 @@
 #include "SfxBase.hpp"
 #include "Shaders.hpp"
 #include "GeometryUtils.hpp"
+#include "Stats.hpp"
+#include "SfxParticlePool.hpp"
+#include "SfxBatcher.hpp"
+#include "Pool.hpp"
+
+namespace
+{
+	vector<SfxParticleVertex> s_particleVertices;
+	vector<int> s_particleTexFrames;
+	vector<int> s_texFrameStart;
+	vector<int> s_texFrameCursor;
+	vector<const Texture*> s_texFrameTextures;
+	vector<vec4> s_texFrameRects;
+
+	uint32_t s_randomSeed = 0x9e3779b9;
+
+	Pool<SfxModel, 64> s_sfxModelPool;
+}
+
+void* SfxModel::operator new(std::size_t size)
+{
+	if (size != sizeof(SfxModel))
+		return ::operator new(size);
+	return s_sfxModelPool.allocate();
+}
+
+void SfxModel::operator delete(void* ptr, std::size_t size)
+{
+	if (size != sizeof(SfxModel))
+		::operator delete(ptr);
+	else
+		s_sfxModelPool.free(ptr);
+}
 
 SfxModel::SfxModel(const ModelProp* prop)
 	: Model(prop),
 	m_partCount(0),
 	m_parts(nullptr),
-	m_particles(nullptr)
+	m_particles(nullptr),
+	m_keyCursors(nullptr),
+	m_random(s_randomSeed)
 {
+	s_randomSeed = s_randomSeed * 1664525 + 1013904223;
+	if (!m_random)
+		m_random = 1;
 }
 
 SfxModel::~SfxModel()
@@ -22,60 +60,53 @@ SfxModel::~SfxModel()
 				delete m_particles[i];
 		delete[] m_particles;
 	}
+	if (m_keyCursors)
+		delete[] m_keyCursors;
 }
 
 void SfxModel::render(const vec3& pos, const vec3& angle, const vec3& scale) const
 {
 	const int frame = (int)m_currentFrame;
 
-	bool vboBind = false, programBind = false;
-
 	for (int i = 0; i < m_partCount; i++)
 	{
 		SfxPart* const part = m_parts[i];
 
-		const SfxPartType type = part->type();
-
-		if (type != SfxPartType::Mesh && !programBind)
+		switch (part->type())
 		{
-			Shaders::sfx.use();
+		case SfxPartType::Bill:
+		case SfxPartType::CustomMesh:
+			part->render(frame, m_keyCursors[i], pos, angle, scale);
+			break;
+		case SfxPartType::Mesh:
+			// drawn right away, so the quads submitted before it go first
+			SfxBatcher::flush();
 			gl::disableDepthWrite();
 			gl::disableCull();
 			gl::enableBlend();
-
-			programBind = true;
-		}
-
-		switch (type)
-		{
-		case SfxPartType::Bill:
-			part->render(frame, pos, angle, scale);
-			break;
-		case SfxPartType::CustomMesh:
-			part->render(frame, pos, angle, scale);
+			part->render(frame, m_keyCursors[i], pos, angle, scale);
 			break;
 		case SfxPartType::Particle:
-			renderParticles(*m_particles[i], (const SfxPartParticle*)part, pos, angle, scale);
-			break;
-		case SfxPartType::Mesh:
-			part->render(frame, pos, angle, scale);
-			programBind = false;
+			renderParticles(*m_particles[i], (const SfxPartParticle*)part, m_keyCursors[i], pos, angle, scale);
 			break;
 		}
 	}
 }
 
-void SfxModel::renderParticles(const SfxParticle::Array& particles, const SfxPartParticle* part, const vec3& pos, const vec3& angle, const vec3& scale) const
+void SfxModel::renderParticles(const SfxParticlePool& particles, const SfxPartParticle* part, int& keyCursor, const vec3& pos, const vec3& angle, const vec3& scale) const
 {
+	if (particles.empty())
+		return;
+
+	Stats::Timer timer(Stats::SfxParticleTime);
+
 	const int frame = (int)m_currentFrame;
 
 	SfxKeyFrame key;
-	if (!part->getKey(frame, key))
+	if (!part->getKey(frame, key, keyCursor))
 		return;
 
-	ShaderVars::sfxVAO.bind();
-
-	const int prevFrame = part->getPrevKey(frame)->frame;
+	const int prevFrame = part->m_keys[keyCursor].frame;
 
 	const vec3 rot = radians(angle);
 	const mat4 matRot = yawPitchRoll(rot.y, rot.x, rot.z);
@@ -99,69 +130,128 @@ void SfxModel::renderParticles(const SfxParticle::Array& particles, const SfxPar
 	}
 	}
 
-	if (part->m_alphaType == SfxPartAlphaType::Glow)
-		gl::blendFunc(GL_SRC_ALPHA, GL_ONE);
-	else
-		gl::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-	if (part->m_hasTexture)
-	{
-		if (part->m_texFrame <= 1)
-			part->m_texture->bind();
-	}
-	else
-		ShaderVars::blankTexture.bind();
-
-	int sendTexFrame = -1;
-	vec3 tempRot;
-	float tempAlpha;
-
 	const vec3 keyPosRotate = radians(key.posRotate);
 	const vec3 temp = transformCoord(key.pos, yawPitchRoll(keyPosRotate.y, keyPosRotate.x, keyPosRotate.z) * matRot);
 	const vec3 temp2 = radians(key.rotate + key.posRotate);
 	const mat4 matTemp2 = matRot * yawPitchRoll(temp2.y, temp2.x, temp2.z);
+	const mat3 basis(matTemp);
+	const float rotFactor = key.frame != 0 ? (float)(frame - prevFrame) / key.frame : 0.0f;
+
+	// glow particles are grouped by texture frame, one batch per frame, blended ones
+	// keep their order and only share a batch while the texture doesn't change
+	const bool glow = part->m_alphaType == SfxPartAlphaType::Glow;
+	const int texFrames = part->m_hasTexture && part->m_texFrame > 1 ? part->m_texFrame : 1;
+	const int count = (int)particles.size();
+	int i;
+
+	s_texFrameStart.assign(texFrames + 1, 0);
+	s_particleTexFrames.resize(count);
 
-	for (auto it = particles.begin(); it != particles.end(); it++)
+	for (i = 0; i < count; i++)
 	{
-		const SfxParticle& particle = *it;
+		const int texFrame = texFrames > 1 ? (part->m_texFrame * particles.frame(i) / part->m_texLoop) % part->m_texFrame : 0;
+		s_particleTexFrames[i] = texFrame;
+		s_texFrameStart[texFrame + 1]++;
+	}
 
-		if (part->m_hasTexture && part->m_texFrame > 1)
-		{
-			const int texFrame = (part->m_texFrame * particle.frame / part->m_texLoop) % part->m_texFrame;
-			if (texFrame != sendTexFrame)
-			{
-				part->m_textures[texFrame]->bind();
-				sendTexFrame = texFrame;
-			}
-		}
+	for (i = 0; i < texFrames; i++)
+		s_texFrameStart[i + 1] += s_texFrameStart[i];
 
-		const mat4 matTrans = translate(mat4(), temp + (transformCoord(particle.pos, matTemp2) * scale) + pos);
-		const mat4 matScale = glm::scale(mat4(), scale * vec3(particle.scale.x, particle.scale.y, 1.0f));
+	s_texFrameCursor.assign(s_texFrameStart.begin(), s_texFrameStart.end() - 1);
 
-		if (key.frame != 0)
-			tempRot = radians(glm::lerp(vec3(0.0f, 0.0f, 0.0f), particle.rotation, (float)(frame - prevFrame) / key.frame));
-		else
-			tempRot = vec3(0.0f, 0.0f, 0.0f);
+	// the frames of an atlas share one texture and end up in the same batch
+	s_texFrameTextures.resize(texFrames);
+	s_texFrameRects.resize(texFrames);
+	for (i = 0; i < texFrames; i++)
+		s_texFrameTextures[i] = part->frameTexture(i, s_texFrameRects[i]);
+
+	if ((int)s_particleVertices.size() < count * 4)
+		s_particleVertices.resize(count * 4);
 
-		const mat4 world = ShaderVars::viewProj * (matTrans * matTemp * matScale * yawPitchRoll(tempRot.y, tempRot.x, tempRot.z));
+	float alpha;
 
-		gl::uniform(Shaders::sfx.uWVP, world);
+	for (i = 0; i < count; i++)
+	{
+		const int particleFrame = particles.frame(i);
+		const vec3 particlePos = particles.get(SfxParticlePool::PosX, i);
+		vec3 particleScale = particles.get(SfxParticlePool::ScaleX, i);
+		particleScale.z = 1.0f;
+		particleScale *= scale;
+		const vec3 particleRotation = particles.get(SfxParticlePool::RotationX, i);
+		const vec3 center = temp + (transformCoord(particlePos, matTemp2) * scale) + pos;
+
+		vec3 axisX, axisY;
+		if (rotFactor != 0.0f && particleRotation != vec3(0.0f, 0.0f, 0.0f))
+		{
+			const vec3 tempRot = radians(particleRotation * rotFactor);
+			const mat3 matParticle(yawPitchRoll(tempRot.y, tempRot.x, tempRot.z));
 
-		if (particle.frame < part->m_particleFrameAppear)
-			tempAlpha = particle.frame * key.alpha / part->m_particleFrameAppear;
-		else if (particle.frame > part->m_particleFrameKeep)
-			tempAlpha = key.alpha - (key.alpha * (particle.frame - part->m_particleFrameKeep) / (part->m_particleFrameDisappear - part->m_particleFrameKeep));
+			axisX = basis * (matParticle[0] * particleScale) * 0.5f;
+			axisY = basis * (matParticle[1] * particleScale) * 0.5f;
+		}
 		else
-			tempAlpha = key.alpha;
+		{
+			axisX = basis[0] * (particleScale.x * 0.5f);
+			axisY = basis[1] * (particleScale.y * 0.5f);
+		}
 
-		if (Shaders::sfx.alphaFactor != tempAlpha)
+		if (particleFrame < part->m_particleFrameAppear)
+			alpha = particleFrame * key.alpha / part->m_particleFrameAppear;
+		else if (particleFrame > part->m_particleFrameKeep)
+			alpha = key.alpha - (key.alpha * (particleFrame - part->m_particleFrameKeep) / (part->m_particleFrameDisappear - part->m_particleFrameKeep));
+		else
+			alpha = key.alpha;
+
+		// same winding as quadsIBO
+		const int texFrame = s_particleTexFrames[i];
+		const vec4& rect = s_texFrameRects[texFrame];
+		SfxParticleVertex* v = &s_particleVertices[(glow ? s_texFrameCursor[texFrame]++ : i) * 4];
+
+		v->p = center - axisX + axisY;
+		v->t = vec2(rect.x, rect.y + rect.w);
+		v->a = alpha;
+		v++;
+		v->p = center + axisX + axisY;
+		v->t = vec2(rect.x + rect.z, rect.y + rect.w);
+		v->a = alpha;
+		v++;
+		v->p = center - axisX - axisY;
+		v->t = vec2(rect.x, rect.y);
+		v->a = alpha;
+		v++;
+		v->p = center + axisX - axisY;
+		v->t = vec2(rect.x + rect.z, rect.y);
+		v->a = alpha;
+	}
+
+	if (glow)
+	{
+		for (i = 0; i < texFrames; i++)
 		{
-			gl::uniform(Shaders::sfx.uAlphaFactor, tempAlpha);
-			Shaders::sfx.alphaFactor = tempAlpha;
+			const int first = s_texFrameStart[i];
+			const int quadCount = s_texFrameStart[i + 1] - first;
+
+			if (!quadCount)
+				continue;
+
+			memcpy(SfxBatcher::addQuads(s_texFrameTextures[i], true, quadCount), &s_particleVertices[first * 4], quadCount * 4 * sizeof(SfxParticleVertex));
 		}
+	}
+	else
+	{
+		int first = 0;
+		for (i = 1; i <= count; i++)
+		{
+			const Texture* const texture = s_texFrameTextures[s_particleTexFrames[first]];
+			if (i < count && s_texFrameTextures[s_particleTexFrames[i]] == texture)
+				continue;
 
-		glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+			memcpy(SfxBatcher::addQuads(texture, false, i - first), &s_particleVertices[first * 4], (i - first) * 4 * sizeof(SfxParticleVertex));
+			first = i;
+		}
 	}
+
+	Stats::add(Stats::SfxParticleCount, count);
 }
 
 void SfxModel::update(int frameCount)
@@ -179,7 +269,7 @@ void SfxModel::update(int frameCount)
 		if (m_particles[i])
 		{
 			const SfxPartParticle* const part = (SfxPartParticle*)m_parts[i];
-			SfxParticle::Array& particles = *m_particles[i];
+			SfxParticlePool& particles = *m_particles[i];
 
 			if (m_endFrame)
 				particles.clear();
@@ -189,78 +279,50 @@ void SfxModel::update(int frameCount)
 
 			for (int frame = frameRangeBegin; frame < frameRangeEnd; frame++)
 			{
-				for (auto it = particles.begin(); it != particles.end(); )
-				{
-					SfxParticle& particle = *it;
-
-					particle.frame++;
-					if (particle.frame >= part->m_particleFrameDisappear)
-						it = particles.erase(it);
-					else
-					{
-						particle.pos += particle.speed;
-						particle.speed += part->m_particleAccel;
+				particles.step(part->m_particleFrameDisappear, part->m_particleAccel);
 
-						if (part->m_repeatScal)
-						{
-							const float lenScale = length(particle.scale);
-
-							if (lenScale >= length(part->m_scaleEnd))
-								particle.scal = true;
-							else if (lenScale <= length(part->m_scale))
-								particle.scal = false;
-
-							if (particle.scal)
-								particle.scale -= particle.scaleSpeed;
-							else
-								particle.scale += particle.scaleSpeed;
-						}
-						else
-							particle.scale += part->m_scaleSpeed;
-
-						it++;
-					}
-				}
+				if (part->m_repeatScal)
+					particles.oscillateScale(length(part->m_scale), length(part->m_scaleEnd));
+				else
+					particles.addScale(part->m_scaleSpeed);
 
 				if (frame >= startFrame && frame <= endFrame - part->m_particleFrameDisappear)
 				{
 					if ((part->m_particleCreate == 0 && frame == startFrame) ||
 						(part->m_particleCreate != 0 && (frame - startFrame) % part->m_particleCreate == 0))
 					{
-						const float rand1 = (rand() % 50000) / 50000.0f;
-						const float rand2 = (rand() % 50000) / 50000.0f;
-						const float rand3 = (rand() % 50000) / 50000.0f;
+						const float rand1 = random();
+						const float rand2 = random();
+						const float rand3 = random();
 
 						for (int j = 0; j < part->m_particleCreateNum; j++)
 						{
-							SfxParticle particle;
-							particle.frame = 0;
-							particle.scale = part->m_scale;
-							particle.scal = false;
+							const int p = particles.spawn();
+							if (p < 0)
+								break;
 
-							const float angle = ((rand() % 50000) / 50000.0f) * 360.0f;
+							const float angle = random() * 360.0f;
 							const float factor = part->m_particleXZLow + rand2 * (part->m_particleXZHigh - part->m_particleXZLow);
 
-							particle.pos = vec3(sin(angle) * part->m_particleStartPosVar,
+							particles.set(SfxParticlePool::ScaleX, p, part->m_scale);
+							particles.set(SfxParticlePool::PosX, p, vec3(sin(angle) * part->m_particleStartPosVar,
 								rand1 * part->m_particleStartPosVarY,
-								cos(angle) * part->m_particleStartPosVar);
-							particle.speed = vec3(sin(angle) * factor,
+								cos(angle) * part->m_particleStartPosVar));
+							particles.set(SfxParticlePool::SpeedX, p, vec3(sin(angle) * factor,
 								part->m_particleYLow + rand2 * (part->m_particleYHigh - part->m_particleYLow),
-								cos(angle) * factor);
-							particle.rotation = vec3(part->m_rotationLow.x + rand1 *
+								cos(angle) * factor));
+							particles.set(SfxParticlePool::RotationX, p, vec3(part->m_rotationLow.x + rand1 *
 								(part->m_rotationHigh.x - part->m_rotationLow.x),
 								part->m_rotationLow.y + rand3 *
 								(part->m_rotationHigh.y - part->m_rotationLow.y),
 								part->m_rotationLow.z + rand2 *
-								(part->m_rotationHigh.z - part->m_rotationLow.z));
-							particle.scaleSpeed = vec3(part->m_scalSpeedXLow + rand3 *
+								(part->m_rotationHigh.z - part->m_rotationLow.z)));
+							particles.set(SfxParticlePool::ScaleSpeedX, p, vec3(part->m_scalSpeedXLow + rand3 *
 								(part->m_scalSpeedXHigh - part->m_scalSpeedXLow),
 								part->m_scalSpeedYLow + rand2 *
 								(part->m_scalSpeedYHigh - part->m_scalSpeedYLow),
 								part->m_scalSpeedZLow + rand1 *
-								(part->m_scalSpeedZHigh - part->m_scalSpeedZLow));
-
-							particles.push_back(particle);
+								(part->m_scalSpeedZHigh - part->m_scalSpeedZLow)));
 						}
 					}
 				}
@@ -282,6 +344,27 @@ void SfxModel::update(int frameCount)
 	}
 }
 
+void SfxModel::restart()
+{
+	m_currentFrame = 0.0f;
+	m_endFrame = false;
+
+	for (int i = 0; i < m_partCount; i++)
+	{
+		m_keyCursors[i] = -1;
+		if (m_particles[i])
+			m_particles[i]->clear();
+	}
+}
+
+float SfxModel::random()
+{
+	m_random ^= m_random << 13;
+	m_random ^= m_random >> 17;
+	m_random ^= m_random << 5;
+	return (m_random >> 8) * (1.0f / 16777216.0f);
+}
+
 void SfxModel::load(const string& filename)
 {
 	m_file = ModelManager::getModelFile(filename);
@@ -299,11 +382,19 @@ bool SfxModel::checkLoaded()
 
 	if (m_partCount)
 	{
-		m_particles = new SfxParticle::Array*[m_partCount];
+		m_keyCursors = new int[m_partCount];
+		m_particles = new SfxParticlePool*[m_partCount];
 		for (int i = 0; i < m_partCount; i++)
 		{
+			m_keyCursors[i] = -1;
+
 			if (m_parts[i]->type() == SfxPartType::Particle)
-				m_particles[i] = new SfxParticle::Array();
+			{
+				// a particle lives m_particleFrameDisappear frames
+				const SfxPartParticle* const part = (SfxPartParticle*)m_parts[i];
+				const int waves = part->m_particleCreate > 0 ? part->m_particleFrameDisappear / part->m_particleCreate + 1 : 1;
+				m_particles[i] = new SfxParticlePool(part->m_particleCreateNum * waves, part->m_alphaType != SfxPartAlphaType::Glow);
+			}
 			else
 				m_particles[i] = nullptr;
 		}
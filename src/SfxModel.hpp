@@ -5,19 +5,7 @@
 
 class SfxPart;
 class SfxPartParticle;
-
-struct SfxParticle
-{
-	vec3 pos;
-	vec3 speed;
-	vec3 scale;
-	vec3 rotation;
-	vec3 scaleSpeed;
-	int frame;
-	bool scal;
-
-	typedef vector<SfxParticle> Array; // TODO : tests vector vs list
-};
+class SfxParticlePool;
 
 class SfxModel : public Model
 {
@@ -25,19 +13,32 @@ public:
 	SfxModel(const ModelProp* prop);
 	virtual ~SfxModel();
 
+	// one per sfx instance, kept in a pool
+	static void* operator new(std::size_t size);
+	static void operator delete(void* ptr, std::size_t size);
+
 	void load(const string& filename);
 	void render(const vec3& pos, const vec3& angle, const vec3& scale) const;
 	void update(int frameCount);
 
+	// back to the first frame without any particle
+	void restart();
+
 protected:
 	virtual bool checkLoaded();
 
 private:
-	void renderParticles(const SfxParticle::Array& particles, const SfxPartParticle* part, const vec3& pos, const vec3& angle, const vec3& scale) const;
+	void renderParticles(const SfxParticlePool& particles, const SfxPartParticle* part, int& keyCursor, const vec3& pos, const vec3& angle, const vec3& scale) const;
+
+	// xorshift32 in [0, 1)
+	float random();
 
 private:
 	ModelFilePtr m_file;
 	int m_partCount;
 	SfxPart** m_parts;
-	SfxParticle::Array** m_particles;
+	SfxParticlePool** m_particles;
+	// per part, see SfxPart::findKey
+	mutable int* m_keyCursors;
+	uint32_t m_random;
 };
\ No newline at end of file
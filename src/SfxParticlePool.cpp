@@ -0,0 +1,269 @@
+#include "StdAfx.hpp"
+#include "SfxParticlePool.hpp"
+#include "Stats.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// capacities are rounded to powers of two from 1 << MIN_BLOCK_SHIFT
+#define MIN_BLOCK_SHIFT 4
+#define MAX_BLOCK_CLASSES 11
+#define MAX_FREE_BLOCKS 32
+
+namespace
+{
+	// float streams followed by the frame and scal int streams
+	const int blockStreams = SfxParticlePool::MAX_STREAM + 2;
+
+	vector<float*> s_freeBlocks[MAX_BLOCK_CLASSES];
+
+	float* allocBlock(int blockClass)
+	{
+		vector<float*>& blocks = s_freeBlocks[blockClass];
+		if (!blocks.empty())
+		{
+			float* const block = blocks.back();
+			blocks.pop_back();
+			return block;
+		}
+
+		Stats::add(Stats::SfxParticleBlockAllocs);
+		return new float[(1 << (blockClass + MIN_BLOCK_SHIFT)) * blockStreams];
+	}
+
+	void freeBlock(int blockClass, float* block)
+	{
+		vector<float*>& blocks = s_freeBlocks[blockClass];
+		if (blocks.size() < MAX_FREE_BLOCKS)
+			blocks.push_back(block);
+		else
+			delete[] block;
+	}
+}
+
+SfxParticlePool::SfxParticlePool(int capacity, bool ordered)
+	: m_count(0),
+	m_capacity(1 << MIN_BLOCK_SHIFT),
+	m_blockClass(0),
+	m_ordered(ordered),
+	m_dropped(false),
+	m_block(nullptr),
+	m_frames(nullptr),
+	m_scal(nullptr)
+{
+	while (m_capacity < capacity && m_blockClass < MAX_BLOCK_CLASSES - 1)
+	{
+		m_capacity <<= 1;
+		m_blockClass++;
+	}
+
+	for (int i = 0; i < MAX_STREAM; i++)
+		m_streams[i] = nullptr;
+}
+
+SfxParticlePool::~SfxParticlePool()
+{
+	clear();
+}
+
+void SfxParticlePool::clear()
+{
+	if (m_block)
+	{
+		freeBlock(m_blockClass, m_block);
+		m_block = nullptr;
+	}
+	m_count = 0;
+}
+
+void SfxParticlePool::setBlock(float* block)
+{
+	m_block = block;
+
+	for (int i = 0; i < MAX_STREAM; i++)
+		m_streams[i] = m_block + i * m_capacity;
+	m_frames = (int*)(m_block + MAX_STREAM * m_capacity);
+	m_scal = m_frames + m_capacity;
+}
+
+bool SfxParticlePool::grow()
+{
+	if (m_blockClass >= MAX_BLOCK_CLASSES - 1)
+		return false;
+
+	float* const oldBlock = m_block;
+	const int oldCapacity = m_capacity;
+	const int oldBlockClass = m_blockClass;
+
+	m_blockClass++;
+	m_capacity <<= 1;
+
+	// every stream, the int ones included, is m_count values at a multiple of the capacity
+	float* const block = allocBlock(m_blockClass);
+	for (int i = 0; i < blockStreams; i++)
+		memcpy(block + i * m_capacity, oldBlock + i * oldCapacity, sizeof(float) * m_count);
+
+	freeBlock(oldBlockClass, oldBlock);
+	setBlock(block);
+	return true;
+}
+
+int SfxParticlePool::spawn()
+{
+	if (!m_block)
+		setBlock(allocBlock(m_blockClass));
+
+	if (m_count >= m_capacity && !grow())
+	{
+		if (!m_dropped)
+		{
+			emscripten_log(EM_LOG_WARN, "Sfx particle pool full (%d particles), new particles are dropped", m_capacity);
+			m_dropped = true;
+		}
+
+		Stats::add(Stats::SfxParticleDrops);
+		return -1;
+	}
+
+	const int i = m_count++;
+	m_frames[i] = 0;
+	m_scal[i] = 0;
+
+	Stats::add(Stats::SfxParticleSpawned);
+	return i;
+}
+
+void SfxParticlePool::kill(int i)
+{
+	const int last = --m_count;
+
+	if (i != last)
+	{
+		for (int s = 0; s < MAX_STREAM; s++)
+			m_streams[s][i] = m_streams[s][last];
+		m_frames[i] = m_frames[last];
+		m_scal[i] = m_scal[last];
+	}
+
+	Stats::add(Stats::SfxParticleKilled);
+}
+
+void SfxParticlePool::step(int maxFrame, const vec3& accel)
+{
+	if (!m_count)
+		return;
+
+	Stats::Timer timer(Stats::SfxParticleUpdateTime);
+
+	int i = 0;
+	if (m_ordered)
+	{
+		// the survivors are packed down in place, keeping their order
+		int alive = 0;
+		for (i = 0; i < m_count; i++)
+		{
+			if (++m_frames[i] >= maxFrame)
+			{
+				Stats::add(Stats::SfxParticleKilled);
+				continue;
+			}
+
+			if (alive != i)
+			{
+				for (int s = 0; s < MAX_STREAM; s++)
+					m_streams[s][alive] = m_streams[s][i];
+				m_frames[alive] = m_frames[i];
+				m_scal[alive] = m_scal[i];
+			}
+			alive++;
+		}
+		m_count = alive;
+	}
+	else
+	{
+		// the particle moved into a killed slot is not aged yet, so the slot is visited again
+		while (i < m_count)
+		{
+			if (++m_frames[i] >= maxFrame)
+				kill(i);
+			else
+				i++;
+		}
+	}
+
+	// the capacity is a multiple of 4, the lanes past m_count are never read
+	const int count = (m_count + 3) & ~3;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float* const pos = m_streams[PosX + axis];
+		float* const speed = m_streams[SpeedX + axis];
+
+#if defined(__SSE2__)
+		const __m128 a = _mm_set1_ps(accel[axis]);
+
+		for (i = 0; i < count; i += 4)
+		{
+			const __m128 s = _mm_loadu_ps(speed + i);
+			_mm_storeu_ps(pos + i, _mm_add_ps(_mm_loadu_ps(pos + i), s));
+			_mm_storeu_ps(speed + i, _mm_add_ps(s, a));
+		}
+#else
+		const float a = accel[axis];
+
+		for (i = 0; i < count; i++)
+		{
+			pos[i] += speed[i];
+			speed[i] += a;
+		}
+#endif
+	}
+}
+
+void SfxParticlePool::addScale(const vec3& speed)
+{
+	const int count = (m_count + 3) & ~3;
+	int i;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float* const scale = m_streams[ScaleX + axis];
+
+#if defined(__SSE2__)
+		const __m128 s = _mm_set1_ps(speed[axis]);
+
+		for (i = 0; i < count; i += 4)
+			_mm_storeu_ps(scale + i, _mm_add_ps(_mm_loadu_ps(scale + i), s));
+#else
+		const float s = speed[axis];
+
+		for (i = 0; i < count; i++)
+			scale[i] += s;
+#endif
+	}
+}
+
+void SfxParticlePool::oscillateScale(float minLength, float maxLength)
+{
+	float* const x = m_streams[ScaleX];
+	float* const y = m_streams[ScaleY];
+	float* const z = m_streams[ScaleZ];
+	const float minLengthSq = minLength * minLength;
+	const float maxLengthSq = maxLength * maxLength;
+
+	for (int i = 0; i < m_count; i++)
+	{
+		const float lengthSq = x[i] * x[i] + y[i] * y[i] + z[i] * z[i];
+
+		if (lengthSq >= maxLengthSq)
+			m_scal[i] = 1;
+		else if (lengthSq <= minLengthSq)
+			m_scal[i] = 0;
+
+		const float sign = m_scal[i] ? -1.0f : 1.0f;
+		x[i] += m_streams[ScaleSpeedX][i] * sign;
+		y[i] += m_streams[ScaleSpeedY][i] * sign;
+		z[i] += m_streams[ScaleSpeedZ][i] * sign;
+	}
+}
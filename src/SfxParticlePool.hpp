@@ -0,0 +1,75 @@
+#pragma once
+
+// SoA particle storage of one emitter, kept in spawn order when ordered
+// otherwise dead particles are replaced by the last one, which is only fine for additive (glow) blending
+// the memory blocks are recycled through a free list shared by every SfxModel, a full pool moves to the next block size
+class SfxParticlePool
+{
+public:
+	enum Stream
+	{
+		PosX, PosY, PosZ,
+		SpeedX, SpeedY, SpeedZ,
+		ScaleX, ScaleY, ScaleZ,
+		RotationX, RotationY, RotationZ,
+		ScaleSpeedX, ScaleSpeedY, ScaleSpeedZ,
+		MAX_STREAM
+	};
+
+public:
+	explicit SfxParticlePool(int capacity, bool ordered);
+	~SfxParticlePool();
+
+	// gives the block back to the shared free list
+	void clear();
+
+	// -1 when the pool is full at the largest block size, the particle starts at frame 0 and growing scale
+	int spawn();
+	void kill(int i);
+
+	// ages the particles, kills the ones reaching maxFrame and integrates the others
+	void step(int maxFrame, const vec3& accel);
+	void addScale(const vec3& speed);
+	// scale goes back and forth between the two lengths at the particle scale speed
+	void oscillateScale(float minLength, float maxLength);
+
+	int size() const {
+		return m_count;
+	}
+	bool empty() const {
+		return m_count == 0;
+	}
+	int capacity() const {
+		return m_capacity;
+	}
+	int frame(int i) const {
+		return m_frames[i];
+	}
+	vec3 get(Stream stream, int i) const {
+		return vec3(m_streams[stream][i], m_streams[stream + 1][i], m_streams[stream + 2][i]);
+	}
+	void set(Stream stream, int i, const vec3& v) {
+		m_streams[stream][i] = v.x;
+		m_streams[stream + 1][i] = v.y;
+		m_streams[stream + 2][i] = v.z;
+	}
+
+private:
+	void setBlock(float* block);
+	bool grow();
+
+private:
+	int m_count;
+	int m_capacity;
+	int m_blockClass;
+	bool m_ordered;
+	bool m_dropped;
+	float* m_block;
+	float* m_streams[MAX_STREAM];
+	int* m_frames;
+	int* m_scal;
+
+private:
+	SfxParticlePool(const SfxParticlePool&) = delete;
+	SfxParticlePool& operator=(const SfxParticlePool&) = delete;
+};
@@ -11,8 +11,11 @@ namespace ShaderVars
 	vec3 cameraPos;
 	int MPU;
 	vec3 fogColor;
+	vec2 fogSettings;
 	vec3 cameraDir;
 	vec3 lightDir;
+	vec3 ambient;
+	vec3 diffuse;
 	float sunAngle;
 	mat4 viewProj;
 	mat4 invView;
@@ -22,9 +25,11 @@ namespace ShaderVars
 	vec4 frustum[6];
 
 	gl::Texture2D blankTexture;
-	gl::VertexArray skyboxVAO, sfxVAO, rainVAO, snowVAO, render2dVAO, sunVAO, customSfxVAO;
+	gl::VertexArray skyboxVAO, rainVAO, snowVAO, sunVAO;
+	gl::VertexArray particleVAO[MAX_STREAM_BUFFERS], render2dVAO[MAX_STREAM_BUFFERS];
 	gl::IndexBuffer terrainIBO, quadsIBO;
-	gl::VertexBuffer skyboxVBO, sfxVBO, rainVBO, snowVBO, render2dVBO, sunVBO, customSfxVBO;
+	gl::VertexBuffer skyboxVBO;
+	gl::StreamBuffer particleVBO, rainVBO, snowVBO, render2dVBO, sunVBO;
 
 	void createTerrainIBO()
 	{
@@ -83,7 +88,7 @@ namespace ShaderVars
 
 	void createQuadsIBO()
 	{
-		const int indexCount = 6 * 128;
+		const int indexCount = 6 * MAX_QUADS;
 		uint16_t* indexes = new uint16_t[indexCount];
 
 		for (int i = 0; i < indexCount / 6; i++)
@@ -228,8 +233,8 @@ namespace ShaderVars
 		skyboxVAO.vertexAttribPointer<vec2>(VATTRIB_TEXCOORD0, false, sizeof(SkyboxVertex), sizeof(vec3));
 		skyboxVAO.vertexAttribPointer<float>(VATTRIB_DIFFUSE, false, sizeof(SkyboxVertex), sizeof(vec3) + sizeof(vec2));
 
-		sunVBO.create();
-		sunVBO.bind();
+		// sun and moon
+		sunVBO.create(MAX_STREAM_BUFFERS * 2 * 4 * sizeof(SkyboxVertex));
 
 		sunVAO.create();
 		sunVAO.bind();
@@ -237,16 +242,14 @@ namespace ShaderVars
 		sunVAO.vertexAttribPointer<vec2>(VATTRIB_TEXCOORD0, false, sizeof(SkyboxVertex), sizeof(vec3));
 		sunVAO.vertexAttribPointer<float>(VATTRIB_DIFFUSE, false, sizeof(SkyboxVertex), sizeof(vec3) + sizeof(vec2));
 
-		rainVBO.create();
-		rainVBO.bind();
+		rainVBO.create(MAX_STREAM_BUFFERS * MAX_WEATHER_FALLS * 2 * sizeof(RainVertex));
 
 		rainVAO.create();
 		rainVAO.bind();
 		rainVAO.vertexAttribPointer<vec3>(VATTRIB_POS, false, sizeof(RainVertex), 0);
 		rainVAO.vertexAttribPointer<float>(VATTRIB_DIFFUSE, false, sizeof(RainVertex), sizeof(vec3));
 
-		snowVBO.create();
-		snowVBO.bind();
+		snowVBO.create(MAX_STREAM_BUFFERS * MAX_WEATHER_FALLS * sizeof(SnowVertex));
 
 		snowVAO.create();
 		snowVAO.bind();
@@ -255,52 +258,41 @@ namespace ShaderVars
 
 	void createSfxVAO()
 	{
-		const int vertexCount = 4;
-		SfxVertex* vertices = new SfxVertex[vertexCount];
+		// a segment per frame, each as many vertices as quadsIBO addresses
+		const uint32_t segmentSize = MAX_QUADS * 4 * sizeof(SfxParticleVertex);
+		particleVBO.create(MAX_STREAM_BUFFERS * segmentSize, segmentSize);
 
-		SfxVertex* v = vertices;
-
-		v->p = vec3(-0.5f, 0.5f, 0.0f);
-		v->t = vec2(0.0f, 1.0f);
-		v++;
-		v->p = vec3(0.5f, 0.5f, 0.0f);
-		v->t = vec2(1.0f, 1.0f);
-		v++;
-		v->p = vec3(0.5f, -0.5f, 0.0f);
-		v->t = vec2(1.0f, 0.0f);
-		v++;
-		v->p = vec3(-0.5f, -0.5f, 0.0f);
-		v->t = vec2(0.0f, 0.0f);
-
-		sfxVBO.create();
-		sfxVBO.data(vertexCount * sizeof(SfxVertex), vertices);
-		delete[] vertices;
-
-		sfxVAO.create();
-		sfxVAO.bind();
-		sfxVAO.vertexAttribPointer<vec3>(VATTRIB_POS, false, sizeof(SfxVertex), 0);
-		sfxVAO.vertexAttribPointer<vec2>(VATTRIB_TEXCOORD0, false, sizeof(SfxVertex), sizeof(vec3));
-
-		customSfxVBO.create();
-		customSfxVBO.bind();
-
-		customSfxVAO.create();
-		customSfxVAO.bind();
-		customSfxVAO.vertexAttribPointer<vec3>(VATTRIB_POS, false, sizeof(SfxVertex), 0);
-		customSfxVAO.vertexAttribPointer<vec2>(VATTRIB_TEXCOORD0, false, sizeof(SfxVertex), sizeof(vec3));
+		for (int i = 0; i < MAX_STREAM_BUFFERS; i++)
+		{
+			gl::VertexArray& VAO = particleVAO[i];
+			const uint32_t base = i * segmentSize;
+
+			VAO.create();
+			VAO.bind();
+			quadsIBO.bind(VAO);
+			VAO.vertexAttribPointer<vec3>(VATTRIB_POS, false, sizeof(SfxParticleVertex), base);
+			VAO.vertexAttribPointer<vec2>(VATTRIB_TEXCOORD0, false, sizeof(SfxParticleVertex), base + sizeof(vec3));
+			VAO.vertexAttribPointer<float>(VATTRIB_DIFFUSE, false, sizeof(SfxParticleVertex), base + sizeof(vec3) + sizeof(vec2));
+		}
 	}
 
 	void createRender2dVAO()
 	{
-		render2dVBO.create();
-		render2dVBO.bind();
-
-		render2dVAO.create();
-		render2dVAO.bind();
-		quadsIBO.bind(render2dVAO);
-		render2dVAO.vertexAttribPointer<vec2>(VATTRIB_POS, false, sizeof(Vertex2D), 0);
-		render2dVAO.vertexAttribPointer<vec2>(VATTRIB_TEXCOORD0, false, sizeof(Vertex2D), sizeof(vec2));
-		render2dVAO.vertexAttribPointer<u8vec4>(VATTRIB_DIFFUSE, true, sizeof(Vertex2D), sizeof(vec2) * 2);
+		const uint32_t segmentSize = MAX_QUADS * 4 * sizeof(Vertex2D);
+		render2dVBO.create(MAX_STREAM_BUFFERS * segmentSize, segmentSize);
+
+		for (int i = 0; i < MAX_STREAM_BUFFERS; i++)
+		{
+			gl::VertexArray& VAO = render2dVAO[i];
+			const uint32_t base = i * segmentSize;
+
+			VAO.create();
+			VAO.bind();
+			quadsIBO.bind(VAO);
+			VAO.vertexAttribPointer<vec2>(VATTRIB_POS, false, sizeof(Vertex2D), base);
+			VAO.vertexAttribPointer<vec2>(VATTRIB_TEXCOORD0, false, sizeof(Vertex2D), base + sizeof(vec2));
+			VAO.vertexAttribPointer<u8vec4>(VATTRIB_DIFFUSE, true, sizeof(Vertex2D), base + sizeof(vec2) * 2);
+		}
 	}
 
 	void initAll()
@@ -316,8 +308,13 @@ namespace ShaderVars
 	void releaseAll()
 	{
 		blankTexture.destroy();
-		skyboxVAO.destroy(); sfxVAO.destroy(); rainVAO.destroy(); snowVAO.destroy(); render2dVAO.destroy(); sunVAO.destroy(); customSfxVAO.destroy();
+		skyboxVAO.destroy(); rainVAO.destroy(); snowVAO.destroy(); sunVAO.destroy();
+		for (int i = 0; i < MAX_STREAM_BUFFERS; i++)
+		{
+			particleVAO[i].destroy();
+			render2dVAO[i].destroy();
+		}
 		terrainIBO.destroy(); quadsIBO.destroy();
-		skyboxVBO.destroy(); sfxVBO.destroy(); rainVBO.destroy(); snowVBO.destroy(); render2dVBO.destroy(); sunVBO.destroy(); customSfxVBO.destroy();
+		skyboxVBO.destroy(); particleVBO.destroy(); rainVBO.destroy(); snowVBO.destroy(); render2dVBO.destroy(); sunVBO.destroy();
 	}
 }
\ No newline at end of file
@@ -1,7 +1,10 @@
 #pragma once
 
-#define MAX_SHADER_BONES 28
+// frames of dynamic vertices held by each stream ring before it wraps
 #define MAX_STREAM_BUFFERS 4
+// quads addressable by quadsIBO, bounded by the 16 bit indices
+#define MAX_QUADS 16384
+#define MAX_WEATHER_FALLS 300
 
 namespace ShaderVars
 {
@@ -13,7 +16,10 @@ namespace ShaderVars
 	extern vec3 cameraDir;
 	extern int MPU;
 	extern vec3 fogColor;
+	extern vec2 fogSettings;
 	extern vec3 lightDir;
+	extern vec3 ambient;
+	extern vec3 diffuse;
 	extern float sunAngle;
 	extern mat4 viewProj;
 	extern vec3 playerPos;
@@ -25,9 +31,12 @@ namespace ShaderVars
 
 	// set by the app
 	extern gl::Texture2D blankTexture;
-	extern gl::VertexArray skyboxVAO, sfxVAO, rainVAO, snowVAO, render2dVAO, sunVAO, customSfxVAO;
+	extern gl::VertexArray skyboxVAO, rainVAO, snowVAO, sunVAO;
+	// one per segment of the quad rings, so quadsIBO addresses the segment from its start
+	extern gl::VertexArray particleVAO[MAX_STREAM_BUFFERS], render2dVAO[MAX_STREAM_BUFFERS];
 	extern gl::IndexBuffer terrainIBO, quadsIBO;
-	extern gl::VertexBuffer skyboxVBO, sfxVBO, rainVBO, snowVBO, render2dVBO, sunVBO, customSfxVBO;
+	extern gl::VertexBuffer skyboxVBO;
+	extern gl::StreamBuffer particleVBO, rainVBO, snowVBO, render2dVBO, sunVBO;
 
 	void initAll();
 	void releaseAll();
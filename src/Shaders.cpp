@@ -1,5 +1,7 @@
 #include "StdAfx.hpp"
 #include "Shaders.hpp"
+#include "Motion.hpp"
+#include "Stats.hpp"
 
 #define FRAGMENT_PRECISION "mediump"
 
@@ -8,19 +10,29 @@ namespace Shaders
 	namespace
 	{
 		gl::FragmentShader s_terrainFragment, s_waterFragment, s_cloudFragment, s_skyboxFragment,
-			s_objectFragment, s_sfxFragment, s_rainFragment, s_snowFragment, s_render2dFragment;
+			s_particleFragment, s_rainFragment, s_snowFragment, s_render2dFragment;
 
 		gl::VertexShader s_terrainVertex, s_waterVertex, s_cloudVertex, s_skyboxVertex,
-			s_objectVertex, s_skinVertex, s_sfxVertex, s_rainVertex, s_snowVertex, s_render2dVertex;
+			s_particleVertex, s_rainVertex, s_snowVertex, s_render2dVertex;
+
+		struct ObjectVariant
+		{
+			gl::FragmentShader fragment;
+			gl::VertexShader vertex;
+			ObjectProgram program;
+		};
+
+		ObjectVariant* s_objectVariants[MAX_OBJECT_VARIANTS];
+
+		const vec4* s_skinPalette = nullptr;
+		int s_skinPaletteSize = 0;
 	}
 
 	TerrainProgram terrain;
 	WaterProgram water;
 	CloudProgram cloud;
 	SkyboxProgram skybox;
-	ObjectProgram object;
-	SkinProgram skin;
-	SfxProgram sfx;
+	ParticleProgram particle;
 	RainProgram rain;
 	SnowProgram snow;
 	Render2DProgram render2d;
@@ -83,19 +95,17 @@ namespace Shaders
 
 		terrain.link(&s_terrainFragment, &s_terrainVertex, attribs);
 
-		terrain.uWVP = terrain.location("uWVP");
-		terrain.uLightMapOffset = terrain.location("uLightMapOffset");
-		terrain.uCameraPos = terrain.location("uCameraPos");
-		terrain.uFogSettings = terrain.location("uFogSettings");
-		terrain.uFogColor = terrain.location("uFogColor");
-		terrain.uAmbient = terrain.location("uAmbient");
-		terrain.uDiffuse = terrain.location("uDiffuse");
-		terrain.uLightDir = terrain.location("uLightDir");
-
-		terrain.use();
-
-		gl::uniform(terrain.location("sTerrain"), 0);
-		gl::uniform(terrain.location("sLightMap"), 1);
+		terrain.bindLocation(terrain.uWVP, "uWVP");
+		terrain.bindLocation(terrain.uLightMapOffset, "uLightMapOffset");
+		terrain.bindLocation(terrain.uCameraPos, "uCameraPos");
+		terrain.bindLocation(terrain.uFogSettings, "uFogSettings");
+		terrain.bindLocation(terrain.uFogColor, "uFogColor");
+		terrain.bindLocation(terrain.uAmbient, "uAmbient");
+		terrain.bindLocation(terrain.uDiffuse, "uDiffuse");
+		terrain.bindLocation(terrain.uLightDir, "uLightDir");
+
+		terrain.bindSampler("sTerrain", 0);
+		terrain.bindSampler("sLightMap", 1);
 	}
 
 	void createWaterProgram()
@@ -146,11 +156,11 @@ namespace Shaders
 
 		water.link(&s_waterFragment, &s_waterVertex, attribs);
 
-		water.uWVP = water.location("uWVP");
-		water.uTextureOffset = water.location("uTextureOffset");
-		water.uCameraPos = water.location("uCameraPos");
-		water.uFogSettings = water.location("uFogSettings");
-		water.uFogColor = water.location("uFogColor");
+		water.bindLocation(water.uWVP, "uWVP");
+		water.bindLocation(water.uTextureOffset, "uTextureOffset");
+		water.bindLocation(water.uCameraPos, "uCameraPos");
+		water.bindLocation(water.uFogSettings, "uFogSettings");
+		water.bindLocation(water.uFogColor, "uFogColor");
 	}
 
 	void createCloudProgram()
@@ -199,12 +209,12 @@ namespace Shaders
 
 		cloud.link(&s_cloudFragment, &s_cloudVertex, attribs);
 
-		cloud.uWVP = cloud.location("uWVP");
-		cloud.uTextureOffset = cloud.location("uTextureOffset");
-		cloud.uCameraPos = cloud.location("uCameraPos");
-		cloud.uFogSettings = cloud.location("uFogSettings");
-		cloud.uFogColor = cloud.location("uFogColor");
-		cloud.uHeightOffset = cloud.location("uHeightOffset");
+		cloud.bindLocation(cloud.uWVP, "uWVP");
+		cloud.bindLocation(cloud.uTextureOffset, "uTextureOffset");
+		cloud.bindLocation(cloud.uCameraPos, "uCameraPos");
+		cloud.bindLocation(cloud.uFogSettings, "uFogSettings");
+		cloud.bindLocation(cloud.uFogColor, "uFogColor");
+		cloud.bindLocation(cloud.uHeightOffset, "uHeightOffset");
 	}
 
 	void createSkyboxProgram()
@@ -249,177 +259,213 @@ namespace Shaders
 
 		skybox.link(&s_skyboxFragment, &s_skyboxVertex, attribs);
 
-		skybox.uWVP = skybox.location("uWVP");
-		skybox.uTextureOffset = skybox.location("uTextureOffset");
-		skybox.uAlphaFactor = skybox.location("uAlphaFactor");
+		skybox.bindLocation(skybox.uWVP, "uWVP");
+		skybox.bindLocation(skybox.uTextureOffset, "uTextureOffset");
+		skybox.bindLocation(skybox.uAlphaFactor, "uAlphaFactor");
 	}
 
-	void createObjectProgram()
+	void createObjectVariant(ObjectVariant& variant, int features)
 	{
-		s_objectVertex.setSource(
+		string defines;
+		if (features & ObjectFog)
+			defines += "#define FOG\n";
+		if (features & ObjectLighting)
+			defines += "#define LIGHTING\n";
+		if (features & ObjectSkin)
+			defines += "#define SKIN\n";
+		if (features & ObjectAlphaTest)
+			defines += "#define ALPHA_TEST\n";
+
+		variant.vertex.setSource(defines +
 			"attribute vec3 aPos;" \
 			"attribute vec3 aNormal;" \
 			"attribute vec2 aTexCoord0;" \
 
 			"varying vec2 vTexCoord0;" \
-			"varying float vFogFactor;" \
-			"varying vec3 vLightColor;" \
 
-			"uniform mat4 uWVP;" \
+			"uniform mat4 uViewProj;" \
 			"uniform mat4 uWorld;" \
-			"uniform vec3 uCameraPos;" \
-			"uniform vec2 uFogSettings;" \
-			"uniform vec3 uAmbient;" \
-			"uniform vec3 uDiffuse;" \
-			"uniform vec3 uLightDir;" \
-			"uniform bvec3 uEffects;" \
-
-			"void main(void) {" \
-			"	gl_Position = uWVP * vec4(aPos, 1.0);" \
-			"	vTexCoord0 = aTexCoord0;" \
-			"	vFogFactor = uEffects.x ? clamp((uFogSettings.x - length(uCameraPos - (uWorld * vec4(aPos, 1.0)).xyz)) * uFogSettings.y, 0.0, 1.0) : 1.0;" \
-			"	vLightColor = uEffects.y ? clamp(uAmbient + uDiffuse * max(dot(normalize((uWorld * vec4(aNormal, 1.0)).xyz), uLightDir), 0.0), 0.0, 1.0) : vec3(1.0);" \
-			"}"
-		);
 
-		s_skinVertex.setSource(
-			"attribute vec3 aPos;" \
-			"attribute vec3 aNormal;" \
-			"attribute vec2 aTexCoord0;" \
+			"\n#ifdef SKIN\n" \
 			"attribute vec2 aWeight;" \
 			"attribute vec2 aBoneId;" \
 
-			"varying vec2 vTexCoord0;" \
+			"uniform vec4 uBones[" M_TOSTRING(MAX_SHADER_BONES) " * 3];" \
+
+			"vec3 skin(vec4 v, float boneId) {" \
+			"	int i = int(boneId) * 3;" \
+			"	return vec3(dot(uBones[i], v), dot(uBones[i + 1], v), dot(uBones[i + 2], v));" \
+			"}" \
+			"\n#endif\n" \
+
+			"\n#ifdef FOG\n" \
 			"varying float vFogFactor;" \
-			"varying vec3 vLightColor;" \
 
-			"uniform mat4 uWVP;" \
-			"uniform mat4 uWorld;" \
 			"uniform vec3 uCameraPos;" \
 			"uniform vec2 uFogSettings;" \
+			"\n#endif\n" \
+
+			"\n#ifdef LIGHTING\n" \
+			"varying vec3 vLightColor;" \
+
 			"uniform vec3 uAmbient;" \
 			"uniform vec3 uDiffuse;" \
 			"uniform vec3 uLightDir;" \
-			"uniform bvec3 uEffects;" \
-			"uniform mat4 uBones[" M_TOSTRING(MAX_SHADER_BONES) "];" \
+			"\n#endif\n" \
 
 			"void main(void) {" \
-			"	vec4 pos = uBones[int(aBoneId.x)] * vec4(aPos, 1.0) * aWeight.x" \
-			"		+ uBones[int(aBoneId.y)] * vec4(aPos, 1.0) * aWeight.y;" \
-			"	pos.w = 1.0;" \
+			"\n#ifdef SKIN\n" \
+			"	vec4 pos = vec4(skin(vec4(aPos, 1.0), aBoneId.x) * aWeight.x" \
+			"		+ skin(vec4(aPos, 1.0), aBoneId.y) * aWeight.y, 1.0);" \
+
+			"	vec4 normal = vec4(normalize(skin(vec4(aNormal, 1.0), aBoneId.x) * aWeight.x" \
+			"		+ skin(vec4(aNormal, 1.0), aBoneId.y) * aWeight.y), 1.0);" \
+			"\n#else\n" \
+			"	vec4 pos = vec4(aPos, 1.0);" \
+			"	vec4 normal = vec4(aNormal, 1.0);" \
+			"\n#endif\n" \
+
+			"	vec4 worldPos = uWorld * pos;" \
+			"	gl_Position = uViewProj * worldPos;" \
+			"	vTexCoord0 = aTexCoord0;" \
 
-			"	vec4 normal = uBones[int(aBoneId.x)] * vec4(aNormal, 1.0) * aWeight.x" \
-			"		+ uBones[int(aBoneId.y)] * vec4(aNormal, 1.0) * aWeight.y;" \
-			"	normal = vec4(normalize(normal.xyz), 1.0);" \
+			"\n#ifdef FOG\n" \
+			"	vFogFactor = clamp((uFogSettings.x - length(uCameraPos - worldPos.xyz)) * uFogSettings.y, 0.0, 1.0);" \
+			"\n#endif\n" \
 
-			"	gl_Position = uWVP * pos;" \
-			"	vTexCoord0 = aTexCoord0;" \
-			"	vFogFactor = uEffects.x ? clamp((uFogSettings.x - length(uCameraPos - (uWorld * pos).xyz)) * uFogSettings.y, 0.0, 1.0) : 1.0;" \
-			"	vLightColor = uEffects.y ? clamp(uAmbient + uDiffuse * max(dot(normalize((uWorld * normal).xyz), uLightDir), 0.0), 0.0, 1.0) : vec3(1.0);" \
+			"\n#ifdef LIGHTING\n" \
+			"	vLightColor = clamp(uAmbient + uDiffuse * max(dot(normalize((uWorld * normal).xyz), uLightDir), 0.0), 0.0, 1.0);" \
+			"\n#endif\n" \
 			"}"
 		);
 
-		s_objectFragment.setSource(
+		variant.fragment.setSource(defines +
 			"precision " FRAGMENT_PRECISION " float;" \
 
 			"varying vec2 vTexCoord0;" \
+
+			"uniform sampler2D sTexture;" \
+
+			"\n#ifdef FOG\n" \
 			"varying float vFogFactor;" \
-			"varying vec3 vLightColor;" \
 
 			"uniform vec3 uFogColor;" \
-			"uniform sampler2D sTexture;" \
-			"uniform bvec3 uEffects;" \
+			"\n#endif\n" \
+
+			"\n#ifdef LIGHTING\n" \
+			"varying vec3 vLightColor;" \
+			"\n#endif\n" \
 
 			"void main(void) {" \
 			"	vec4 color = texture2D(sTexture, vTexCoord0);" \
-			"	if(color.a < 0.69) discard;" \
-			"	gl_FragColor = vec4(mix(uFogColor, color.rgb * vLightColor, vFogFactor), color.a);" \
-			"}"
-		);
 
-		const GLuint normalAttribs[] = {
-			VATTRIB_POS,
-			VATTRIB_NORMAL,
-			VATTRIB_TEXCOORD0
-		};
-
-		object.link(&s_objectFragment, &s_objectVertex, normalAttribs);
-
-		object.uWVP = object.location("uWVP");
-		object.uCameraPos = object.location("uCameraPos");
-		object.uFogSettings = object.location("uFogSettings");
-		object.uFogColor = object.location("uFogColor");
-		object.uWorld = object.location("uWorld");
-		object.uAmbient = object.location("uAmbient");
-		object.uDiffuse = object.location("uDiffuse");
-		object.uLightDir = object.location("uLightDir");
-		object.uEffects = object.location("uEffects");
+			"\n#ifdef ALPHA_TEST\n" \
+			"	if(color.a < 0.69) discard;" \
+			"\n#endif\n" \
 
-		object.curEffects = ivec3(false, false, false);
+			"\n#ifdef LIGHTING\n" \
+			"	color.rgb *= vLightColor;" \
+			"\n#endif\n" \
 
-		const GLuint skinAttribs[] = {
-			VATTRIB_POS,
-			VATTRIB_WEIGHT,
-			VATTRIB_BONEID,
-			VATTRIB_NORMAL,
-			VATTRIB_TEXCOORD0
-		};
+			"\n#ifdef FOG\n" \
+			"	color.rgb = mix(uFogColor, color.rgb, vFogFactor);" \
+			"\n#endif\n" \
 
-		skin.link(&s_objectFragment, &s_skinVertex, skinAttribs);
+			"	gl_FragColor = color;" \
+			"}"
+		);
 
-		skin.uWVP = skin.location("uWVP");
-		skin.uCameraPos = skin.location("uCameraPos");
-		skin.uFogSettings = skin.location("uFogSettings");
-		skin.uFogColor = skin.location("uFogColor");
-		skin.uWorld = skin.location("uWorld");
-		skin.uAmbient = skin.location("uAmbient");
-		skin.uDiffuse = skin.location("uDiffuse");
-		skin.uLightDir = skin.location("uLightDir");
-		skin.uEffects = skin.location("uEffects");
-		skin.uBones = skin.location("uBones");
+		ObjectProgram& program = variant.program;
+
+		if (features & ObjectSkin)
+		{
+			const GLuint attribs[] = {
+				VATTRIB_POS,
+				VATTRIB_WEIGHT,
+				VATTRIB_BONEID,
+				VATTRIB_NORMAL,
+				VATTRIB_TEXCOORD0
+			};
+
+			program.link(&variant.fragment, &variant.vertex, attribs);
+		}
+		else
+		{
+			const GLuint attribs[] = {
+				VATTRIB_POS,
+				VATTRIB_NORMAL,
+				VATTRIB_TEXCOORD0
+			};
+
+			program.link(&variant.fragment, &variant.vertex, attribs);
+		}
+
+		program.bindLocation(program.uViewProj, "uViewProj");
+		program.bindLocation(program.uCameraPos, "uCameraPos");
+		program.bindLocation(program.uFogSettings, "uFogSettings");
+		program.bindLocation(program.uFogColor, "uFogColor");
+		program.bindLocation(program.uWorld, "uWorld");
+		program.bindLocation(program.uAmbient, "uAmbient");
+		program.bindLocation(program.uDiffuse, "uDiffuse");
+		program.bindLocation(program.uLightDir, "uLightDir");
+		program.bindLocation(program.uBones, "uBones");
+
+		Stats::add(Stats::ObjectVariants);
+	}
 
-		skin.curEffects = ivec3(false, false, false);
+	void setObjectConstants(ObjectProgram& program)
+	{
+		program.use();
+		gl::uniform(program.uViewProj, ShaderVars::viewProj);
+		gl::uniform(program.uCameraPos, ShaderVars::cameraPos);
+		gl::uniform(program.uFogSettings, ShaderVars::fogSettings);
+		gl::uniform(program.uFogColor, ShaderVars::fogColor);
+		gl::uniform(program.uAmbient, ShaderVars::ambient);
+		gl::uniform(program.uDiffuse, ShaderVars::diffuse);
+		gl::uniform(program.uLightDir, -ShaderVars::lightDir);
 	}
 
-	void createSfxProgram()
+	void createParticleProgram()
 	{
-		s_sfxVertex.setSource(
+		s_particleVertex.setSource(
 			"attribute vec3 aPos;" \
 			"attribute vec2 aTexCoord0;" \
+			"attribute float aDiffuse;" \
 
 			"varying vec2 vTexCoord0;" \
+			"varying float vAlpha;" \
 
 			"uniform mat4 uWVP;" \
 
 			"void main(void) {" \
 			"	gl_Position = uWVP * vec4(aPos, 1.0);" \
 			"	vTexCoord0 = aTexCoord0;" \
+			"	vAlpha = aDiffuse;" \
 			"}"
 		);
 
-		s_sfxFragment.setSource(
+		s_particleFragment.setSource(
 			"precision " FRAGMENT_PRECISION " float;" \
 
 			"varying vec2 vTexCoord0;" \
+			"varying float vAlpha;" \
 
-			"uniform float uAlphaFactor;" \
 			"uniform sampler2D sTexture;" \
 
 			"void main(void) {" \
-			"	gl_FragColor = texture2D(sTexture, vTexCoord0) * vec4(1, 1, 1, uAlphaFactor);" \
+			"	gl_FragColor = texture2D(sTexture, vTexCoord0) * vec4(1, 1, 1, vAlpha);" \
 			"}"
 		);
 
 		const GLuint attribs[] = {
 			VATTRIB_POS,
-			VATTRIB_TEXCOORD0
+			VATTRIB_TEXCOORD0,
+			VATTRIB_DIFFUSE
 		};
 
-		sfx.link(&s_sfxFragment, &s_sfxVertex, attribs);
+		particle.link(&s_particleFragment, &s_particleVertex, attribs);
 
-		sfx.uWVP = sfx.location("uWVP");
-		sfx.uAlphaFactor = sfx.location("uAlphaFactor");
-		sfx.alphaFactor = 0.0f;
+		particle.bindLocation(particle.uWVP, "uWVP");
 	}
 
 	void createRainProgram()
@@ -455,7 +501,7 @@ namespace Shaders
 
 		rain.link(&s_rainFragment, &s_rainVertex, attribs);
 
-		rain.uWVP = rain.location("uWVP");
+		rain.bindLocation(rain.uWVP, "uWVP");
 	}
 
 	void createSnowProgram()
@@ -488,9 +534,9 @@ namespace Shaders
 
 		snow.link(&s_snowFragment, &s_snowVertex, attribs);
 
-		snow.uWVP = snow.location("uWVP");
-		snow.uSizeFactor = snow.location("uSizeFactor");
-		snow.uCameraPos = snow.location("uCameraPos");
+		snow.bindLocation(snow.uWVP, "uWVP");
+		snow.bindLocation(snow.uSizeFactor, "uSizeFactor");
+		snow.bindLocation(snow.uCameraPos, "uCameraPos");
 	}
 
 	void createRender2DProgram()
@@ -533,7 +579,7 @@ namespace Shaders
 
 		render2d.link(&s_render2dFragment, &s_render2dVertex, attribs);
 
-		render2d.uWVP = render2d.location("uWVP");
+		render2d.bindLocation(render2d.uWVP, "uWVP");
 	}
 
 	void createAll()
@@ -542,10 +588,137 @@ namespace Shaders
 		createWaterProgram();
 		createCloudProgram();
 		createSkyboxProgram();
-		createObjectProgram();
-		createSfxProgram();
+		createParticleProgram();
 		createRainProgram();
 		createSnowProgram();
 		createRender2DProgram();
 	}
+
+	void warmUp()
+	{
+		// lit and self illuminated blocks, with and without skin or alpha test
+		static const int features[] = {
+			ObjectFog | ObjectLighting,
+			ObjectFog | ObjectLighting | ObjectAlphaTest,
+			ObjectFog | ObjectLighting | ObjectSkin,
+			ObjectFog | ObjectLighting | ObjectSkin | ObjectAlphaTest,
+			ObjectFog
+		};
+
+		for (std::size_t i = 0; i < sizeof(features) / sizeof(int); i++)
+		{
+			ObjectVariant*& variant = s_objectVariants[features[i]];
+
+			if (!variant)
+			{
+				variant = new ObjectVariant();
+				createObjectVariant(*variant, features[i]);
+			}
+		}
+	}
+
+	bool finishPending()
+	{
+		gl::Program* const programs[] = {
+			&terrain, &water, &cloud, &skybox, &particle, &rain, &snow, &render2d
+		};
+
+		bool pending = false;
+
+		for (std::size_t i = 0; i < sizeof(programs) / sizeof(gl::Program*); i++)
+		{
+			if (!programs[i]->linking())
+				continue;
+
+			if (programs[i]->ready())
+				programs[i]->finishLink();
+			else
+				pending = true;
+		}
+
+		for (int i = 0; i < MAX_OBJECT_VARIANTS; i++)
+		{
+			ObjectVariant* const variant = s_objectVariants[i];
+			if (!variant || !variant->program.linking())
+				continue;
+
+			if (variant->program.ready())
+				variant->program.finishLink();
+			else
+				pending = true;
+		}
+
+		return !pending;
+	}
+
+	ObjectProgram& useObjectVariant(int features)
+	{
+		ObjectVariant*& variant = s_objectVariants[features];
+
+		if (!variant)
+		{
+			variant = new ObjectVariant();
+			createObjectVariant(*variant, features);
+		}
+
+		ObjectProgram& program = variant->program;
+
+		// the frame constants skipped it while it was linking
+		if (program.linking())
+			setObjectConstants(program);
+		else
+			program.use();
+
+		if ((features & ObjectSkin) && s_skinPalette)
+			gl::uniform(program.uBones, s_skinPaletteSize, s_skinPalette);
+
+		return program;
+	}
+
+	void setSkinPalette(const vec4* palette, int size)
+	{
+		s_skinPalette = palette;
+		s_skinPaletteSize = size;
+	}
+
+	void setFrameConstants()
+	{
+		const vec3 lightDir = -ShaderVars::lightDir;
+
+		terrain.use();
+		gl::uniform(terrain.uWVP, ShaderVars::viewProj);
+		gl::uniform(terrain.uCameraPos, ShaderVars::cameraPos);
+		gl::uniform(terrain.uFogSettings, ShaderVars::fogSettings);
+		gl::uniform(terrain.uFogColor, ShaderVars::fogColor);
+		gl::uniform(terrain.uAmbient, ShaderVars::ambient);
+		gl::uniform(terrain.uDiffuse, ShaderVars::diffuse);
+		gl::uniform(terrain.uLightDir, lightDir);
+
+		water.use();
+		gl::uniform(water.uWVP, ShaderVars::viewProj);
+		gl::uniform(water.uCameraPos, ShaderVars::cameraPos);
+		gl::uniform(water.uFogSettings, ShaderVars::fogSettings);
+		gl::uniform(water.uFogColor, ShaderVars::fogColor);
+
+		cloud.use();
+		gl::uniform(cloud.uWVP, ShaderVars::viewProj);
+		gl::uniform(cloud.uCameraPos, ShaderVars::cameraPos);
+		gl::uniform(cloud.uFogSettings, ShaderVars::fogSettings);
+		gl::uniform(cloud.uFogColor, ShaderVars::fogColor);
+
+		// variants still linking in the background get them on first use
+		for (int i = 0; i < MAX_OBJECT_VARIANTS; i++)
+			if (s_objectVariants[i] && !s_objectVariants[i]->program.linking())
+				setObjectConstants(s_objectVariants[i]->program);
+
+		particle.use();
+		gl::uniform(particle.uWVP, ShaderVars::viewProj);
+
+		rain.use();
+		gl::uniform(rain.uWVP, ShaderVars::viewProj);
+
+		snow.use();
+		gl::uniform(snow.uWVP, ShaderVars::viewProj);
+		gl::uniform(snow.uCameraPos, ShaderVars::cameraPos);
+	}
 }
\ No newline at end of file
@@ -32,21 +32,23 @@ namespace Shaders
 	class ObjectProgram : public gl::Program
 	{
 	public:
-		int uWVP, uCameraPos, uFogSettings, uFogColor, uWorld, uAmbient, uDiffuse, uLightDir, uEffects;
-		ivec3 curEffects;
+		int uViewProj, uCameraPos, uFogSettings, uFogColor, uWorld, uAmbient, uDiffuse, uLightDir, uBones;
 	};
 
-	class SkinProgram : public ObjectProgram
+	// object program variants, each feature is a #define of the shared source
+	enum ObjectFeature
 	{
-	public:
-		int uBones;
+		ObjectFog = 1 << 0,
+		ObjectLighting = 1 << 1,
+		ObjectSkin = 1 << 2,
+		ObjectAlphaTest = 1 << 3,
+		MAX_OBJECT_VARIANTS = 1 << 4
 	};
 
-	class SfxProgram : public gl::Program
+	class ParticleProgram : public gl::Program
 	{
 	public:
-		int uWVP, uAlphaFactor;
-		float alphaFactor;
+		int uWVP;
 	};
 
 	class RainProgram : public gl::Program
@@ -71,12 +73,23 @@ namespace Shaders
 	extern WaterProgram water;
 	extern CloudProgram cloud;
 	extern SkyboxProgram skybox;
-	extern ObjectProgram object;
-	extern SkinProgram skin;
-	extern SfxProgram sfx;
+	extern ParticleProgram particle;
 	extern RainProgram rain;
 	extern SnowProgram snow;
 	extern Render2DProgram render2d;
 
+	// compiles and links without waiting, the status of each program is resolved on first use
 	void createAll();
+	// queues the common object variants so they link behind the loading screen
+	void warmUp();
+	// resolves the programs the driver finished linking, true once none is pending
+	bool finishPending();
+
+	// the variant is compiled on first use, skin variants get the palette of setSkinPalette
+	ObjectProgram& useObjectVariant(int features);
+	// null until the next skinned mesh, the palette has to stay valid until then
+	void setSkinPalette(const vec4* palette, int size);
+
+	// view, camera, fog and light uniforms shared by the world programs, once per frame
+	void setFrameConstants();
 }
\ No newline at end of file
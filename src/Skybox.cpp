@@ -80,9 +80,17 @@ void Skybox::update(int frameCount)
 						rot = degrees(m_world->getLandRot(pos.x, pos.z));
 					}
 
-					Sfx* rainCircle = Sfx::create(m_world, XI_GEN_RAINCIRCLE01, pos);
-					rainCircle->setScale(vec3(scale));
-					rainCircle->setRot(rot);
+					if (Config::sharedSfx)
+						m_world->spawnSfx(XI_GEN_RAINCIRCLE01, pos, rot, vec3(scale));
+					else
+					{
+						Sfx* rainCircle = Sfx::create(m_world, XI_GEN_RAINCIRCLE01, pos);
+						if (rainCircle)
+						{
+							rainCircle->setScale(vec3(scale));
+							rainCircle->setRot(rot);
+						}
+					}
 				}
 
 				fall.pos = vec3(
@@ -108,20 +116,10 @@ void Skybox::updateView()
 	Shaders::skybox.use();
 	gl::uniform(Shaders::skybox.uWVP, WVP);
 
-	if (Config::weatherEffects)
+	if (Config::weatherEffects && m_weather == WEATHER_SNOW)
 	{
-		if (m_weather == WEATHER_RAIN)
-		{
-			Shaders::rain.use();
-			gl::uniform(Shaders::rain.uWVP, ShaderVars::viewProj);
-		}
-		else if (m_weather == WEATHER_SNOW)
-		{
-			Shaders::snow.use();
-			gl::uniform(Shaders::snow.uWVP, ShaderVars::viewProj);
-			gl::uniform(Shaders::snow.uCameraPos, ShaderVars::cameraPos);
-			gl::uniform(Shaders::snow.uSizeFactor, ShaderVars::pixelRatio);
-		}
+		Shaders::snow.use();
+		gl::uniform(Shaders::snow.uSizeFactor, ShaderVars::pixelRatio);
 	}
 }
 
@@ -147,24 +145,14 @@ void Skybox::initWeather()
 
 	if (m_weather == WEATHER_RAIN || m_weather == WEATHER_SNOW)
 	{
-		m_fallCount = 300;
+		m_fallCount = MAX_WEATHER_FALLS;
 		m_falls = new Fall[m_fallCount];
 
 		if (m_weather == WEATHER_RAIN)
-		{
 			m_rainVertices = new RainVertex[m_fallCount * 2];
-
-			Shaders::rain.use();
-			gl::uniform(Shaders::rain.uWVP, ShaderVars::viewProj);
-		}
 		else if (m_weather == WEATHER_SNOW)
-		{
 			m_snowVertices = new SnowVertex[m_fallCount];
 
-			Shaders::snow.use();
-			gl::uniform(Shaders::snow.uWVP, ShaderVars::viewProj);
-		}
-
 		for (int i = 0; i < m_fallCount; i++)
 		{
 			Fall& fall = m_falls[i];
@@ -209,11 +197,11 @@ void Skybox::renderWeather()
 		Shaders::rain.use();
 
 		ShaderVars::rainVAO.bind();
-		ShaderVars::rainVBO.data(m_fallCount * 2 * sizeof(RainVertex), m_rainVertices, true);
+		const GLintptr offset = ShaderVars::rainVBO.write(m_rainVertices, m_fallCount * 2 * sizeof(RainVertex), sizeof(RainVertex));
 
 		gl::lineWidth(ceil(ShaderVars::pixelRatio));
 
-		gl::drawArrays(GL_LINES, 0, m_fallCount * 2);
+		gl::drawArrays(GL_LINES, gl::StreamBuffer::first(offset, sizeof(RainVertex)), m_fallCount * 2);
 	}
 	else if (m_weather == WEATHER_SNOW)
 	{
@@ -223,9 +211,9 @@ void Skybox::renderWeather()
 		Shaders::snow.use();
 
 		ShaderVars::snowVAO.bind();
-		ShaderVars::snowVBO.data(m_fallCount * sizeof(SnowVertex), m_snowVertices, true);
+		const GLintptr offset = ShaderVars::snowVBO.write(m_snowVertices, m_fallCount * sizeof(SnowVertex), sizeof(SnowVertex));
 
-		gl::drawArrays(GL_POINTS, 0, m_fallCount);
+		gl::drawArrays(GL_POINTS, gl::StreamBuffer::first(offset, sizeof(SnowVertex)), m_fallCount);
 	}
 }
 
@@ -398,10 +386,8 @@ void Skybox::render()
 		}
 
 		ShaderVars::sunVAO.bind();
+		const GLintptr offset = ShaderVars::sunVBO.write(&vertices, sizeof(vertices), sizeof(SkyboxVertex));
 
-		ShaderVars::sunVBO.bind();
-		ShaderVars::sunVBO.data(sizeof(vertices), &vertices, true);
-
-		gl::drawArrays(GL_TRIANGLE_FAN, 0, 4);
+		gl::drawArrays(GL_TRIANGLE_FAN, gl::StreamBuffer::first(offset, sizeof(SkyboxVertex)), 4);
 	}
 }
\ No newline at end of file
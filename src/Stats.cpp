@@ -0,0 +1,136 @@
+#include "StdAfx.hpp"
+#include "Stats.hpp"
+
+namespace Stats
+{
+	namespace
+	{
+		const char* const s_names[MAX_COUNTER] = {
+			"collisionBuildCount",
+			"collisionBuildTime",
+			"collisionNodeCount",
+			"collisionQueryCount",
+			"collisionQueryTime",
+			"collisionTriangleTests",
+			"animatedObjectCount",
+			"animationUpdateTime",
+			"poseEvaluations",
+			"poseCacheHits",
+			"animatedBones",
+			"animationTime",
+			"motionKeysDecoded",
+			"animationThrottled",
+			"animationFrozen",
+			"sfxParticleCount",
+			"sfxParticleTime",
+			"sfxDrawCalls",
+			"sfxParticleSpawned",
+			"sfxParticleKilled",
+			"sfxParticleUpdateTime",
+			"sfxParticleBlockAllocs",
+			"sfxParticleDrops",
+			"sfxModelAllocs",
+			"sfxInstanceCount",
+			"sfxGroupUpdates",
+			"sfxUpdateTime",
+			"sfxKeyLookups",
+			"sfxKeySearches",
+			"sfxBatchedQuads",
+			"sfxTextureBinds",
+			"resourceRequests",
+			"streamedBytes",
+			"streamOrphans",
+			"uniformUploads",
+			"uniformSkips",
+			"shaderCompiles",
+			"objectVariants",
+			"programLinks",
+			"shaderStartupStallTime",
+			"shaderRestoreStallTime",
+			"contextRestoreTime",
+			"textureCacheBytes",
+			"textureCacheRestores",
+			"textureRestoreTime",
+			"contextRecoveryTime",
+			"resourceCacheHits",
+			"resourceCacheMisses",
+			"resourceCacheInvalid",
+			"resourceCacheBytes",
+			"resourceCacheWriteTime",
+			"startupTime",
+			"textureResidentBytes",
+			"textureUpgrades",
+			"textureDowngrades",
+			"textureEvictions",
+			"modelEvictions",
+			"cacheReleasedEntries",
+			"cacheResurrections",
+			"landscapeObjects",
+			"landscapeObjectTime",
+			"landscapeLoads",
+			"landscapeLoadTime",
+			"poolSlabAllocs",
+			"arenaChunks",
+			"arenaBytes",
+			"modelFileLoads",
+			"modelFileLoadTime",
+			"resourceInflateTime",
+			"packBytes",
+			"packReadsInPlace",
+			"zlibDecodeBytes",
+			"zlibDecodeTime",
+			"lz4DecodeBytes",
+			"lz4DecodeTime"
+		};
+
+		double s_total[MAX_COUNTER];
+		double s_current[MAX_COUNTER];
+		double s_frame[MAX_COUNTER];
+	}
+
+	void add(Counter counter, double value)
+	{
+		s_total[counter] += value;
+		s_current[counter] += value;
+	}
+
+	double total(Counter counter)
+	{
+		return s_total[counter];
+	}
+
+	double frame(Counter counter)
+	{
+		return s_frame[counter];
+	}
+
+	void endFrame()
+	{
+		for (int i = 0; i < MAX_COUNTER; i++)
+		{
+			s_frame[i] = s_current[i];
+			s_current[i] = 0.0;
+		}
+	}
+
+	string dump()
+	{
+		string ret = "{";
+		char buffer[128];
+
+		for (int i = 0; i < MAX_COUNTER; i++)
+		{
+			sprintf(buffer, "%s\"%s\":{\"total\":%.3f,\"frame\":%.3f}", i ? "," : "", s_names[i], s_total[i], s_frame[i]);
+			ret += buffer;
+		}
+
+		ret += "}";
+		return ret;
+	}
+}
+extern "C" EMSCRIPTEN_KEEPALIVE const char* getStats()
+{
+	static string s_dump;
+	s_dump = Stats::dump();
+	return s_dump.c_str();
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+namespace Stats
+{
+	enum Counter
+	{
+		CollisionBuildCount,
+		CollisionBuildTime,
+		CollisionNodeCount,
+		CollisionQueryCount,
+		CollisionQueryTime,
+		CollisionTriangleTests,
+		AnimatedObjectCount,
+		AnimationUpdateTime,
+		PoseEvaluations,
+		PoseCacheHits,
+		AnimatedBones,
+		AnimationTime,
+		MotionKeysDecoded,
+		AnimationThrottled,
+		AnimationFrozen,
+		SfxParticleCount,
+		SfxParticleTime,
+		SfxDrawCalls,
+		SfxParticleSpawned,
+		SfxParticleKilled,
+		SfxParticleUpdateTime,
+		SfxParticleBlockAllocs,
+		SfxParticleDrops,
+		SfxModelAllocs,
+		SfxInstanceCount,
+		SfxGroupUpdates,
+		SfxUpdateTime,
+		SfxKeyLookups,
+		SfxKeySearches,
+		SfxBatchedQuads,
+		SfxTextureBinds,
+		ResourceRequests,
+		StreamedBytes,
+		StreamOrphans,
+		UniformUploads,
+		UniformSkips,
+		ShaderCompiles,
+		ObjectVariants,
+		ProgramLinks,
+		ShaderStartupStallTime,
+		ShaderRestoreStallTime,
+		ContextRestoreTime,
+		TextureCacheBytes,
+		TextureCacheRestores,
+		TextureRestoreTime,
+		ContextRecoveryTime,
+		ResourceCacheHits,
+		ResourceCacheMisses,
+		ResourceCacheInvalid,
+		ResourceCacheBytes,
+		ResourceCacheWriteTime,
+		StartupTime,
+		TextureResidentBytes,
+		TextureUpgrades,
+		TextureDowngrades,
+		TextureEvictions,
+		ModelEvictions,
+		CacheReleasedEntries,
+		CacheResurrections,
+		LandscapeObjects,
+		LandscapeObjectTime,
+		LandscapeLoads,
+		LandscapeLoadTime,
+		PoolSlabAllocs,
+		ArenaChunks,
+		ArenaBytes,
+		ModelFileLoads,
+		ModelFileLoadTime,
+		ResourceInflateTime,
+		PackBytes,
+		PackReadsInPlace,
+		ZlibDecodeBytes,
+		ZlibDecodeTime,
+		LZ4DecodeBytes,
+		LZ4DecodeTime,
+		MAX_COUNTER
+	};
+
+	void add(Counter counter, double value = 1.0);
+
+	// accumulated since startup
+	double total(Counter counter);
+
+	// accumulated during the last complete frame
+	double frame(Counter counter);
+
+	void endFrame();
+
+	string dump();
+
+	// timings read the clock on hot paths so they are only taken in builds
+	// with FOREVER_STATS defined, the time counters stay at 0 otherwise
+	inline double now()
+	{
+#if defined(FOREVER_STATS)
+		return emscripten_get_now();
+#else
+		return 0.0;
+#endif
+	}
+
+	class Timer
+	{
+	public:
+#if defined(FOREVER_STATS)
+		explicit Timer(Counter counter)
+			: m_counter(counter),
+			m_start(emscripten_get_now())
+		{
+		}
+
+		~Timer()
+		{
+			add(m_counter, emscripten_get_now() - m_start);
+		}
+
+	private:
+		const Counter m_counter;
+		const double m_start;
+#else
+		explicit Timer(Counter counter)
+		{
+		}
+#endif
+
+	private:
+		Timer(const Timer&) = delete;
+		Timer& operator=(const Timer&) = delete;
+	};
+}
\ No newline at end of file
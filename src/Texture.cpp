@@ -1,6 +1,30 @@
 #include "StdAfx.hpp"
 #include "Texture.hpp"
+#include "TextureCache.hpp"
+#include "ResourceCache.hpp"
+#include "Pack.hpp"
 #include "Config.hpp"
+#include "Stats.hpp"
+
+// downloads started by the streaming at once
+#define MAX_STREAMING_LOADS 4
+// side of the low_ tier textures, each tier doubles it, only picks the tier of the first load
+#define LOW_TIER_SIZE 128
+
+uint32_t Texture::s_frame = 0;
+float Texture::s_pixelsPerUnit = 0.0f;
+
+namespace
+{
+	vector<Texture*> s_streamed;
+	std::size_t s_residentBytes = 0;
+
+	const char* const s_tierDirs[] = {
+		"low_",
+		"mid_",
+		""
+	};
+}
 
 Texture::Texture(const string& dir, const string& name, uint32_t flags)
 	: m_minFilter(GL_NEAREST),
@@ -8,8 +32,18 @@ Texture::Texture(const string& dir, const string& name, uint32_t flags)
 	m_size(0, 0),
 	m_flags(flags),
 	m_dir(dir),
-	m_name(name)
+	m_name(name),
+	m_lastBind(0),
+	m_requestSize(0.0f),
+	m_tier(Config::textureQuality),
+	m_dropLevels(0),
+	m_levelCount(0),
+	m_residentBytes(0),
+	m_releaseBytes(0)
 {
+	if ((m_flags & QualityDependent) && Config::textureStreaming)
+		s_streamed.push_back(this);
+
 	if (gl::isContextActive())
 		onContextRestored();
 }
@@ -18,6 +52,10 @@ Texture::~Texture()
 {
 	if (gl::isContextActive())
 		onContextLost();
+
+	auto it = find(s_streamed.begin(), s_streamed.end(), this);
+	if (it != s_streamed.end())
+		s_streamed.erase(it);
 }
 
 void Texture::makeFilename()
@@ -29,12 +67,7 @@ void Texture::makeFilename()
 		dir += "texture_";
 
 		if (m_flags & QualityDependent)
-		{
-			if (Config::textureQuality == 0)
-				dir += "low_";
-			else if (Config::textureQuality == 1)
-				dir += "mid_";
-		}
+			dir += s_tierDirs[glm::clamp(m_tier, 0, 2)];
 
 		dir += "dxt/";
 	}
@@ -45,12 +78,159 @@ void Texture::makeFilename()
 void Texture::onContextLost()
 {
 	m_tex.destroy();
+
+	s_residentBytes -= m_residentBytes;
+	Stats::add(Stats::TextureResidentBytes, -(double)m_residentBytes);
+	m_residentBytes = 0;
 }
 
 void Texture::onContextRestored()
 {
+	// streamed textures are loaded by updateStreaming once bound, at the tier the bind asks for
+	if (loadState() == NotLoaded && m_requestSize == 0.0f && (m_flags & QualityDependent) && Config::textureStreaming)
+		return;
+
 	makeFilename();
-	startLoad();
+
+	// uploaded again from memory by TextureCache::update, without a download
+	if (TextureCache::queueRestore(this))
+		setLoadState(Loading);
+	else
+		startLoad();
+}
+
+void Texture::restore(const vector<uint8_t>* payload)
+{
+	if (payload)
+		loadPayload(payload->data(), (int)payload->size());
+	else
+	{
+		setLoadState(NotLoaded);
+		startLoad();
+	}
+}
+
+void Texture::onDownload(const void* data, int size)
+{
+	TextureCache::insert(filename(), data, size);
+}
+
+void Texture::reload()
+{
+	makeFilename();
+	restore(TextureCache::find(filename()));
+}
+
+void Texture::updateStreaming()
+{
+	if (s_streamed.empty() || !gl::isContextActive())
+		return;
+
+	const std::size_t budget = (std::size_t)Config::textureBudget * 1024 * 1024;
+	int loading = 0;
+	std::size_t i;
+
+	// first bound since they were made, the lowest tier at one texel per pixel or more, never held back
+	for (i = 0; i < s_streamed.size(); i++)
+	{
+		Texture* const texture = s_streamed[i];
+
+		if (texture->loadState() == NotLoaded && texture->m_requestSize > 0.0f && !texture->m_levelCount)
+		{
+			texture->m_tier = 0;
+			while (texture->m_tier < Config::textureQuality && (float)(LOW_TIER_SIZE << texture->m_tier) < texture->m_requestSize)
+				texture->m_tier++;
+
+			texture->reload();
+		}
+	}
+
+	// textures dropping a mip keep the resident ones until their reload ends, what it frees is counted ahead
+	std::size_t releasing = 0;
+
+	for (i = 0; i < s_streamed.size(); i++)
+	{
+		if (s_streamed[i]->loadState() == Loading)
+		{
+			loading++;
+			releasing += s_streamed[i]->m_releaseBytes;
+		}
+	}
+
+	// bound during the last frame with fewer texels than pixels
+	for (i = 0; i < s_streamed.size() && loading < MAX_STREAMING_LOADS && s_residentBytes < budget; i++)
+	{
+		Texture* const texture = s_streamed[i];
+
+		if (texture->loadState() != Loaded
+			|| texture->m_lastBind + 1 < s_frame
+			|| texture->texelsPerPixel() >= 1.0f)
+			continue;
+
+		if (texture->m_dropLevels > 0)
+			texture->m_dropLevels--;
+		else if (texture->m_tier < Config::textureQuality)
+			texture->m_tier++;
+		else
+			continue;
+
+		texture->reload();
+		Stats::add(Stats::TextureUpgrades);
+
+		if (texture->loadState() == Loading)
+			loading++;
+	}
+
+	// the least recently bound texture loses its top mip, the ones drawn last frame are kept
+	// a download would not free anything before it ends, the other reloads are at most a few frames away
+	while (s_residentBytes > budget + releasing)
+	{
+		Texture* victim = nullptr;
+
+		for (i = 0; i < s_streamed.size(); i++)
+		{
+			Texture* const texture = s_streamed[i];
+
+			if (texture->loadState() != Loaded
+				|| texture->m_levelCount - texture->m_dropLevels <= 1
+				|| texture->m_lastBind + 1 >= s_frame
+				|| !texture->canDropLevel()
+				|| !texture->canReload())
+				continue;
+
+			if (!victim || texture->m_lastBind < victim->m_lastBind)
+				victim = texture;
+		}
+
+		if (!victim)
+			break;
+
+		// the top mip is three quarters of a mip chain
+		victim->m_dropLevels++;
+		victim->m_releaseBytes = victim->m_residentBytes - victim->m_residentBytes / 4;
+		victim->reload();
+		Stats::add(Stats::TextureDowngrades);
+
+		if (victim->loadState() == Loading)
+			releasing += victim->m_releaseBytes;
+	}
+}
+
+bool Texture::canReload()
+{
+	return TextureCache::peek(filename()) || Pack::contains(filename()) || ResourceCache::contains(filename());
+}
+
+float Texture::texelsPerPixel() const
+{
+	return sqrt((float)m_size.x * (float)m_size.y) / m_requestSize;
+}
+
+bool Texture::canDropLevel() const
+{
+	// DXT blocks are 4x4, the base level never goes under a block
+	const int minSize = m_format >= DXT1 ? 8 : 2;
+	return m_size.x >= minSize && m_size.y >= minSize;
 }
 
 void Texture::onLoad(BinaryReader reader)
@@ -62,11 +242,18 @@ void Texture::onLoad(BinaryReader reader)
 	m_format = (Format)reader.read<uint8_t>();
 	const int levelCount = (int)reader.read<uint8_t>();
 
+	// dropped top mips are skipped, the smallest level always stays
+	const int firstLevel = glm::min(m_dropLevels, levelCount - 1);
+	m_levelCount = levelCount;
+
+	// recreated so no level of the previous tier is left over
+	m_tex.destroy();
 	m_tex.create();
 	m_tex.bind();
 
 	int dataSize;
 	ivec2 size;
+	uint32_t residentBytes = 0;
 
 	for (int level = 0; level < levelCount; level++)
 	{
@@ -74,31 +261,39 @@ void Texture::onLoad(BinaryReader reader)
 			>> size.y
 			>> dataSize;
 
-		if (level == 0)
+		if (level < firstLevel)
+		{
+			reader.skip(dataSize);
+			continue;
+		}
+
+		const int texLevel = level - firstLevel;
+		if (texLevel == 0)
 			m_size = size;
 
 		char* data = new char[dataSize];
 		reader.read(data, dataSize);
+		residentBytes += dataSize;
 
 		switch (m_format)
 		{
 		case RGB:
-			m_tex.image(level, GL_RGB, size.x, size.y, (const u8vec4*)data);
+			m_tex.image(texLevel, GL_RGB, size.x, size.y, (const u8vec4*)data);
 			break;
 		case RGBA:
-			m_tex.image(level, GL_RGBA, size.x, size.y, (const u8vec4*)data);
+			m_tex.image(texLevel, GL_RGBA, size.x, size.y, (const u8vec4*)data);
 			break;
 		case DXT1:
-			m_tex.compressedImage(level, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, size.x, size.y, dataSize, data);
+			m_tex.compressedImage(texLevel, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, size.x, size.y, dataSize, data);
 			break;
 		case DXT1A:
-			m_tex.compressedImage(level, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, size.x, size.y, dataSize, data);
+			m_tex.compressedImage(texLevel, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, size.x, size.y, dataSize, data);
 			break;
 		case DXT3:
-			m_tex.compressedImage(level, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, size.x, size.y, dataSize, data);
+			m_tex.compressedImage(texLevel, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, size.x, size.y, dataSize, data);
 			break;
 		case DXT5:
-			m_tex.compressedImage(level, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, size.x, size.y, dataSize, data);
+			m_tex.compressedImage(texLevel, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, size.x, size.y, dataSize, data);
 			break;
 		default:
 			emscripten_log(EM_LOG_ERROR, "Unsupported texture format");
@@ -108,6 +303,11 @@ void Texture::onLoad(BinaryReader reader)
 		delete[] data;
 	}
 
+	s_residentBytes = s_residentBytes - m_residentBytes + residentBytes;
+	Stats::add(Stats::TextureResidentBytes, (double)residentBytes - (double)m_residentBytes);
+	m_residentBytes = residentBytes;
+	m_releaseBytes = 0;
+
 	m_tex.parameter(GL_TEXTURE_MIN_FILTER, m_minFilter);
 	m_tex.parameter(GL_TEXTURE_MAG_FILTER, m_magFilter);
 }
@@ -3,6 +3,9 @@
 #include "ShaderVars.hpp"
 #include "Resource.hpp"
 
+// request size of binds outside any culled object or without a uv density, never limits the streaming
+#define TEXTURE_ANY_SIZE 65536.0f
+
 class Texture : public Resource, public gl::DeviceObject
 {
 public:
@@ -47,20 +50,65 @@ public:
 		return m_flags;
 	}
 
-	void bind(int unit = 0) const {
-		if (loaded())
+	// uvDensity is the uv units per model unit of the mesh drawn, see setPixelsPerUnit
+	void bind(int unit = 0, float uvDensity = 0.0f) const {
+		// the side in texels that maps one texel per pixel
+		const float requestSize = s_pixelsPerUnit > 0.0f && uvDensity > 0.0f ? s_pixelsPerUnit / uvDensity : TEXTURE_ANY_SIZE;
+
+		if (m_lastBind != s_frame || m_requestSize == 0.0f)
+		{
+			m_lastBind = s_frame;
+			m_requestSize = requestSize;
+		}
+		else if (requestSize > m_requestSize)
+			m_requestSize = requestSize;
+
+		// streamed textures keep their resident mips while the next ones load
+		if (resident())
 			m_tex.bind(unit);
 		else
 			ShaderVars::blankTexture.bind(unit);
 	}
 
+	// frame of the last bind, the visible textures are restored first after a context loss
+	uint32_t lastBind() const {
+		return m_lastBind;
+	}
+	uint32_t residentBytes() const {
+		return m_residentBytes;
+	}
+	// has mips on the GPU, what bind draws with instead of the blank texture
+	bool resident() const {
+		return m_residentBytes != 0;
+	}
+	static void endFrame() {
+		s_frame++;
+	}
+
+	// screen pixels per model unit of what the following binds draw, 0 outside any culled object
+	static void setPixelsPerUnit(float pixels) {
+		s_pixelsPerUnit = pixels;
+	}
+	// quality dependent textures load on their first bind, at the tier it asks for, then move up to one texel per pixel
+	// top mips of the least recently bound ones are dropped over Config::textureBudget megabytes
+	// only the ones TextureCache, the resource pack or ResourceCache can give back without a download
+	static void updateStreaming();
+
+	// uploads the payload kept by TextureCache, downloads the texture again when it was evicted
+	void restore(const vector<uint8_t>* payload);
+
 protected:
 	virtual void onContextLost();
 	virtual void onContextRestored();
 	virtual void onLoad(BinaryReader reader);
+	virtual void onDownload(const void* data, int size);
 
 private:
 	void makeFilename();
+	void reload();
+	bool canDropLevel() const;
+	bool canReload();
+	float texelsPerPixel() const;
 
 private:
 	GLenum m_minFilter;
@@ -71,6 +119,17 @@ private:
 	const string m_dir;
 	const string m_name;
 	const uint32_t m_flags;
+	mutable uint32_t m_lastBind;
+	mutable float m_requestSize;
+	int m_tier;
+	int m_dropLevels;
+	int m_levelCount;
+	uint32_t m_residentBytes;
+	// bytes the pending reload of a dropped mip frees
+	uint32_t m_releaseBytes;
+
+	static uint32_t s_frame;
+	static float s_pixelsPerUnit;
 };
 
 typedef RefCountedPtr<Texture> TexturePtr;
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "StdAfx.hpp"
+#include "TextureCache.hpp"
+#include "Config.hpp"
+#include "Stats.hpp"
+
+#include <list>
+#include <unordered_map>
+
+namespace TextureCache
+{
+	namespace
+	{
+		struct Entry
+		{
+			string filename;
+			vector<uint8_t> payload;
+		};
+
+		// most recently used first
+		list<Entry> s_entries;
+		unordered_map<string, list<Entry>::iterator> s_index;
+		std::size_t s_size = 0;
+
+		vector<Texture*> s_queue;
+		bool s_queueSorted = true;
+
+		void evict(std::size_t maxSize)
+		{
+			while (s_size > maxSize && !s_entries.empty())
+			{
+				const Entry& entry = s_entries.back();
+				s_size -= entry.payload.size();
+				Stats::add(Stats::TextureCacheBytes, -(double)entry.payload.size());
+
+				s_index.erase(entry.filename);
+				s_entries.pop_back();
+			}
+		}
+	}
+
+	void insert(const string& filename, const void* data, int size)
+	{
+		const std::size_t maxSize = (std::size_t)Config::textureCacheSize * 1024 * 1024;
+		if ((std::size_t)size > maxSize)
+			return;
+
+		auto it = s_index.find(filename);
+		if (it != s_index.end())
+		{
+			s_size -= it->second->payload.size();
+			Stats::add(Stats::TextureCacheBytes, -(double)it->second->payload.size());
+			s_entries.erase(it->second);
+			s_index.erase(it);
+		}
+
+		evict(maxSize - size);
+
+		s_entries.push_front(Entry());
+		Entry& entry = s_entries.front();
+		entry.filename = filename;
+		entry.payload.assign((const uint8_t*)data, (const uint8_t*)data + size);
+
+		s_index.insert(pair<string, list<Entry>::iterator>(filename, s_entries.begin()));
+		s_size += size;
+		Stats::add(Stats::TextureCacheBytes, size);
+	}
+
+	const vector<uint8_t>* find(const string& filename)
+	{
+		auto it = s_index.find(filename);
+		if (it == s_index.end())
+			return nullptr;
+
+		s_entries.splice(s_entries.begin(), s_entries, it->second);
+		return &it->second->payload;
+	}
+
+	const vector<uint8_t>* peek(const string& filename)
+	{
+		auto it = s_index.find(filename);
+		return it != s_index.end() ? &it->second->payload : nullptr;
+	}
+
+	bool queueRestore(Texture* texture)
+	{
+		if (find(texture->filename()) == nullptr)
+			return false;
+
+		// lost again before it was restored
+		if (std::find(s_queue.begin(), s_queue.end(), texture) != s_queue.end())
+			return true;
+
+		texture->addRef();
+		s_queue.push_back(texture);
+		s_queueSorted = false;
+		return true;
+	}
+
+	void update(double budget)
+	{
+		if (s_queue.empty() || !gl::isContextActive())
+			return;
+
+		Stats::Timer timer(Stats::TextureRestoreTime);
+
+		// popped from the back, the last bound textures end up there
+		if (!s_queueSorted)
+		{
+			sort(s_queue.begin(), s_queue.end(), [](const Texture* a, const Texture* b) {
+				return a->lastBind() < b->lastBind();
+			});
+			s_queueSorted = true;
+		}
+
+		const double start = emscripten_get_now();
+
+		do
+		{
+			Texture* const texture = s_queue.back();
+			s_queue.pop_back();
+
+			const vector<uint8_t>* const payload = find(texture->filename());
+			if (payload)
+				Stats::add(Stats::TextureCacheRestores);
+
+			texture->restore(payload);
+			texture->release();
+		} while (!s_queue.empty() && emscripten_get_now() - start < budget);
+	}
+
+	bool restoring()
+	{
+		return !s_queue.empty();
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "Texture.hpp"
+
+// compressed texture payloads kept in memory, a context loss uploads them again without a download
+// only the downloads neither the resource pack nor ResourceCache can give back are kept
+namespace TextureCache
+{
+	// the least recently used payloads are dropped past Config::textureCacheSize megabytes
+	void insert(const string& filename, const void* data, int size);
+	// null when the payload was never kept or evicted since
+	const vector<uint8_t>* find(const string& filename);
+	// the same without making it the most recently used
+	const vector<uint8_t>* peek(const string& filename);
+
+	// false when the texture has to be downloaded again, the queue holds a reference otherwise
+	bool queueRestore(Texture* texture);
+	// restores the most recently bound textures first until budget milliseconds are spent
+	void update(double budget);
+	bool restoring();
+}
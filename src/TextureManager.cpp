@@ -1,12 +1,15 @@
 #include "StdAfx.hpp"
 #include "TextureManager.hpp"
-#include <unordered_map>
+#include "WeakCache.hpp"
+#include "Config.hpp"
+#include "Pack.hpp"
+#include "Stats.hpp"
 
 namespace TextureManager
 {
 	namespace
 	{
-		vector<pair<int, TexturePtr>> terrainTextures,
+		WeakCache<int, Texture> terrainTextures,
 			skyTextures,
 			cloudTextures;
 
@@ -14,7 +17,7 @@ namespace TextureManager
 			m_moonTexture = nullptr,
 			m_sunTexture = nullptr;
 
-		unordered_map<string, TexturePtr> modelTextures, sfxTextures, imageTextures;
+		WeakCache<string, Texture> modelTextures, sfxTextures, imageTextures;
 	}
 
 	TexturePtr getWaterTexture()
@@ -55,94 +58,149 @@ namespace TextureManager
 
 	TexturePtr getTerrainTexture(int id)
 	{
-		for (std::size_t i = 0; i < terrainTextures.size(); i++)
-			if (terrainTextures[i].first == id)
-				return terrainTextures[i].second;
+		TexturePtr texture = terrainTextures.find(id);
+		if (texture)
+			return texture;
 
 		TexturePtr newTexture = TexturePtr::create("world/", "terrain_" + to_string(id), Texture::Compressed | Texture::QualityDependent);
 
 		newTexture->setMinFilter(GL_LINEAR_MIPMAP_NEAREST);
 		newTexture->setMagFilter(GL_LINEAR);
 
-		terrainTextures.push_back(pair<int, TexturePtr>(id, newTexture));
+		terrainTextures.insert(id, newTexture);
 		return newTexture;
 	}
 
 	TexturePtr getSkyTexture(int id)
 	{
-		for (std::size_t i = 0; i < skyTextures.size(); i++)
-			if (skyTextures[i].first == id)
-				return skyTextures[i].second;
+		TexturePtr texture = skyTextures.find(id);
+		if (texture)
+			return texture;
 
 		TexturePtr newTexture = TexturePtr::create("env/", "skybox_" + to_string(id), Texture::Compressed | Texture::QualityDependent);
 
 		newTexture->setMinFilter(GL_LINEAR);
 		newTexture->setMagFilter(GL_LINEAR);
 
-		skyTextures.push_back(pair<int, TexturePtr>(id, newTexture));
+		skyTextures.insert(id, newTexture);
 		return newTexture;
 	}
 
 	TexturePtr getCloudTexture(int id)
 	{
-		for (std::size_t i = 0; i < cloudTextures.size(); i++)
-			if (cloudTextures[i].first == id)
-				return cloudTextures[i].second;
+		TexturePtr texture = cloudTextures.find(id);
+		if (texture)
+			return texture;
 
 		TexturePtr newTexture = TexturePtr::create("env/", "cloud_" + to_string(id), Texture::Compressed | Texture::QualityDependent);
 
 		newTexture->setMinFilter(GL_LINEAR);
 		newTexture->setMagFilter(GL_LINEAR);
 
-		cloudTextures.push_back(pair<int, TexturePtr>(id, newTexture));
+		cloudTextures.insert(id, newTexture);
 		return newTexture;
 	}
 
 	TexturePtr getModelTexture(const string& filename)
 	{
-		auto it = modelTextures.find(filename);
-		if (it != modelTextures.end())
-			return it->second;
+		TexturePtr texture = modelTextures.find(filename);
+		if (texture)
+			return texture;
 
 		TexturePtr newTexture = TexturePtr::create("model/", filename, Texture::Compressed | Texture::QualityDependent);
 
 		newTexture->setMinFilter(GL_LINEAR_MIPMAP_NEAREST);
 		newTexture->setMagFilter(GL_LINEAR);
 
-		modelTextures.insert(pair<string, TexturePtr>(filename, newTexture));
+		modelTextures.insert(filename, newTexture);
 
 		return newTexture;
 	}
 
 	TexturePtr getSfxTexture(const string& filename)
 	{
-		auto it = sfxTextures.find(filename);
-		if (it != sfxTextures.end())
-			return it->second;
+		TexturePtr texture = sfxTextures.find(filename);
+		if (texture)
+			return texture;
 
 		TexturePtr newTexture = TexturePtr::create("model/", filename, Texture::Compressed);
 
 		newTexture->setMinFilter(GL_LINEAR_MIPMAP_NEAREST);
 		newTexture->setMagFilter(GL_LINEAR);
 
-		sfxTextures.insert(pair<string, TexturePtr>(filename, newTexture));
+		sfxTextures.insert(filename, newTexture);
 
 		return newTexture;
 	}
 
+	bool packedSfxTexture(const string& filename)
+	{
+		// the path Texture::makeFilename gives the compressed sfx textures
+		return Pack::contains("model/texture_dxt/" + filename + ".bin");
+	}
+
 	TexturePtr getImageTexture(const string& filename)
 	{
-		auto it = imageTextures.find(filename);
-		if (it != imageTextures.end())
-			return it->second;
+		TexturePtr texture = imageTextures.find(filename);
+		if (texture)
+			return texture;
 
 		TexturePtr newTexture = TexturePtr::create("ui/", filename);
 
 		newTexture->setMinFilter(GL_LINEAR);
 		newTexture->setMagFilter(GL_LINEAR);
 
-		imageTextures.insert(pair<string, TexturePtr>(filename, newTexture));
+		imageTextures.insert(filename, newTexture);
 
 		return newTexture;
 	}
+
+	void update(double now)
+	{
+		terrainTextures.update(now);
+		skyTextures.update(now);
+		cloudTextures.update(now);
+		modelTextures.update(now);
+		sfxTextures.update(now);
+		imageTextures.update(now);
+	}
+
+	void collect(double now, std::size_t overBytes)
+	{
+		const double grace = Config::cacheGracePeriod * 1000.0;
+
+		vector<pair<double, Texture*>> released;
+		terrainTextures.released(now, grace, released);
+		skyTextures.released(now, grace, released);
+		cloudTextures.released(now, grace, released);
+		modelTextures.released(now, grace, released);
+		sfxTextures.released(now, grace, released);
+		imageTextures.released(now, grace, released);
+
+		if (released.empty())
+			return;
+
+		// released first, evicted first
+		sort(released.begin(), released.end(), [](const pair<double, Texture*>& a, const pair<double, Texture*>& b) {
+			return a.first < b.first;
+		});
+
+		double time = released[0].first;
+		std::size_t freed = 0;
+
+		for (std::size_t i = 0; i < released.size() && freed < overBytes; i++)
+		{
+			time = released[i].first;
+			freed += released[i].second->residentBytes();
+		}
+
+		int count = terrainTextures.evict(time);
+		count += skyTextures.evict(time);
+		count += cloudTextures.evict(time);
+		count += modelTextures.evict(time);
+		count += sfxTextures.evict(time);
+		count += imageTextures.evict(time);
+
+		Stats::add(Stats::TextureEvictions, count);
+	}
 }
\ No newline at end of file
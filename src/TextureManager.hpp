@@ -19,6 +19,13 @@ namespace TextureManager
 	TexturePtr getModelTexture(const string& filename);
 
 	TexturePtr getSfxTexture(const string& filename);
+	// whether the mounted resource pack has the sfx texture, for the ones not every deploy has
+	bool packedSfxTexture(const string& filename);
 
 	TexturePtr getImageTexture(const string& filename);
+
+	// stamps the textures nobody else references anymore, they stay cached until collect
+	void update(double now);
+	// evicts the textures released for longer than Config::cacheGracePeriod, oldest release first, until about overBytes are freed
+	void collect(double now, std::size_t overBytes);
 }
\ No newline at end of file
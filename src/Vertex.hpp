@@ -55,10 +55,11 @@ struct SkinObjectVertex
 	vec2 t;
 };
 
-struct SfxVertex
+struct SfxParticleVertex
 {
 	vec3 p;
 	vec2 t;
+	float a;
 };
 
 struct RainVertex
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "RefCounted.hpp"
+#include "Stats.hpp"
+
+#include <unordered_map>
+
+// shared resources by key, the cache alone does not keep them alive
+// an entry whose only reference is the cache is stamped released by update, find still picks it up again
+// until evict drops it, the owners decide when with released and their own memory pressure
+template<typename Key, typename T, typename Hash = std::hash<Key>>
+class WeakCache
+{
+public:
+	RefCountedPtr<T> find(const Key& key)
+	{
+		auto it = m_entries.find(key);
+		if (it == m_entries.end())
+			return nullptr;
+
+		if (it->second.releasedAt >= 0.0)
+		{
+			it->second.releasedAt = -1.0;
+			Stats::add(Stats::CacheResurrections);
+		}
+
+		return it->second.value;
+	}
+
+	void insert(const Key& key, const RefCountedPtr<T>& value)
+	{
+		Entry& entry = m_entries[key];
+		entry.value = value;
+		entry.releasedAt = -1.0;
+	}
+
+	// stamps the entries released since the previous update, now in milliseconds
+	void update(double now)
+	{
+		int released = 0;
+
+		for (auto it = m_entries.begin(); it != m_entries.end(); it++)
+		{
+			Entry& entry = it->second;
+
+			if (entry.value->refCount() == 1)
+			{
+				if (entry.releasedAt < 0.0)
+					entry.releasedAt = now;
+				released++;
+			}
+			else
+				entry.releasedAt = -1.0;
+		}
+
+		Stats::add(Stats::CacheReleasedEntries, released);
+	}
+
+	// release time and value of the entries released for at least grace milliseconds
+	void released(double now, double grace, vector<pair<double, T*>>& out)
+	{
+		for (auto it = m_entries.begin(); it != m_entries.end(); it++)
+		{
+			Entry& entry = it->second;
+
+			if (entry.releasedAt >= 0.0 && now - entry.releasedAt >= grace && entry.value->refCount() == 1)
+				out.push_back(pair<double, T*>(entry.releasedAt, entry.value.get()));
+		}
+	}
+
+	// drops the entries still released that were released at or before time
+	int evict(double time)
+	{
+		int count = 0;
+
+		for (auto it = m_entries.begin(); it != m_entries.end();)
+		{
+			const Entry& entry = it->second;
+
+			if (entry.releasedAt >= 0.0 && entry.releasedAt <= time && entry.value->refCount() == 1)
+			{
+				it = m_entries.erase(it);
+				count++;
+			}
+			else
+				it++;
+		}
+
+		return count;
+	}
+
+	std::size_t size() const {
+		return m_entries.size();
+	}
+
+private:
+	struct Entry
+	{
+		RefCountedPtr<T> value;
+		// -1 while referenced outside the cache
+		double releasedAt;
+	};
+
+private:
+	unordered_map<Key, Entry, Hash> m_entries;
+};
@@ -8,10 +8,20 @@
 #include "Config.hpp"
 #include "Music.hpp"
 #include "World.hpp"
+#include "Stats.hpp"
+#include "TextureCache.hpp"
+#include "ResourceCache.hpp"
+#include "Pack.hpp"
+#include "TextureManager.hpp"
+#include "ModelManager.hpp"
+#include "CollisionBVH.hpp"
 
 #include <emscripten/html5.h>
 #include <ctime>
 
+// mounted along with the project when Config::resourcePack is set
+#define RESOURCE_PACK "resources.fpak"
+
 namespace Window
 {
 	namespace
@@ -22,6 +32,10 @@ namespace Window
 		time_t s_lastUpdateSec;
 		bool s_active = true;
 		bool s_running = false;
+		bool s_shadersReady = false;
+		double s_restoreTime = 0.0;
+		bool s_started = false;
+		int s_budgetDelay = 0;
 
 		World* s_world = nullptr;
 		bool s_rotate = false;
@@ -30,6 +44,59 @@ namespace Window
 		vec3 s_orientation;
 	}
 
+	// released models then textures are evicted while the GPU memory is over Config::gpuBudget
+	void enforceBudget()
+	{
+		// release stamps only need a fraction of a second of precision
+		if (s_budgetDelay > 0)
+		{
+			s_budgetDelay--;
+			return;
+		}
+		s_budgetDelay = 30;
+
+		const double now = emscripten_get_now();
+		ModelManager::update(now);
+		TextureManager::update(now);
+
+		const std::size_t budget = (std::size_t)Config::gpuBudget * 1024 * 1024;
+		if (gl::allocatedMemory() <= budget)
+			return;
+
+		ModelManager::collect(now);
+
+		const std::size_t allocated = gl::allocatedMemory();
+		if (allocated > budget)
+			TextureManager::collect(now, allocated - budget);
+	}
+
+#if defined(FOREVER_DEBUG)
+	// one bar per gl::MemoryCategory against the budget, getGpuMemory() has the numbers
+	void drawMemoryOverlay()
+	{
+		static const u8vec4 colors[gl::MAX_MEMORY_CATEGORY] = {
+			u8vec4(220, 80, 60, 255),
+			u8vec4(80, 180, 80, 255),
+			u8vec4(80, 120, 220, 255),
+			u8vec4(220, 200, 60, 255)
+		};
+
+		const double budget = Config::gpuBudget * 1024.0 * 1024.0;
+		const int width = 200;
+
+		for (int i = 0; i < gl::MAX_MEMORY_CATEGORY; i++)
+		{
+			const ivec2 pos(10, 10 + i * 12);
+			const double used = glm::min((double)gl::allocatedMemory((gl::MemoryCategory)i) / budget, 1.0);
+
+			Canvas2D::fillStyle = u8vec4(0, 0, 0, 160);
+			Canvas2D::fillRect(irect(pos, ivec2(width, 8)));
+			Canvas2D::fillStyle = colors[i];
+			Canvas2D::fillRect(irect(pos, ivec2((int)(width * used), 8)));
+		}
+	}
+#endif
+
 	void onFrame()
 	{
 		if (!s_running)
@@ -60,13 +127,48 @@ namespace Window
 
 		if (s_active && gl::isContextActive())
 		{
-			s_world->render();
+			// only the logo is drawn until the world programs are linked
+			if (!s_shadersReady)
+				s_shadersReady = Shaders::finishPending();
+
+			// the textures bound last are restored first, the rest over the next frames
+			TextureCache::update(4.0);
+
+			if (s_shadersReady)
+				s_world->render();
 
 			Image img = ImageManager::image("logo");
 			Canvas2D::drawImage(img, s_display.size / 2);
 
+#if defined(FOREVER_DEBUG)
+			if (Config::memoryOverlay)
+				drawMemoryOverlay();
+#endif
+
 			Canvas2D::flush();
+
+			// time to the first complete frame after a context restore
+			if (s_restoreTime > 0.0 && s_shadersReady && !TextureCache::restoring())
+			{
+				Stats::add(Stats::ContextRecoveryTime, emscripten_get_now() - s_restoreTime);
+				s_restoreTime = 0.0;
+			}
+
+			// since navigation start, cold and warm resource caches compare through it
+			if (!s_started && s_shadersReady && s_world->loaded())
+			{
+				Stats::add(Stats::StartupTime, emscripten_get_now());
+				s_started = true;
+			}
 		}
+
+		// cache writes only use what is left of the frame
+		ResourceCache::update(1000.0 / 60.0 - (emscripten_get_now() - now));
+
+		Texture::updateStreaming();
+		enforceBudget();
+		Texture::endFrame();
+		Stats::endFrame();
 	}
 
 	EM_BOOL onResize(int eventType, const EmscriptenUiEvent* uiEvent, void* userData)
@@ -152,6 +254,17 @@ namespace Window
 			if (wheelEvent->deltaMode == DOM_DELTA_PIXEL)
 				factor /= 50.0f;
 
+			// stop in front of buildings instead of flying through them
+			const float cameraRadius = 1.0f;
+			const vec3 dir = factor < 0.0f ? -s_orientation : s_orientation;
+			CollisionHit hit;
+			hit.dist = fabs(factor) + cameraRadius;
+			if (s_world->intersectRay(s_world->cameraPos(), dir, hit))
+			{
+				const float dist = glm::max(hit.dist - cameraRadius, 0.0f);
+				factor = factor < 0.0f ? -dist : dist;
+			}
+
 			s_world->setCameraPos(s_world->cameraPos() + s_orientation * factor);
 			updateCameraAngle();
 		}
@@ -175,6 +288,9 @@ namespace Window
 			Platform::showFatalError();
 		}
 
+		s_shadersReady = false;
+		s_restoreTime = emscripten_get_now();
+
 		return true;
 	}
 
@@ -221,6 +337,7 @@ namespace Window
 		emscripten_set_wheel_callback("#canvas", 0, false, onMouseWheel);
 
 		Shaders::createAll();
+		Shaders::warmUp();
 
 		Music::updateSec(1);
 
@@ -237,15 +354,40 @@ namespace Window
 		Platform::setCursor("curbase");
 	}
 
+	void onResourcePackReady(bool mounted)
+	{
+		if (!mounted)
+			emscripten_log(EM_LOG_WARN, "Resource pack unavailable, every resource is loaded on its own");
+	}
+
+	void loadProject()
+	{
+		// not waited for, the resources loaded before it arrives are downloaded on their own
+		if (Config::resourcePack)
+			Pack::mount(RESOURCE_PACK, onResourcePackReady);
+
+		Project::instance = new Project();
+	}
+
 	const DisplayProperties& display()
 	{
 		return s_display;
 	}
 }
 
+#if defined(FOREVER_DEBUG)
+// drops and restores every device object as a real context loss would, contextRecoveryTime tells how long the world took to come back
+extern "C" EMSCRIPTEN_KEEPALIVE void simulateContextLoss()
+{
+	Window::onContextLost(0, nullptr, nullptr);
+	Window::onContextRestored(0, nullptr, nullptr);
+}
+#endif
+
 int main()
 {
-	Project::instance = new Project();
+	ResourceCache::initialize();
+	Window::loadProject();
 
 	emscripten_set_beforeunload_callback(0, Window::onCleanup);
 	emscripten_set_visibilitychange_callback(0, false, Window::onVisibilityChange);
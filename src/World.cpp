@@ -2,6 +2,9 @@
 #include "World.hpp"
 #include "Skybox.hpp"
 #include "TextureManager.hpp"
+#include "CollisionBVH.hpp"
+#include "PoseCache.hpp"
+#include "Stats.hpp"
 
 World::World(const string& name)
 	: Resource("world/" + name + "/properties.bin"),
@@ -19,7 +22,8 @@ World::World(const string& name)
 	m_name(name),
 	m_cullObjCount(0),
 	m_cullSfxCount(0),
-	m_weather(WEATHER_NONE)
+	m_weather(WEATHER_NONE),
+	m_updateTick(0)
 {
 	startLoad();
 }
@@ -30,6 +34,12 @@ World::~World()
 		delete[] m_lands;
 	if (m_skybox)
 		delete m_skybox;
+
+	std::size_t i;
+	for (i = 0; i < m_sfxGroups.size(); i++)
+		delete m_sfxGroups[i];
+	for (i = 0; i < m_freeSfxGroups.size(); i++)
+		delete m_freeSfxGroups[i];
 }
 
 void World::update(int frameCount)
@@ -50,21 +60,30 @@ void World::update(int frameCount)
 	if (m_skybox)
 		m_skybox->update(frameCount);
 
+	updateSfxGroups(frameCount);
+
 	const float maxDistToCamera = glm::max(150.0f, m_farPlane / 2.0f);
 
-	int i, type;
-	std::size_t j;
-	for (i = 0; i < m_cullLandCount; i++)
+	PoseCache::advance(frameCount);
+	m_updateTick++;
+
 	{
-		for (type = OT_ANI; type < MAX_OBJTYPE; type++)
+		Stats::Timer timer(Stats::AnimationUpdateTime);
+
+		int i, type;
+		std::size_t j;
+		for (i = 0; i < m_cullLandCount; i++)
 		{
-			const vector<Object*>& objects = m_cullLands[i]->objects((ObjectType)type);
-			for (j = 0; j < objects.size(); j++)
+			for (type = OT_ANI; type < MAX_OBJTYPE; type++)
 			{
-				Object* const obj = objects[j];
-
-				if (!obj->isDelete() && obj->distToCamera() < maxDistToCamera)
-					obj->update(frameCount);
+				const vector<Object*>& objects = m_cullLands[i]->objects((ObjectType)type);
+				for (j = 0; j < objects.size(); j++)
+				{
+					Object* const obj = objects[j];
+
+					if (!obj->isDelete() && obj->distToCamera() < maxDistToCamera)
+						obj->update(frameCount);
+				}
 			}
 		}
 	}
@@ -76,11 +95,18 @@ void World::update(int frameCount)
 		{
 			removeObjLink(obj);
 			removeObjArray(obj);
-			delete obj;
+
+			// the slot goes with the slabs of the landscape
+			if (obj->hasObjFlag(Object::Pooled))
+				obj->~Object();
+			else
+				delete obj;
 		}
 	}
 	m_deleteObjs.clear();
 
+	PoseCache::collect();
+
 	cullObjects();
 }
 
@@ -217,6 +243,100 @@ Landscape* World::getLandscape(const vec3& p) const
 	return m_lands[mX + mZ * m_size.x].get();
 }
 
+void World::getLandRect(const vec3& bbMin, const vec3& bbMax, ivec2& from, ivec2& to) const
+{
+	// objects are linked to the landscape of their position but can overlap the neighbours
+	const float landSize = (float)(MAP_SIZE * m_MPU);
+
+	from = clamp(ivec2((int)floor(bbMin.x / landSize) - 1, (int)floor(bbMin.z / landSize) - 1), ivec2(0), m_size - 1);
+	to = clamp(ivec2((int)floor(bbMax.x / landSize) + 1, (int)floor(bbMax.z / landSize) + 1), ivec2(0), m_size - 1);
+}
+
+bool World::intersectRay(const vec3& origin, const vec3& dir, CollisionHit& hit, Object** hitObj) const
+{
+	if (!m_lands)
+		return false;
+
+	const vec3 end = origin + dir * hit.dist;
+	ivec2 from, to;
+	getLandRect(glm::min(origin, end), glm::max(origin, end), from, to);
+
+	bool ret = false;
+	int x, z;
+	std::size_t i;
+
+	for (z = from.y; z <= to.y; z++)
+	{
+		for (x = from.x; x <= to.x; x++)
+		{
+			Landscape* const land = m_lands[x + z * m_size.x].get();
+			if (!land)
+				continue;
+
+			const vector<Object*>& objects = land->objects(OT_OBJ);
+			for (i = 0; i < objects.size(); i++)
+			{
+				Object* const obj = objects[i];
+
+				if (!obj->isDelete() && obj->intersectRay(origin, dir, hit))
+				{
+					ret = true;
+					if (hitObj)
+						*hitObj = obj;
+				}
+			}
+		}
+	}
+
+	return ret;
+}
+
+bool World::intersectSphere(const vec3& center, float radius, CollisionHit& hit, Object** hitObj) const
+{
+	return intersectCapsule(center, center, radius, hit, hitObj);
+}
+
+bool World::intersectCapsule(const vec3& p0, const vec3& p1, float radius, CollisionHit& hit, Object** hitObj) const
+{
+	if (!m_lands)
+		return false;
+
+	ivec2 from, to;
+	getLandRect(glm::min(p0, p1) - vec3(radius), glm::max(p0, p1) + vec3(radius), from, to);
+
+	const bool sphere = p0 == p1;
+	bool ret = false;
+	int x, z;
+	std::size_t i;
+
+	for (z = from.y; z <= to.y; z++)
+	{
+		for (x = from.x; x <= to.x; x++)
+		{
+			Landscape* const land = m_lands[x + z * m_size.x].get();
+			if (!land)
+				continue;
+
+			const vector<Object*>& objects = land->objects(OT_OBJ);
+			for (i = 0; i < objects.size(); i++)
+			{
+				Object* const obj = objects[i];
+				if (obj->isDelete())
+					continue;
+
+				if (sphere ? obj->intersectSphere(p0, radius, hit) : obj->intersectCapsule(p0, p1, radius, hit))
+				{
+					ret = true;
+					if (hitObj)
+						*hitObj = obj;
+				}
+			}
+		}
+	}
+
+	return ret;
+}
+
 void World::getLandTri(float x, float z, vec3* out) const
 {
 	if (!vecInWorld(x, z))
@@ -6,8 +6,10 @@
 #define MAX_CULL_LANDS 16
 #define MAX_CULL_OBJ 5000
 #define MAX_CULL_SFX 500
+#define SFX_SHARE_FRAMES 2
 
 class Skybox;
+class SfxModel;
 
 class World : public Resource
 {
@@ -25,6 +27,7 @@ public:
 	const string& name() const;
 	bool inDoor() const;
 	Weather weather() const;
+	int updateTick() const;
 
 	ivec2 posToLand(const vec3& v) const;
 	bool landInWorld(const ivec2& p) const;
@@ -41,6 +44,15 @@ public:
 	const vec3& cameraPos() const;
 	const vec3& cameraTarget() const;
 
+	// static objects only, dir should be normalized and hit.dist set to the max distance
+	bool intersectRay(const vec3& origin, const vec3& dir, CollisionHit& hit, Object** hitObj = nullptr) const;
+	bool intersectSphere(const vec3& center, float radius, CollisionHit& hit, Object** hitObj = nullptr) const;
+	bool intersectCapsule(const vec3& p0, const vec3& p1, float radius, CollisionHit& hit, Object** hitObj = nullptr) const;
+
+	// fire-and-forget effect without an Object, the effects of a sfxId spawned
+	// during the same SFX_SHARE_FRAMES frames share one simulation
+	void spawnSfx(int sfxId, const vec3& pos, const vec3& rot = vec3(0.0f), const vec3& scale = vec3(1.0f));
+
 	bool addObject(Object* obj);
 	void deleteObject(Object* obj);
 	bool insertObjLink(Object* obj);
@@ -57,6 +69,37 @@ private:
 	void renderWater();
 	void cullObjects();
 	void setLight();
+	void getLandRect(const vec3& bbMin, const vec3& bbMax, ivec2& from, ivec2& to) const;
+	void updateSfxGroups(int frameCount);
+	void cullSfxGroups();
+	// sfx objects and shared sfx instances together, far to near
+	void renderSfx();
+
+private:
+	struct SfxInstance
+	{
+		vec3 pos;
+		vec3 rot;
+		vec3 scale;
+	};
+
+	struct SfxGroup
+	{
+		int sfxId;
+		ModelPtr model;
+		vector<SfxInstance> instances;
+	};
+
+	struct SfxGroupDraw
+	{
+		float distToCamera;
+		SfxModel* model;
+		const SfxInstance* instance;
+
+		bool operator<(const SfxGroupDraw& other) const {
+			return distToCamera > other.distToCamera;
+		}
+	};
 
 private:
 	ivec2 m_size;
@@ -83,6 +126,10 @@ private:
 	int m_cullSfxCount;
 	Weather m_weather;
 	vector<Object*> m_deleteObjs;
+	int m_updateTick;
+	vector<SfxGroup*> m_sfxGroups;
+	vector<SfxGroup*> m_freeSfxGroups;
+	vector<SfxGroupDraw> m_cullSfxGroups;
 };
 
 typedef RefCountedPtr<World> WorldPtr;
@@ -23,6 +23,11 @@ inline Weather World::weather() const
 	return m_weather;
 }
 
+inline int World::updateTick() const
+{
+	return m_updateTick;
+}
+
 inline bool World::vecInWorld(float x, float z) const
 {
 	return x >= 0.0f && ((int)x) < m_MPU * MAP_SIZE * m_size.x
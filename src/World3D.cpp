@@ -7,6 +7,7 @@
 #include "Object.hpp"
 #include "Canvas2D.hpp"
 #include "Config.hpp"
+#include "SfxBatcher.hpp"
 
 namespace
 {
@@ -130,6 +131,7 @@ void World::render()
 	}
 
 	setLight();
+	Shaders::setFrameConstants();
 
 	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 	gl::enableDepthWrite();
@@ -144,13 +146,18 @@ void World::render()
 
 	renderTerrain();
 
+	// the textures of each object are streamed up to one texel per pixel at its distance
 	for (int i = 0; i < m_cullObjCount; i++)
+	{
+		Texture::setPixelsPerUnit(m_cullObj[i]->pixelsPerUnit());
 		m_cullObj[i]->render();
+	}
+	Texture::setPixelsPerUnit(0.0f);
 
 	renderWater();
 
-	for (int i = 0; i < m_cullSfxCount; i++)
-		m_cullSfx[i]->render();
+	renderSfx();
+	SfxBatcher::flush();
 
 	if (m_weather != WEATHER_NONE && m_skybox)
 		m_skybox->renderWeather();
@@ -216,30 +223,7 @@ void World::updateView()
 
 	const float fogStart = m_fogStart * farPlaneFactor;
 	const float fogEnd = m_fogEnd * farPlaneFactor;
-	const vec2 fogSettings = vec2(fogEnd, 1.0f / (fogEnd - fogStart));
-
-	Shaders::terrain.use();
-	gl::uniform(Shaders::terrain.uWVP, ShaderVars::viewProj);
-	gl::uniform(Shaders::terrain.uCameraPos, ShaderVars::cameraPos);
-	gl::uniform(Shaders::terrain.uFogSettings, fogSettings);
-
-	Shaders::water.use();
-	gl::uniform(Shaders::water.uWVP, ShaderVars::viewProj);
-	gl::uniform(Shaders::water.uCameraPos, ShaderVars::cameraPos);
-	gl::uniform(Shaders::water.uFogSettings, fogSettings);
-
-	Shaders::cloud.use();
-	gl::uniform(Shaders::cloud.uWVP, ShaderVars::viewProj);
-	gl::uniform(Shaders::cloud.uCameraPos, ShaderVars::cameraPos);
-	gl::uniform(Shaders::cloud.uFogSettings, fogSettings);
-
-	Shaders::object.use();
-	gl::uniform(Shaders::object.uCameraPos, ShaderVars::cameraPos);
-	gl::uniform(Shaders::object.uFogSettings, fogSettings);
-
-	Shaders::skin.use();
-	gl::uniform(Shaders::skin.uCameraPos, ShaderVars::cameraPos);
-	gl::uniform(Shaders::skin.uFogSettings, fogSettings);
+	ShaderVars::fogSettings = vec2(fogEnd, 1.0f / (fogEnd - fogStart));
 
 	if (m_skybox)
 		m_skybox->updateView();
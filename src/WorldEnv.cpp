@@ -112,31 +112,6 @@ void World::setLight()
 	ShaderVars::lightDir = normalize(lightDir);
 	ShaderVars::fogColor = fogDiffuse;
 
-	ambient *= 2.0f;
-
-	const vec3 terrainLightDir = -normalize(lightDir);
-
-	Shaders::terrain.use();
-	gl::uniform(Shaders::terrain.uAmbient, ambient);
-	gl::uniform(Shaders::terrain.uDiffuse, diffuse);
-	gl::uniform(Shaders::terrain.uLightDir, terrainLightDir);
-	gl::uniform(Shaders::terrain.uFogColor, fogDiffuse);
-
-	Shaders::object.use();
-	gl::uniform(Shaders::object.uAmbient, ambient);
-	gl::uniform(Shaders::object.uDiffuse, diffuse);
-	gl::uniform(Shaders::object.uLightDir, terrainLightDir);
-	gl::uniform(Shaders::object.uFogColor, fogDiffuse);
-
-	Shaders::skin.use();
-	gl::uniform(Shaders::skin.uAmbient, ambient);
-	gl::uniform(Shaders::skin.uDiffuse, diffuse);
-	gl::uniform(Shaders::skin.uLightDir, terrainLightDir);
-	gl::uniform(Shaders::skin.uFogColor, fogDiffuse);
-
-	Shaders::water.use();
-	gl::uniform(Shaders::water.uFogColor, fogDiffuse);
-
-	Shaders::cloud.use();
-	gl::uniform(Shaders::cloud.uFogColor, fogDiffuse);
+	ShaderVars::ambient = ambient * 2.0f;
+	ShaderVars::diffuse = diffuse;
 }
\ No newline at end of file
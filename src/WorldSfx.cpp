@@ -0,0 +1,172 @@
+#include "StdAfx.hpp"
+#include "World.hpp"
+#include "SfxModel.hpp"
+#include "ModelManager.hpp"
+#include "Stats.hpp"
+
+#define MAX_FREE_SFX_GROUPS 32
+
+void World::spawnSfx(int sfxId, const vec3& pos, const vec3& rot, const vec3& scale)
+{
+	if (!vecInWorld(pos))
+		return;
+
+	SfxGroup* group = nullptr;
+	std::size_t i;
+
+	for (i = 0; i < m_sfxGroups.size(); i++)
+	{
+		if (m_sfxGroups[i]->sfxId == sfxId && m_sfxGroups[i]->model->currentFrame() < (float)SFX_SHARE_FRAMES)
+		{
+			group = m_sfxGroups[i];
+			break;
+		}
+	}
+
+	if (!group)
+	{
+		for (i = 0; i < m_freeSfxGroups.size(); i++)
+		{
+			if (m_freeSfxGroups[i]->sfxId == sfxId)
+			{
+				group = m_freeSfxGroups[i];
+				m_freeSfxGroups[i] = m_freeSfxGroups.back();
+				m_freeSfxGroups.pop_back();
+				((SfxModel*)group->model.get())->restart();
+				break;
+			}
+		}
+
+		if (!group)
+		{
+			ModelPtr model = ModelManager::createModel(OT_SFX, sfxId);
+			if (!model || model->modelType() != MODELTYPE_SFX)
+				return;
+
+			group = new SfxGroup();
+			group->sfxId = sfxId;
+			group->model = model;
+		}
+
+		m_sfxGroups.push_back(group);
+	}
+
+	SfxInstance instance;
+	instance.pos = pos;
+	instance.rot = rot;
+	instance.scale = scale;
+	group->instances.push_back(instance);
+}
+
+void World::updateSfxGroups(int frameCount)
+{
+	if (m_sfxGroups.empty())
+		return;
+
+	Stats::Timer timer(Stats::SfxUpdateTime);
+
+	std::size_t i = 0;
+	while (i < m_sfxGroups.size())
+	{
+		SfxGroup* const group = m_sfxGroups[i];
+		Model* const model = group->model.get();
+
+		if (model->loaded())
+		{
+			((SfxModel*)model)->update(frameCount);
+			Stats::add(Stats::SfxGroupUpdates);
+
+			// played once, like a Sfx object
+			if (model->isEndFrame())
+			{
+				group->instances.clear();
+
+				if (m_freeSfxGroups.size() < MAX_FREE_SFX_GROUPS)
+					m_freeSfxGroups.push_back(group);
+				else
+					delete group;
+
+				m_sfxGroups[i] = m_sfxGroups.back();
+				m_sfxGroups.pop_back();
+				continue;
+			}
+		}
+
+		i++;
+	}
+}
+
+void World::cullSfxGroups()
+{
+	m_cullSfxGroups.clear();
+
+	const float maxDistToCamera = glm::max(150.0f, m_farPlane / 2.0f);
+	vec3 bbMin, bbMax;
+
+	for (std::size_t i = 0; i < m_sfxGroups.size(); i++)
+	{
+		SfxGroup* const group = m_sfxGroups[i];
+		Model* const model = group->model.get();
+
+		if (!model->loaded())
+			continue;
+
+		model->bounds(bbMin, bbMax);
+		const vec3 center = (bbMin + bbMax) * 0.5f;
+		const float radius = length(bbMax - bbMin) * 0.5f;
+
+		for (std::size_t j = 0; j < group->instances.size(); j++)
+		{
+			const SfxInstance& instance = group->instances[j];
+			const float scale = glm::max(instance.scale.x, glm::max(instance.scale.y, instance.scale.z));
+			const vec3 pos = instance.pos + center * instance.scale;
+
+			if (length(ShaderVars::cameraPos - pos) > maxDistToCamera)
+				continue;
+
+			bool visible = true;
+			for (int iPlane = 0; iPlane < 6 && visible; iPlane++)
+			{
+				if (ShaderVars::frustum[iPlane].x * pos.x +
+					ShaderVars::frustum[iPlane].y * pos.y +
+					ShaderVars::frustum[iPlane].z * pos.z +
+					ShaderVars::frustum[iPlane].w < -radius * scale)
+				{
+					visible = false;
+				}
+			}
+
+			if (visible)
+			{
+				SfxGroupDraw draw;
+				// measured from the origin like Object::cull
+				draw.distToCamera = length(ShaderVars::cameraPos - instance.pos);
+				draw.model = (SfxModel*)model;
+				draw.instance = &instance;
+				m_cullSfxGroups.push_back(draw);
+			}
+		}
+	}
+
+	sort(m_cullSfxGroups.begin(), m_cullSfxGroups.end());
+}
+
+void World::renderSfx()
+{
+	cullSfxGroups();
+
+	// both lists are sorted far to near, merged so the blended effects keep the same order
+	std::size_t j = 0;
+	for (int i = 0; i <= m_cullSfxCount; i++)
+	{
+		while (j < m_cullSfxGroups.size() && (i == m_cullSfxCount || m_cullSfxGroups[j].distToCamera >= m_cullSfx[i]->distToCamera()))
+		{
+			const SfxGroupDraw& draw = m_cullSfxGroups[j++];
+			draw.model->render(draw.instance->pos + vec3(0.0f, 0.2f, 0.0f), draw.instance->rot, draw.instance->scale);
+			Stats::add(Stats::SfxInstanceCount);
+		}
+
+		if (i < m_cullSfxCount)
+			m_cullSfx[i]->render();
+	}
+}